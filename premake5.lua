@@ -3,7 +3,7 @@ workspace "Whitefire"
     platforms {"Linux", "Windows"}
 
     filter "configurations:Debug"
-        defines {"DEBUG", "_DEBUG"}
+        defines {"DEBUG", "_DEBUG", "WFE_POOL_STATS", "WFE_POOL_IMAGE_VERIFY"}
         symbols "On"
 
     filter "configurations:Release"
@@ -21,5 +21,5 @@ workspace "Whitefire"
 
 include "vendor"
 include "runtime"
--- include "tools"
+include "tools"
 -- include "editor"
@@ -0,0 +1,182 @@
+#include "bench.h"
+#include <wfe/asset.h>
+#include <wfe/pool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#define ASSET_BENCH_FILES 2000
+#define ASSET_BENCH_DIR "wfe_asset_bench"
+#define ASSET_BENCH_PACK "wfe_asset_bench.pack"
+#define ASSET_BENCH_BIG (16 << 20)
+
+static wfeChar asset_bench_names[ASSET_BENCH_FILES][16];
+
+// Writes small files with desc-like sizes (200 bytes to 4 KB).
+static wfeBool asset_bench_setup() {
+    static wfeChar payload[4096];
+    wfeChar path[64];
+    wfeUint32 seed = 0x9e3779b9;
+    FILE *file;
+    wfeSize i;
+
+#ifdef HAVE_UNISTD_H
+    mkdir(ASSET_BENCH_DIR, 0755);
+#endif
+    memset(payload, 'x', sizeof(payload));
+    for (i = 0; i < ASSET_BENCH_FILES; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        snprintf(asset_bench_names[i], sizeof(asset_bench_names[i]), "a%04zu", i);
+        snprintf(path, sizeof(path), "%s/%.15s.desc", ASSET_BENCH_DIR, asset_bench_names[i]);
+        file = fopen(path, "wb");
+        if (file == NULL)
+            return WFE_FALSE;
+
+        fwrite(payload, 1, 200 + (seed >> 8) % 3896, file);
+        fclose(file);
+    }
+
+    return WFE_TRUE;
+}
+
+static void asset_bench_cleanup() {
+    wfeChar path[64];
+    wfeSize i;
+    for (i = 0; i < ASSET_BENCH_FILES; i++) {
+        snprintf(path, sizeof(path), "%s/%.15s.desc", ASSET_BENCH_DIR, asset_bench_names[i]);
+        remove(path);
+    }
+
+    remove(ASSET_BENCH_DIR);
+}
+
+// Drops files from the page cache, clean pages go without privileges.
+static void asset_bench_evict() {
+#ifdef HAVE_UNISTD_H
+    wfeChar path[64];
+    wfeSize i;
+    int fd;
+    for (i = 0; i < ASSET_BENCH_FILES; i++) {
+        snprintf(path, sizeof(path), "%s/%.15s.desc", ASSET_BENCH_DIR, asset_bench_names[i]);
+        fd = open(path, O_RDONLY);
+        if (fd >= 0) {
+            fdatasync(fd);
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+    }
+#endif
+}
+
+static void asset_bench_run(const char *cache, wfeBool cold) {
+    static wfeAssetBatchItem items[ASSET_BENCH_FILES];
+    const wfeData *data;
+    wfeChar name[96];
+    wfePool pool;
+    wfeSize i, size;
+    double start;
+
+    for (i = 0; i < ASSET_BENCH_FILES; i++) {
+        items[i].name = asset_bench_names[i];
+        items[i].ext = ".desc";
+    }
+
+    wfePoolInit(&pool);
+    if (cold) asset_bench_evict();
+    start = bench_now();
+    for (i = 0; i < ASSET_BENCH_FILES; i++)
+        wfeAssetLoadRaw(asset_bench_names[i], ".desc", &pool, &data, &size);
+    snprintf(name, sizeof(name), "load raw, stdio (%s)", cache);
+    bench_report_rate(name, bench_now() - start, ASSET_BENCH_FILES, "files");
+    wfePoolRecycle(&pool);
+
+    if (cold) asset_bench_evict();
+    start = bench_now();
+    wfeAssetLoadBatch(items, ASSET_BENCH_FILES, &pool, WFE_ASSET_BATCH_NO_URING);
+    snprintf(name, sizeof(name), "load batch, pread (%s)", cache);
+    bench_report_rate(name, bench_now() - start, ASSET_BENCH_FILES, "files");
+    wfePoolRecycle(&pool);
+
+    if (cold) asset_bench_evict();
+    start = bench_now();
+    wfeAssetLoadBatch(items, ASSET_BENCH_FILES, &pool, 0);
+    snprintf(name, sizeof(name), "load batch, io_uring when available (%s)", cache);
+    bench_report_rate(name, bench_now() - start, ASSET_BENCH_FILES, "files");
+
+    wfePoolFinalize(&pool);
+}
+
+// Loads a big compressed entry with a growing count of inflate workers.
+static void asset_bench_inflate() {
+    const wfeChar *names[1] = {"big.bin"};
+    wfeChar name[96], *content;
+    const wfeData *data;
+    wfeSize length, i, workers, size;
+    wfePool pool;
+    FILE *file;
+    double start;
+
+    content = malloc(ASSET_BENCH_BIG);
+    file = fopen(ASSET_BENCH_DIR "/big.bin", "wb");
+    if (content == NULL || file == NULL) {
+        fprintf(stderr, "\tcould not write " ASSET_BENCH_DIR "/big.bin\n");
+        free(content);
+        if (file != NULL) fclose(file);
+        return;
+    }
+
+    for (length = 0, i = 0; length + 48 < ASSET_BENCH_BIG; i++)
+        length += (wfeSize) sprintf(content + length, "vertex %zu %zu %zu\n", i % 1021, (i * 7) % 509, i);
+    fwrite(content, 1, length, file);
+    fclose(file);
+    free(content);
+
+    wfePoolInit(&pool);
+    if (WFE_HAVE_FAILED(wfeAssetPackWrite(ASSET_BENCH_PACK, ASSET_BENCH_DIR, names, 1, 6, &pool)) ||
+        WFE_HAVE_FAILED(wfeAssetMountPack(ASSET_BENCH_PACK))) {
+        fprintf(stderr, "\tcould not write " ASSET_BENCH_PACK "\n");
+        wfePoolFinalize(&pool);
+        remove(ASSET_BENCH_DIR "/big.bin");
+        return;
+    }
+
+    for (workers = 0; workers <= 4; workers += 2) {
+        wfeAssetSetInflateWorkers(workers);
+        start = bench_now();
+        for (i = 0; i < 8; i++) {
+            wfeAssetLoadRaw("big", ".bin", &pool, &data, &size);
+            wfePoolRecycle(&pool);
+        }
+
+        snprintf(name, sizeof(name), "load compressed pack, %zu inflate workers", workers);
+        bench_report_rate(name, bench_now() - start, (double) length * 8 / (1 << 20), "MB");
+    }
+
+    wfeAssetPackStatsDump(stderr);
+    wfeAssetSetInflateWorkers(0);
+    wfeAssetUnmountPacks();
+    wfePoolFinalize(&pool);
+    remove(ASSET_BENCH_PACK);
+    remove(ASSET_BENCH_DIR "/big.bin");
+}
+
+static void asset_bench() {
+    bench_suite_start(asset);
+    if (!asset_bench_setup()) {
+        fprintf(stderr, "\tcould not write files on " ASSET_BENCH_DIR "\n");
+        asset_bench_cleanup();
+        return;
+    }
+
+    wfeAssetSetSearchPath(ASSET_BENCH_DIR);
+    asset_bench_run("cold cache", WFE_TRUE);
+    asset_bench_run("warm cache", WFE_FALSE);
+    asset_bench_inflate();
+    asset_bench_cleanup();
+    bench_suite_end(asset);
+}
@@ -0,0 +1,22 @@
+#ifndef WFE_BENCH_H
+#define WFE_BENCH_H
+#include <stdio.h>
+#include <time.h>
+
+/**
+ * Minimal helpers for micro benchmarks, each benchmark measures a loop
+ * and reports the cost per operation.
+ */
+#define bench_suite_start(e) fprintf(stderr, "-- Starting benchmark %s\n", #e);
+#define bench_suite_end(e) fprintf(stderr, "-- Ending benchmark %s\n", #e);
+#define bench_report(name, ns, ops) fprintf(stderr, "\t%-48s %12.2f ns/op\n", name, (double) (ns) / (double) (ops));
+#define bench_report_rate(name, ns, ops, unit) fprintf(stderr, "\t%-48s %12.0f %s/s\n", name, (double) (ops) * 1e9 / (double) (ns), unit);
+
+// Current wall time in nanoseconds.
+static double bench_now() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+#endif /* WFE_BENCH_H */
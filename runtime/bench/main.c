@@ -0,0 +1,15 @@
+// posix_fadvise and fdatasync are not part of strict C11.
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include "bench.h"
+
+// include all benchmarks
+#include "pool_bench.c"
+#include "asset_bench.c"
+
+int main() {
+    fprintf(stderr, "Running benchmarks for WhiteFire Game Engine\n");
+    pool_bench();
+    asset_bench();
+    return 0;
+}
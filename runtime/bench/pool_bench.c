@@ -0,0 +1,154 @@
+#include "bench.h"
+#include <wfe/pool.h>
+
+#define POOL_BENCH_SIZES 4096
+#define POOL_BENCH_ROUNDS 2000
+
+static volatile wfeSize pool_bench_sink;
+
+// Tier selection as wfePoolGet did it before the size class table, kept as baseline.
+#define legacyCheckSize(p, s, tier) ( ((wfeSize) (tier)*(p->threshold)) >= (s) )
+static wfeSize pool_bench_legacy_tier(wfePool *pool, wfeSize size) {
+    if (legacyCheckSize(pool, size, WFE_POOL_TINY))
+        return WFE_POOL_TIER_TINY;
+
+    if (legacyCheckSize(pool, size, WFE_POOL_SMALL))
+        return WFE_POOL_TIER_SMALL;
+
+    if (legacyCheckSize(pool, size, WFE_POOL_MEDIUM))
+        return WFE_POOL_TIER_MEDIUM;
+
+    if (legacyCheckSize(pool, size, WFE_POOL_LARGE))
+        return WFE_POOL_TIER_LARGE;
+
+    if (legacyCheckSize(pool, size, WFE_POOL_HUGE))
+        return WFE_POOL_TIER_HUGE;
+
+    return WFE_POOL_TIER_CUSTOM;
+}
+#undef legacyCheckSize
+
+// Tier selection as wfePoolGet does it now.
+static wfeSize pool_bench_class_tier(wfePool *pool, wfeSize size) {
+    wfeSize cls = wfePoolSizeClass(size);
+    wfeSize index = cls < WFE_POOL_CLASSES ? pool->classes[cls] : WFE_POOL_TIER_CUSTOM;
+    while (size > pool->limits[index])
+        index++;
+
+    return index;
+}
+
+// Fills sizes with a mix of mostly small requests and a few medium ones.
+static void pool_bench_sizes(wfeSize *sizes, wfeSize count, wfeSize maxSmall) {
+    wfeUint32 seed = 0x12345678;
+    wfeSize i;
+    for (i = 0; i < count; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        sizes[i] = (seed >> 8) % 16 == 0 ? 1 + (seed >> 8) % 65536 : 1 + (seed >> 8) % maxSmall;
+    }
+}
+
+static void pool_bench_tier_selection() {
+    static wfeSize sizes[POOL_BENCH_SIZES];
+    wfePool pool;
+    wfeSize i, r, acc = 0;
+    double start;
+
+    wfePoolInit(&pool);
+    pool_bench_sizes(sizes, POOL_BENCH_SIZES, 256);
+
+    start = bench_now();
+    for (r = 0; r < POOL_BENCH_ROUNDS; r++)
+        for (i = 0; i < POOL_BENCH_SIZES; i++)
+            acc += pool_bench_legacy_tier(&pool, sizes[i]);
+    bench_report("tier selection (threshold cascade)", bench_now() - start, POOL_BENCH_ROUNDS * POOL_BENCH_SIZES);
+
+    start = bench_now();
+    for (r = 0; r < POOL_BENCH_ROUNDS; r++)
+        for (i = 0; i < POOL_BENCH_SIZES; i++)
+            acc += pool_bench_class_tier(&pool, sizes[i]);
+    bench_report("tier selection (size class table)", bench_now() - start, POOL_BENCH_ROUNDS * POOL_BENCH_SIZES);
+
+    pool_bench_sink = acc;
+    wfePoolFinalize(&pool);
+}
+
+static void pool_bench_get() {
+    static wfeSize sizes[POOL_BENCH_SIZES];
+    wfePool pool;
+    wfeSize i, r;
+    double start;
+
+    wfePoolInit(&pool);
+    pool_bench_sizes(sizes, POOL_BENCH_SIZES, 64);
+
+    // Warm up so every tier and block exists before measuring.
+    for (i = 0; i < POOL_BENCH_SIZES; i++)
+        wfePoolGet(&pool, sizes[i], wfeAlignOf(wfeUint64));
+    wfePoolRecycle(&pool);
+
+    start = bench_now();
+    for (r = 0; r < POOL_BENCH_ROUNDS; r++) {
+        for (i = 0; i < POOL_BENCH_SIZES; i++)
+            pool_bench_sink = (wfeSize) wfePoolGet(&pool, sizes[i], wfeAlignOf(wfeUint64));
+
+        wfePoolRecycle(&pool);
+    }
+    bench_report("wfePoolGet (small objects, recycle per frame)", bench_now() - start, POOL_BENCH_ROUNDS * POOL_BENCH_SIZES);
+
+    wfePoolFinalize(&pool);
+}
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define POOL_BENCH_VECTORS 4096
+
+// Sums vectors stored on pool memory, aligned loads need 16 byte aligned pointers.
+static void pool_bench_vector_loads() {
+    wfePool pool;
+    float *aligned, *unaligned, sum[4];
+    __m128 acc;
+    wfeSize i, r;
+    double start;
+
+    wfePoolInit(&pool);
+    aligned = (float *) wfePoolGet(&pool, sizeof(float) * 4 * POOL_BENCH_VECTORS, 16);
+
+    // Pools used to round to 4 bytes only, emulate it with a pointer 4 bytes past a cache line.
+    unaligned = (float *) (wfePoolGet(&pool, sizeof(float) * 4 * (POOL_BENCH_VECTORS + 1), 64) + 4);
+    for (i = 0; i < 4 * POOL_BENCH_VECTORS; i++) {
+        aligned[i] = (float) i;
+        unaligned[i] = (float) i;
+    }
+
+    start = bench_now();
+    acc = _mm_setzero_ps();
+    for (r = 0; r < POOL_BENCH_ROUNDS; r++)
+        for (i = 0; i < POOL_BENCH_VECTORS; i++)
+            acc = _mm_add_ps(acc, _mm_load_ps(aligned + 4 * i));
+    bench_report("vector loads (16 byte aligned pool memory)", bench_now() - start, POOL_BENCH_ROUNDS * POOL_BENCH_VECTORS);
+    _mm_storeu_ps(sum, acc);
+    pool_bench_sink = (wfeSize) sum[0];
+
+    start = bench_now();
+    acc = _mm_setzero_ps();
+    for (r = 0; r < POOL_BENCH_ROUNDS; r++)
+        for (i = 0; i < POOL_BENCH_VECTORS; i++)
+            acc = _mm_add_ps(acc, _mm_loadu_ps(unaligned + 4 * i));
+    bench_report("vector loads (4 byte aligned pool memory)", bench_now() - start, POOL_BENCH_ROUNDS * POOL_BENCH_VECTORS);
+    _mm_storeu_ps(sum, acc);
+    pool_bench_sink = (wfeSize) sum[0];
+
+    wfePoolFinalize(&pool);
+}
+#endif
+
+static void pool_bench() {
+    bench_suite_start(pool);
+    pool_bench_tier_selection();
+    pool_bench_get();
+#if defined(__SSE__) || defined(_M_X64)
+    pool_bench_vector_loads();
+#endif
+    bench_suite_end(pool);
+}
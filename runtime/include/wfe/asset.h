@@ -3,11 +3,58 @@
 #include <wfe/types.h>
 #include <wfe/pool.h>
 #include <wfe/desc.h>
+#include <stdio.h>
 
 #define WFE_FILE_SEPARATOR ('/')
 #define WFE_FILE_SEPARATOR_STR ("/")
 #define WFE_ASSET_FILE_ACCESS_ERROR WFE_MAKE_FILE_ERROR(50)
 #define WFE_DID_NOT_READ_ALL_FILE WFE_MAKE_FILE_ERROR(51)
+#define WFE_ASSET_PACK_INVALID WFE_MAKE_FILE_ERROR(52) // Pack is corrupt or from another version
+#define WFE_ASSET_PACK_LIMIT WFE_MAKE_API_ERROR(53)   // WFE_ASSET_MAX_PACKS are mounted already
+#define WFE_ASSET_PACK_WRITE WFE_MAKE_FILE_ERROR(54)  // Pack could not be written
+#define WFE_ASSET_INFLATE_COUNT WFE_MAKE_API_ERROR(55)      // Count of inflate workers is too big
+#define WFE_ASSET_INFLATE_THREAD_ERROR WFE_MAKE_FAILURE(56) // Inflate workers or their locks could not be created
+#define WFE_ASSET_INDEX_OMEM WFE_MAKE_MEMORY_ERROR(57)      // Index of search roots could not grow
+#define WFE_ASSET_STREAM_THREAD_ERROR WFE_MAKE_FAILURE(58)  // Read-ahead thread or its lock could not be created
+#define WFE_ASSET_MANIFEST_OMEM WFE_MAKE_MEMORY_ERROR(80)         // No memory for manifest path or content
+#define WFE_ASSET_MANIFEST_THREAD_ERROR WFE_MAKE_FAILURE(81)     // Prefetch thread could not be created
+
+#define WFE_ASSET_MAX_PACKS 16
+#define WFE_ASSET_MAX_INFLATE_WORKERS 8
+
+/**
+ * Asset mapped straight from the page cache, see wfeAssetMapRaw.
+ */
+typedef struct wfeAssetMapping {
+    const wfeData *data; // Start of asset
+    wfeSize size;        // Bytes of asset
+} wfeAssetMapping;
+
+/**
+ * Counters of compressed pack entries loaded since start, see wfeAssetPackStats.
+ */
+typedef struct wfeAssetPackReport {
+    wfeUint64 entries;     // Compressed entries loaded
+    wfeUint64 stored;      // Bytes read from packs for them
+    wfeUint64 size;        // Bytes once inflated
+    wfeUint64 nanoseconds; // Time spent inflating, summed over loading threads
+} wfeAssetPackReport;
+
+/**
+ * Receives a chunk of a streamed asset, see wfeAssetStreamRaw.
+ *
+ * Prototype params:
+ *  - (1) const wfeData * chunk, valid only during the call.
+ *  - (2) wfeSize size of chunk, only the last one might be smaller than the chunk size.
+ *  - (3) wfeSize offset of chunk on asset.
+ *  - (4) wfeAny userdata given to the stream.
+ *
+ * Should return:
+ *  - WFE_CONTINUE for the next chunk.
+ *  - WFE_DONE to stop reading.
+ *  - Any failure to stop reading and bubble it.
+ */
+typedef wfeError (*wfeAssetStreamCallback)(const wfeData *, wfeSize, wfeSize, wfeAny);
 
 /**
  * Sets the search path for all asset loading.
@@ -18,8 +65,177 @@
  */
 void wfeAssetSetSearchPath(wfeChar *searchPath);
 
+/**
+ * Gets the search path for all asset loading.
+ *
+ * Returns:
+ *  - Search path given to wfeAssetSetSearchPath, NULL if not set.
+ */
+const wfeChar *wfeAssetGetSearchPath(void);
+
+/**
+ * Adds a search root, a folder scanned once into an index of every file under it. Once a
+ * root is added, loads resolve paths with a single lookup on the index and assets missing
+ * from it fail without touching the disk; the search path is not used anymore. Roots added
+ * later override files of older ones (e.g. base, then patch, then mods), packs still go first.
+ *
+ * Links to files are indexed as files, links to folders are skipped so link loops can not
+ * hang the scan. Files created after the scan are not seen until roots are cleared and
+ * added again.
+ * Warning: no thread-safe, call only at begining.
+ * Params:
+ *  - root folder to scan.
+ * Return:
+ *  - WFE_SUCCESS if root is indexed.
+ *  - WFE_ASSET_FILE_ACCESS_ERROR if root or one of its folders could not be listed, files
+ *    found until then stay indexed.
+ *  - WFE_ASSET_INDEX_OMEM if no memory is available for the index.
+ *  - WFE_POOL_* in case that pool returns error.
+ */
+wfeError wfeAssetAddSearchRoot(const wfeChar *root);
+
+/**
+ * Drops every search root and its index, loads go back to the search path.
+ *
+ * Warning: no thread-safe, nothing should be loading meanwhile.
+ */
+void wfeAssetClearSearchRoots(void);
+
+/**
+ * Starts recording a preload manifest: every asset resolved to a file from now on is noted
+ * once, with the time of its first access, in order. Pack entries are not recorded. Nothing
+ * is written until wfeAssetManifestFinish.
+ *
+ * Does nothing if a recording is running already.
+ * Params:
+ *  - path of manifest to write on finish, usually the one given to wfeAssetManifestPrefetch.
+ * Return:
+ *  - WFE_SUCCESS.
+ *  - WFE_ASSET_MANIFEST_OMEM if no memory is available for path.
+ *  - WFE_HASHMAP_OMEM_ELEMENT if no memory is available for the seen assets.
+ */
+wfeError wfeAssetManifestRecord(const wfeChar *path);
+
+/**
+ * Stops recording and writes the manifest, one asset per line: microseconds from start of
+ * recording to first access, a space and name with extension.
+ *
+ * Return:
+ *  - WFE_SUCCESS, also if nothing was being recorded.
+ *  - WFE_ASSET_FILE_ACCESS_ERROR if manifest could not be written.
+ */
+wfeError wfeAssetManifestFinish(void);
+
+/**
+ * Replays a manifest recorded by an earlier run on a background thread. Assets are resolved
+ * in order of first access and brought into the page cache (posix_fadvise WILLNEED, or a
+ * plain read where not available), so loads find them on memory instead of waiting on disk.
+ * Prefetch only warms the system cache, loads and their results are not changed.
+ *
+ * Warning: search path and roots must not change until wfeAssetManifestEndPrefetch.
+ * Params:
+ *  - path of manifest.
+ * Return:
+ *  - WFE_SUCCESS if prefetch is running.
+ *  - WFE_ASSET_FILE_ACCESS_ERROR if manifest does not exists (e.g. first run).
+ *  - WFE_DID_NOT_READ_ALL_FILE if manifest could not be read.
+ *  - WFE_ASSET_MANIFEST_OMEM if no memory is available for manifest.
+ *  - WFE_ASSET_MANIFEST_THREAD_ERROR if prefetch thread could not be started.
+ */
+wfeError wfeAssetManifestPrefetch(const wfeChar *path);
+
+/**
+ * Waits for the prefetch thread, does nothing if no prefetch is running.
+ *
+ * Params:
+ *  - cancel to skip assets not reached yet instead of waiting for the whole manifest.
+ * Returns:
+ *  - Count of prefetched assets, missing ones are skipped.
+ */
+wfeSize wfeAssetManifestEndPrefetch(wfeBool cancel);
+
+/**
+ * Mounts a pack file, a single file holding many assets. Assets are looked up on mounted
+ * packs before the search path, the pack mounted last first, so packs can patch older ones.
+ * Pack stays open and its table of contents on memory until unmounted.
+ *
+ * Warning: no thread-safe, call only at begining.
+ * Params:
+ *  - path of pack file.
+ * Return:
+ *  - WFE_SUCCESS if pack is mounted.
+ *  - WFE_ASSET_FILE_ACCESS_ERROR if file does not exists or is unable to read.
+ *  - WFE_ASSET_PACK_INVALID if file is not a pack, is corrupt or comes from another version.
+ *  - WFE_ASSET_PACK_LIMIT if WFE_ASSET_MAX_PACKS are mounted.
+ */
+wfeError wfeAssetMountPack(const wfeChar *path);
+
+/**
+ * Unmounts every pack, assets already loaded from them stay on their pools.
+ *
+ * Warning: no thread-safe, nothing should be loading meanwhile.
+ */
+void wfeAssetUnmountPacks(void);
+
+/**
+ * Writes a pack with files under a folder. Table of contents is sorted by hash of names
+ * and each entry starts on a page boundary, so entries can be read on their own.
+ *
+ * With a level above zero entries are split into chunks of 256 KB compressed as independent
+ * zlib streams, which inflate in parallel (see wfeAssetSetInflateWorkers). Entries that do
+ * not shrink are stored as is.
+ *
+ * Params:
+ *  - path of pack file, overwritten.
+ *  - root folder that holds the files, it is not part of entry names.
+ *  - names of files relative to root with extension, as they are loaded (e.g. "level1/door.desc").
+ *  - count of names.
+ *  - level of zlib compression from 1 (fast) to 9 (small), zero to store entries as is.
+ *  - pool for temporary memory, nothing is left on it. Holds a whole file at a time.
+ * Return:
+ *  - WFE_SUCCESS if pack is written.
+ *  - WFE_ASSET_FILE_ACCESS_ERROR if a file does not exists or is unable to read.
+ *  - WFE_DID_NOT_READ_ALL_FILE if a file changed while written.
+ *  - WFE_ASSET_PACK_WRITE if pack could not be written.
+ *  - WFE_POOL_* in case that pool returns error.
+ */
+wfeError wfeAssetPackWrite(const wfeChar *path, const wfeChar *root, const wfeChar **names, wfeSize count, wfeInt32 level, wfePool *pool);
+
+/**
+ * Starts threads that help inflating chunks of compressed pack entries. The thread loading
+ * an entry always inflates too, workers join a single entry at a time and other entries
+ * loaded meanwhile inflate on their own thread. Without workers entries inflate serially.
+ *
+ * Warning: no thread-safe, nothing should be loading meanwhile.
+ * Params:
+ *  - count of workers replacing the current ones, zero stops them.
+ * Return:
+ *  - WFE_SUCCESS.
+ *  - WFE_ASSET_INFLATE_COUNT if count is bigger than WFE_ASSET_MAX_INFLATE_WORKERS.
+ *  - WFE_ASSET_INFLATE_THREAD_ERROR if workers could not be started, none is left running.
+ */
+wfeError wfeAssetSetInflateWorkers(wfeSize count);
+
+/**
+ * Reads the counters of compressed entries, inflate rate is size over nanoseconds.
+ *
+ * Params:
+ *  - report (out) counters.
+ */
+void wfeAssetPackStats(wfeAssetPackReport *report);
+
+/**
+ * Writes the counters of compressed entries as a JSON object, along with the compression
+ * ratio and the inflate rate on MB/s.
+ *
+ * Params:
+ *  - out stream to write.
+ */
+void wfeAssetPackStatsDump(FILE *out);
+
 /**
  * Loads a raw asset from disc to memory as buffer on a pool.
+ * Mounted packs are looked up first, then the search path.
  *
  * Params:
  *  - name and folder of asset
@@ -37,8 +253,94 @@ void wfeAssetSetSearchPath(wfeChar *searchPath);
  */
 wfeError wfeAssetLoadRaw(const wfeChar *name, const wfeChar *ext, wfePool *pool, const wfeData **data, wfeSize *size);
 
+#define WFE_ASSET_BATCH_NO_URING ((wfeUint32) 0x1) // Skip io_uring even when available
+
+/**
+ * Asset of a batch, name and ext are read and the rest is written by wfeAssetLoadBatch.
+ */
+typedef struct wfeAssetBatchItem {
+    const wfeChar *name;
+    const wfeChar *ext;
+    const wfeData *data;
+    wfeSize size;
+    wfeError status; // Same results as wfeAssetLoadRaw
+} wfeAssetBatchItem;
+
+/**
+ * Loads many raw assets at once, much cheaper than calling wfeAssetLoadRaw for each one when
+ * assets are small. On Linux opens, stats, reads and closes are submitted in batches through
+ * io_uring, reading into pool buffers registered with the kernel. Elsewhere, or when io_uring
+ * is not available, assets are read with pread (stdio on systems without it).
+ *
+ * Params:
+ *  - items to load, each one gets its own result.
+ *  - count of items.
+ *  - pool to allocate memory.
+ *  - flags WFE_ASSET_BATCH_* options.
+ *
+ * Return:
+ *  - WFE_SUCCESS if every asset could be loaded.
+ *  - WFE_POOL_* in case that pool returns error, remaining items are not loaded.
+ *  - Result of first item that failed otherwise.
+ */
+wfeError wfeAssetLoadBatch(wfeAssetBatchItem *items, wfeSize count, wfePool *pool, wfeUint32 flags);
+
+/**
+ * Maps a raw asset instead of copying it to a pool, data is read from the page cache as it
+ * is touched and shares resident memory with it. Suited to big read-only assets, small
+ * ones are cheaper with wfeAssetLoadRaw. Mapping lives until wfeAssetUnmapRaw.
+ *
+ * Params:
+ *  - name and folder of asset
+ *  - ext for extension of asset
+ *  - pool for temporary memory, nothing is left on it.
+ *  - advice WFE_VMEM_* access pattern hint (e.g. WFE_VMEM_SEQUENTIAL for parsers).
+ *  - mapping (out) data and size of asset.
+ *
+ * Return:
+ *  - WFE_SUCCESS if asset could be mapped.
+ *  - WFE_POOL_* in case that pool returns error.
+ *  - WFE_ASSET_FILE_ACCESS_ERROR if file does not exists, is empty or unable to map.
+ */
+wfeError wfeAssetMapRaw(const wfeChar *name, const wfeChar *ext, wfePool *pool, wfeUint32 advice, wfeAssetMapping *mapping);
+
+/**
+ * Unmaps an asset mapped with wfeAssetMapRaw, data should not be used anymore.
+ *
+ * Params:
+ *  - mapping to release.
+ */
+void wfeAssetUnmapRaw(wfeAssetMapping *mapping);
+
+/**
+ * Reads a raw asset in chunks instead of at once, so assets of any size take a fixed amount
+ * of memory: depth buffers of chunk bytes. A read-ahead thread fills the buffers while
+ * callback processes them on the calling thread, so decoding overlaps disk reads. Returns
+ * once every chunk is delivered or callback stops.
+ *
+ * Assets served by packs are loaded whole and then delivered in chunks.
+ * Params:
+ *  - name and folder of asset.
+ *  - ext for extension of asset.
+ *  - pool for the ring of buffers, nothing is left on it.
+ *  - chunk bytes of each buffer, e.g. 1 MB.
+ *  - depth count of buffers, two or more. Bigger rings absorb uneven callbacks.
+ *  - callback that consumes chunks in order.
+ *  - userdata to pass to callback.
+ * Return:
+ *  - WFE_SUCCESS if every chunk was delivered or callback returned WFE_DONE.
+ *  - Failure returned by callback.
+ *  - WFE_ASSET_FILE_ACCESS_ERROR if file does not exists or is unable to read.
+ *  - WFE_DID_NOT_READ_ALL_FILE if a read failed after some chunks were delivered.
+ *  - WFE_ASSET_STREAM_THREAD_ERROR if read-ahead could not be started.
+ *  - WFE_POOL_* in case that pool returns error.
+ */
+wfeError wfeAssetStreamRaw(const wfeChar *name, const wfeChar *ext, wfePool *pool, wfeSize chunk, wfeSize depth,
+                           wfeAssetStreamCallback callback, wfeAny userdata);
+
 /**
  * Loads description asset, used as replacement for JSON and XML.
+ * File data and decoded tree are both placed on pool, desc is valid until pool recycles.
  *
  * Params:
  *  - name of description, without extension.
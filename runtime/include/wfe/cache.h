@@ -0,0 +1,177 @@
+#ifndef WFE_CACHE_H
+#define WFE_CACHE_H
+#include <wfe/types.h>
+#include <wfe/pool.h>
+#include <wfe/desc.h>
+#include <wfx/hashmap.h>
+
+#define WFE_CACHE_OMEM WFE_MAKE_MEMORY_ERROR(70) // No memory for an entry or its key
+
+/**
+ * Data and tree of an entry replaced while it was referenced, kept for its holders.
+ */
+typedef struct wfeCacheRetired {
+    struct wfeCacheRetired *next;
+    wfeData *data;   // Replaced data, NULL if it shared the allocation of the entry
+    wfeBool decoded; // Whether desc holds a tree to release
+    wfeDesc desc;
+} wfeCacheRetired;
+
+/**
+ * Cached asset, shared by every holder of a reference.
+ */
+typedef struct wfeCacheEntry {
+    const wfeChar *key; // Name and extension, key on the map
+    const wfeData *data;
+    wfeSize size;
+    wfeSize refs;       // Holders, entry is only evicted at zero
+    wfeSize cost;       // Bytes counted against the budget
+    wfeUint32 version;  // Bumped each time data is replaced
+    wfeBool decoded;    // Whether desc holds the decoded data
+    wfeDesc desc;
+    wfeData *replaced;  // Data given by wfeCacheReplace, owned by entry
+    wfeCacheRetired *retired; // Previous data still read by holders, released at zero references
+    struct wfeCacheEntry *prev, *next; // Place on LRU list while not referenced
+} wfeCacheEntry;
+
+/**
+ * Counters of a cache since init.
+ */
+typedef struct wfeCacheStats {
+    wfeSize hits;
+    wfeSize misses;
+    wfeSize evictions;
+    wfeSize entries; // Entries on cache, referenced or not
+    wfeSize bytes;   // Cost of every entry on cache
+} wfeCacheStats;
+
+/**
+ * Cache of raw and desc assets keyed by name and extension. Acquiring an asset returns
+ * a shared entry and takes a reference, releasing the last reference keeps the entry on
+ * memory until the cost of entries goes over the budget, then entries that are not
+ * referenced are evicted from the least recently released.
+ *
+ * Cost of an entry is the size of its file, decoded desc trees are not counted. Referenced
+ * entries are never evicted, so the budget is exceeded while they are held.
+ *
+ * Warning: no thread-safe, use from a single thread (usually the game loop).
+ */
+typedef struct wfeCache {
+    wfeHashmap map;       // Key to entry
+    wfePool scratch;      // Files are read here before being copied to their entry
+    wfeCacheEntry *head;  // Least recently released entry without references
+    wfeCacheEntry *tail;  // Most recently released entry without references
+    wfeSize budget;
+    wfeCacheStats stats;
+} wfeCache;
+
+/**
+ * Initializes an empty cache.
+ *
+ * Params:
+ *  - cache to initialize.
+ *  - budget in bytes for entries.
+ * Return:
+ *  - WFE_SUCCESS.
+ *  - WFE_HASHMAP_OMEM_ELEMENT if no memory is available for the map.
+ */
+wfeError wfeCacheInit(wfeCache *cache, wfeSize budget);
+
+/**
+ * Releases every entry, referenced or not, and the cache itself.
+ *
+ * Params:
+ *  - cache to finalize.
+ */
+void wfeCacheFinalize(wfeCache *cache);
+
+/**
+ * Looks up an asset on the cache, loading it with wfeAssetLoadRaw on a miss, and takes a
+ * reference to it.
+ *
+ * Params:
+ *  - cache to look up.
+ *  - name and folder of asset.
+ *  - ext for extension of asset.
+ *  - entry (out) shared entry, data and size are read only.
+ * Return:
+ *  - WFE_SUCCESS if entry is referenced.
+ *  - WFE_CACHE_OMEM if no memory is available for a new entry.
+ *  - WFE_HASHMAP_OMEM_REHASH if no memory is available to grow the map.
+ *  - All errors from wfeAssetLoadRaw.
+ */
+wfeError wfeCacheAcquire(wfeCache *cache, const wfeChar *name, const wfeChar *ext, wfeCacheEntry **entry);
+
+/**
+ * Same as wfeCacheAcquire for desc assets, tree is decoded once by the first acquire and
+ * shared by every holder.
+ *
+ * Params:
+ *  - cache to look up.
+ *  - name of description, without extension.
+ *  - entry (out) shared entry.
+ *  - desc (out) copy of decoded desc with its own cursor, valid while entry is referenced.
+ *    It must not be finalized.
+ * Return:
+ *  - WFE_SUCCESS if entry is referenced.
+ *  - All errors from wfeCacheAcquire and wfeDescDecodeBuffer, no reference is kept on errors.
+ */
+wfeError wfeCacheAcquireDesc(wfeCache *cache, const wfeChar *name, wfeCacheEntry **entry, wfeDesc *desc);
+
+/**
+ * Copies the decoded desc of an entry, holders take a fresh copy after the entry is replaced.
+ *
+ * Params:
+ *  - entry acquired with wfeCacheAcquireDesc.
+ *  - desc (out) copy of decoded desc with its own cursor. It must not be finalized.
+ */
+void wfeCacheEntryDesc(wfeCacheEntry *entry, wfeDesc *desc);
+
+/**
+ * Replaces the data of a cached entry, e.g. after its file changed. Entry keeps its address,
+ * so holders keep their references and read data, size and desc again to see the change.
+ * Decoded descs are decoded again. While the entry is referenced the old data and tree stay
+ * valid, so pointers and desc copies taken before keep working until the last release.
+ *
+ * Params:
+ *  - cache owner of entry.
+ *  - key name with extension of entry (e.g. "level1/door.desc").
+ *  - data new content allocated with malloc, owned by the entry on success.
+ *  - size of data.
+ * Return:
+ *  - WFE_SUCCESS if entry is replaced.
+ *  - WFE_HASHMAP_MISSING if key is not cached, data still belongs to caller.
+ *  - WFE_CACHE_OMEM if old data could not be kept for holders, entry is left as is and
+ *    data still belongs to caller.
+ *  - All errors from wfeDescDecodeBuffer, entry is replaced but left without desc.
+ */
+wfeError wfeCacheReplace(wfeCache *cache, const wfeChar *key, wfeData *data, wfeSize size);
+
+/**
+ * Drops a reference to an entry, the entry stays on cache while it fits on the budget.
+ *
+ * Params:
+ *  - cache owner of entry.
+ *  - entry acquired from cache.
+ */
+void wfeCacheRelease(wfeCache *cache, wfeCacheEntry *entry);
+
+/**
+ * Changes the budget of a cache, evicting entries without references that do not fit.
+ *
+ * Params:
+ *  - cache to change.
+ *  - budget in bytes for entries, zero keeps only referenced entries.
+ */
+void wfeCacheSetBudget(wfeCache *cache, wfeSize budget);
+
+/**
+ * Reads the counters of a cache.
+ *
+ * Params:
+ *  - cache to inspect.
+ *  - stats (out) counters.
+ */
+void wfeCacheReadStats(wfeCache *cache, wfeCacheStats *stats);
+
+#endif /* WFE_CACHE_H */
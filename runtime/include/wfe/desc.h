@@ -1,6 +1,7 @@
 #ifndef WFE_DESC_H
 #define WFE_DESC_H
 #include <wfe/types.h>
+#include <wfe/pool.h>
 #include <msgpack.h>
 
 #define WFE_DESC_UNSUPPORTED_TYPE WFE_MAKE_API_ERROR(40)
@@ -51,6 +52,26 @@ void wfeDescFinalize(wfeDesc *desc);
  */
 wfeError wfeDescDecodeBuffer(wfeDesc *desc, const wfeData *buf, const wfeSize len);
 
+/**
+ * Decodes a msgpack map from a raw buffer, placing the object tree on a pool instead of a
+ * msgpack zone. Buffer is measured first, so decoding does a single pool request and no heap
+ * allocations. Tree lives until pool is recycled or finalized, wfeDescFinalize is not needed
+ * but stays harmless.
+ *
+ * Warning: strings and keys reference buf, which should live as long as the tree.
+ * Params:
+ *  - desc to link buffer.
+ *  - pool to allocate object tree.
+ *  - buf of bytes with msgpack encoded data.
+ *  - len of buffer.
+ * Return:
+ *  - WFE_SUCCESS when map have been loaded.
+ *  - WFE_DESC_UNSUPPORTED_TYPE if first type on msgpack is not a map.
+ *  - WFE_DESC_MAGPACK_ERROR when buffer is truncated or msgpack returns an error.
+ *  - WFE_POOL_* in case that pool returns error.
+ */
+wfeError wfeDescDecodeBufferPool(wfeDesc *desc, wfePool *pool, const wfeData *buf, const wfeSize len);
+
 /**
  * Looks for the next key on the description.
  *
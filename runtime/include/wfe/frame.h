@@ -0,0 +1,109 @@
+#ifndef WFE_FRAME_H
+#define WFE_FRAME_H
+#include <wfe/types.h>
+#include <wfe/pool.h>
+
+#define WFE_FRAME_MAX_POOLS 4
+#define WFE_FRAME_INVALID_COUNT WFE_MAKE_API_ERROR(30)
+
+/**
+ * Blocks until the consumer of a frame (i.e. the GPU) is done with it and releases the fence.
+ *
+ * Prototype params:
+ *  - (1) wfeAny fence given to wfeFrameEnd.
+ *  - (2) wfeAny userdata given to wfeFrameSetFence.
+ */
+typedef void (*wfeFrameFenceWait)(wfeAny, wfeAny);
+
+/**
+ * Transient allocator for data that lives one or two frames (command lists, culling results,
+ * per-frame uniforms...).
+ *
+ * Rotates a small set of pools, one per frame in flight. When a pool comes back to the front
+ * its fence is waited and the pool is recycled as a whole, there are no per-object releases.
+ *
+ * Warning: not thread-safe.
+ */
+typedef struct wfeFrameAllocator {
+    wfePool pools[WFE_FRAME_MAX_POOLS];
+    wfeAny fences[WFE_FRAME_MAX_POOLS]; // Fence of last frame served by each pool
+    wfeSize count;   // Count of pools in rotation (frames in flight)
+    wfeSize current; // Pool of the current frame
+    wfeUint64 frame; // Count of started frames
+    wfeFrameFenceWait wait;
+    wfeAny userdata;
+} wfeFrameAllocator;
+
+/**
+ * Initializes a frame allocator, pools do not request memory until first used.
+ *
+ * Params:
+ *  - frames allocator to initialize.
+ *  - count of frames in flight, 2 for double buffering, up to WFE_FRAME_MAX_POOLS.
+ * Return:
+ *  - WFE_SUCCESS.
+ *  - WFE_FRAME_INVALID_COUNT if count is zero or bigger than WFE_FRAME_MAX_POOLS.
+ */
+wfeError wfeFrameInit(wfeFrameAllocator *frames, wfeSize count);
+
+/**
+ * Releases all pools of the allocator, pending fences are waited first.
+ *
+ * Params:
+ *  - frames allocator to finalize.
+ */
+void wfeFrameFinalize(wfeFrameAllocator *frames);
+
+/**
+ * Sets the callback used to wait fences, without one frames are considered consumed as soon
+ * as they end.
+ *
+ * Params:
+ *  - frames allocator to configure.
+ *  - wait callback, NULL to disable fences.
+ *  - userdata to pass to callback.
+ */
+void wfeFrameSetFence(wfeFrameAllocator *frames, wfeFrameFenceWait wait, wfeAny userdata);
+
+/**
+ * Starts a new frame, moving to the next pool of the rotation. If the pool still has a fence
+ * the call blocks on it and then recycles the pool.
+ *
+ * Params:
+ *  - frames allocator.
+ */
+void wfeFrameBegin(wfeFrameAllocator *frames);
+
+/**
+ * Ends current frame, its pool will not be recycled until fence has passed.
+ *
+ * Params:
+ *  - frames allocator.
+ *  - fence signaled when the consumer is done with the frame, NULL if none.
+ */
+void wfeFrameEnd(wfeFrameAllocator *frames, wfeAny fence);
+
+/**
+ * Returns the pool of the current frame.
+ *
+ * Params:
+ *  - frames allocator.
+ * Return:
+ *  - Pool that lives until this frame's fence passes.
+ */
+wfePool *wfeFramePool(wfeFrameAllocator *frames);
+
+/**
+ * Requests memory from the pool of the current frame, same as wfePoolGet.
+ *
+ * Params:
+ *  - frames allocator.
+ *  - size of required block.
+ *  - align of type, use wfeAlignOf to get the aligment.
+ * Returns:
+ *  - NULL if could not allocate, check wfeFramePool(frames)->lastError.
+ *  - An aligned pointer valid until this frame's fence passes.
+ */
+wfeData *wfeFrameGet(wfeFrameAllocator *frames, wfeSize size, wfeSize align);
+
+#endif /* WFE_FRAME_H */
@@ -1,10 +1,12 @@
 #ifndef WFE_GAME_H
 #define WFE_GAME_H
 #include <wfe/types.h>
+#include <wfe/pool.h>
 
 #define WFE_WINDOW_DEFAULT_HEIGHT 800
 #define WFE_WINDOW_DEFAULT_WIDTH 600
 #define WFE_WINDOW_DEFAULT_TITLE "WhiteFire Game Engine 1.0"
+#define WFE_GAME_FRAMES 2 // Frames in flight served by the frame allocator
 
 #define WFE_GAME_OMEM WFE_MAKE_MEMORY_ERROR(21)
 #define WFE_GLFW_INIT_ERROR WFE_MAKE_API_ERROR(22)
@@ -65,5 +67,46 @@ wfeError wfeGameLastError(wfeGame *game);
  */
 wfeAny wfeGameGetContext(wfeGame *game);
 
+/**
+ * Starts a new frame, rotating the frame allocator. Blocks if the GPU is still using the
+ * memory of the oldest frame in flight.
+ *
+ * Note: wfeGameMake starts the first frame and wfeGameStep starts the following ones, only
+ * loops that swap buffers on their own need this.
+ * Params:
+ *  - game to start frame.
+ */
+void wfeGameBeginFrame(wfeGame *game);
+
+/**
+ * Ends current frame, placing a fence so its memory is recycled once the GPU is done with it.
+ *
+ * Params:
+ *  - game to end frame.
+ */
+void wfeGameEndFrame(wfeGame *game);
+
+/**
+ * Returns the pool of the current frame, use it for transient data instead of malloc.
+ *
+ * Warning: memory is recycled WFE_GAME_FRAMES frames later, do not keep references.
+ * Params:
+ *  - game owner of frame allocator.
+ * Return:
+ *  - Pool of the current frame.
+ */
+wfePool *wfeGameFramePool(wfeGame *game);
+
+/**
+ * Ends current frame, presents it and starts the next one: frame end, buffer swap, event
+ * polling and frame begin, in that order. Call once per iteration of the game loop.
+ *
+ * Params:
+ *  - game to step.
+ * Return:
+ *  - WFE_TRUE while the game should keep running, WFE_FALSE once its window is closing.
+ */
+wfeBool wfeGameStep(wfeGame *game);
+
 
 #endif /* WFE_GAME_H */
@@ -0,0 +1,173 @@
+#ifndef WFE_LOADER_H
+#define WFE_LOADER_H
+#include <wfe/types.h>
+#include <wfe/pool.h>
+#include <threads.h>
+
+#define WFE_LOADER_MAX_WORKERS 8
+#define WFE_LOADER_MAX_REQUESTS 256
+#define WFE_LOADER_INVALID_COUNT WFE_MAKE_API_ERROR(60) // Count of workers is zero or too big
+#define WFE_LOADER_FULL WFE_MAKE_API_ERROR(61)          // Every request slot is in use
+#define WFE_LOADER_THREAD_ERROR WFE_MAKE_FAILURE(62)    // Workers or their locks could not be created
+
+#define WFE_LOADER_FREE ((wfeUint32) 0)    // Slot available
+#define WFE_LOADER_QUEUED ((wfeUint32) 1)  // Waiting for a worker
+#define WFE_LOADER_LOADING ((wfeUint32) 2) // Read by a worker
+#define WFE_LOADER_DONE ((wfeUint32) 3)    // Waiting for wfeLoaderPump
+
+/**
+ * Identifies a request, zero is never a valid ticket.
+ */
+typedef wfeUint64 wfeLoaderTicket;
+
+/**
+ * Receives a finished request, always called by the thread running wfeLoaderPump.
+ *
+ * Prototype params:
+ *  - (1) wfeLoaderTicket of request.
+ *  - (2) wfeError result of load, same as wfeAssetLoadRaw.
+ *  - (3) const wfeData * data of asset, on the pool given to the request. NULL on failure.
+ *  - (4) wfeSize size of data.
+ *  - (5) wfeAny userdata given to the request.
+ */
+typedef void (*wfeLoaderCallback)(wfeLoaderTicket, wfeError, const wfeData *, wfeSize, wfeAny);
+
+/**
+ * Load request, lives on a slot of the loader.
+ */
+typedef struct wfeLoaderRequest {
+    const wfeChar *name;
+    const wfeChar *ext;
+    wfePool *pool; // Pool that receives data
+    wfeLoaderCallback callback;
+    wfeAny userdata;
+    const wfeData *data;
+    wfeSize size;
+    wfeError status;
+    struct wfeLoaderWorker *worker; // Worker whose pool holds data until pump copies it, NULL if data is on pool
+    wfeUint32 state;      // WFE_LOADER_* state
+    wfeUint32 generation; // Bumped each time slot is released, stale tickets do not match
+} wfeLoaderRequest;
+
+/**
+ * I/O thread and the pool it reads into.
+ */
+typedef struct wfeLoaderWorker {
+    struct wfeLoader *loader;
+    wfePool pool;   // Bound to loader store, recycled once nothing waits on it
+    wfeSize staged; // Finished requests whose data waits on pool, guarded by loader lock
+    thrd_t thread;
+} wfeLoaderWorker;
+
+/**
+ * Background asset loader. Requests are queued by one thread (usually the game loop), read by
+ * a set of worker threads and delivered back to the queuing thread by wfeLoaderPump, so
+ * callbacks never run concurrently with the game.
+ *
+ * Workers read into their own pools. Assets big enough to be large objects have a mapping
+ * sized to the file, which is handed off to the pool of the request without copying (see
+ * wfePoolHandoffObject). Smaller assets wait on the pool of the worker and are copied into
+ * the pool of the request by wfeLoaderPump, so a small asset never pins a whole block on the
+ * pool of the request.
+ *
+ * Warning: loader must not move after wfeLoaderInit. Submit, pump and finalize from a single
+ * thread, poll and wait from any.
+ */
+typedef struct wfeLoader {
+    wfeLoaderRequest requests[WFE_LOADER_MAX_REQUESTS];
+    wfeUint32 queue[WFE_LOADER_MAX_REQUESTS]; // Ring of queued slots
+    wfeUint32 done[WFE_LOADER_MAX_REQUESTS];  // Ring of finished slots
+    wfeUint32 free[WFE_LOADER_MAX_REQUESTS];  // Stack of available slots
+    wfeSize queueHead, queueCount;
+    wfeSize doneHead, doneCount;
+    wfeSize freeCount;
+
+    wfeLoaderWorker workers[WFE_LOADER_MAX_WORKERS];
+    wfeSize count; // Count of workers
+    wfePoolShared shared;
+    mtx_t lock;
+    cnd_t wake;     // Signals workers about new requests or stop
+    cnd_t finished; // Signals waiters about finished requests
+    wfeBool stop;
+} wfeLoader;
+
+/**
+ * Initializes a loader and starts its workers.
+ *
+ * Params:
+ *  - loader to initialize.
+ *  - count of worker threads, up to WFE_LOADER_MAX_WORKERS. Two or three cover most disks.
+ * Return:
+ *  - WFE_SUCCESS.
+ *  - WFE_LOADER_INVALID_COUNT if count is zero or bigger than WFE_LOADER_MAX_WORKERS.
+ *  - WFE_LOADER_THREAD_ERROR if workers could not be started, loader is left finalized.
+ */
+wfeError wfeLoaderInit(wfeLoader *loader, wfeSize count);
+
+/**
+ * Stops workers, waiting for the requests they are reading, and releases the loader.
+ * Requests that were not delivered are dropped without calling their callbacks.
+ *
+ * Warning: pools bound to loader->shared must be finalized before.
+ * Params:
+ *  - loader to finalize.
+ */
+void wfeLoaderFinalize(wfeLoader *loader);
+
+/**
+ * Queues the load of a raw asset (see wfeAssetLoadRaw) and returns immediately.
+ *
+ * Warning: name and ext must live until the request is delivered, data lives on pool until
+ * pool is recycled or finalized, which should not happen before delivery.
+ * Params:
+ *  - loader to queue request on.
+ *  - name and folder of asset.
+ *  - ext for extension of asset.
+ *  - pool that receives data.
+ *  - callback called by wfeLoaderPump once the request finishes, might be NULL.
+ *  - userdata to pass to callback.
+ *  - ticket (out) identifier of request.
+ * Return:
+ *  - WFE_SUCCESS if request is queued.
+ *  - WFE_LOADER_FULL if WFE_LOADER_MAX_REQUESTS are waiting for workers or delivery.
+ */
+wfeError wfeLoaderSubmit(wfeLoader *loader, const wfeChar *name, const wfeChar *ext, wfePool *pool,
+                         wfeLoaderCallback callback, wfeAny userdata, wfeLoaderTicket *ticket);
+
+/**
+ * Checks a request without blocking.
+ *
+ * Params:
+ *  - loader of request.
+ *  - ticket of request.
+ * Return:
+ *  - WFE_CONTINUE while the request is queued or being read, check with WFE_SHOULD_CONTINUE.
+ *  - Result of load once finished and not delivered yet.
+ *  - WFE_DONE if it was already delivered, callback got the result.
+ */
+wfeError wfeLoaderPoll(wfeLoader *loader, wfeLoaderTicket ticket);
+
+/**
+ * Blocks until a request finishes, callback still waits for wfeLoaderPump.
+ *
+ * Params:
+ *  - loader of request.
+ *  - ticket of request.
+ * Return:
+ *  - Same as wfeLoaderPoll, but never WFE_CONTINUE.
+ */
+wfeError wfeLoaderWait(wfeLoader *loader, wfeLoaderTicket ticket);
+
+/**
+ * Delivers finished requests calling their callbacks on this thread, in the order workers
+ * finished them. Call once per frame, limiting max keeps big batches from stalling a frame.
+ *
+ * Params:
+ *  - loader to pump.
+ *  - max count of requests to deliver, zero for all.
+ * Returns:
+ *  - Count of delivered requests.
+ */
+wfeSize wfeLoaderPump(wfeLoader *loader, wfeSize max);
+
+#endif /* WFE_LOADER_H */
@@ -1,6 +1,8 @@
 #ifndef WFE_POOL_H
 #define WFE_POOL_H
 #include <wfe/types.h>
+#include <stdio.h>
+#include <stdatomic.h>
 
 #define WFE_POOL_TINY   ((wfeSize) 128)         // 128 B
 #define WFE_POOL_SMALL  ((wfeSize) 1024)        // 1 KB
@@ -11,7 +13,40 @@
 #define WFE_POOL_OMEM_CHUNK WFE_MAKE_MEMORY_ERROR(11)
 #define WFE_POOL_OMEM_BLOCK WFE_MAKE_MEMORY_ERROR(12)
 #define WFE_POOL_OMEM_TIER WFE_MAKE_MEMORY_ERROR(13)
-#define wfePoolMemoryAlign(ptr,offset) ((ptr+(offset-1)) & 0xfffffffc)
+#define WFE_POOL_NOT_SLAB WFE_MAKE_API_ERROR(14)
+#define WFE_POOL_STATS_DISABLED WFE_MAKE_API_ERROR(15)
+#define WFE_POOL_NOT_LAST WFE_MAKE_API_ERROR(16)
+#define WFE_POOL_IMAGE_STALE WFE_MAKE_FILE_ERROR(17)   // Image is missing, corrupt or built from other sources
+#define WFE_POOL_IMAGE_WRITE WFE_MAKE_FILE_ERROR(18)   // Image could not be written
+#define WFE_POOL_IMAGE_OUTSIDE WFE_MAKE_API_ERROR(19)  // Pointer or slot is not on pool memory
+#define WFE_POOL_SLOT_SIZE WFE_MAKE_API_ERROR(20)      // Request is bigger than a slot of slab tier
+#define WFE_POOL_OBJECT_HEADER ((wfeSize) 64)       // Bytes before each large object, keeps it cache line aligned
+#define WFE_POOL_OBJECT_CACHE  ((wfeSize) 268435456) // 256 MB of released large objects kept for re-use
+#define wfePoolMemoryAlign(ptr,offset) (((ptr) + ((offset)-1)) & ~((wfeSize) (offset)-1)) // Rounds up to a power of two
+
+#define WFE_POOL_BACKEND_HEAP       ((wfeUint32) 0x0)   // calloc/free blocks
+#define WFE_POOL_BACKEND_MMAP       ((wfeUint32) 0x1)   // Lazily committed virtual memory blocks
+#define WFE_POOL_BACKEND_ARENA      ((wfeUint32) 0x2)   // One reserved range per tier, committed as head advances
+#define WFE_POOL_BACKEND_HUGE_PAGES ((wfeUint32) 0x100) // Huge pages for large and huge tiers (mmap only)
+#define WFE_POOL_BACKEND_MASK       ((wfeUint32) 0xff)
+
+#define WFE_POOL_ARENA_RESERVE ((wfeSize) 1073741824) // 1 GB of address space per arena tier
+#define WFE_POOL_ARENA_COMMIT  ((wfeSize) 65536)      // 64 KB, least growth of committed pages
+
+#define WFE_POOL_TIER_TINY   0
+#define WFE_POOL_TIER_SMALL  1
+#define WFE_POOL_TIER_MEDIUM 2
+#define WFE_POOL_TIER_LARGE  3
+#define WFE_POOL_TIER_HUGE   4
+#define WFE_POOL_TIER_CUSTOM 5
+#define WFE_POOL_TIERS       6  // Count of size tiers, custom included
+#define WFE_POOL_CLASSES     32 // Power-of-two size classes, 1 B up to 2 GB
+
+#define WFE_POOL_TRIM_NONE    0  // Keep every block (default)
+#define WFE_POOL_TRIM_BLOCKS  1  // Keep the first <limit> blocks of the chain
+#define WFE_POOL_TRIM_BYTES   2  // Keep blocks while the chain fits in <limit> bytes
+#define WFE_POOL_TRIM_DECAY   3  // Keep the biggest footprint of the last <limit> recycles
+#define WFE_POOL_TRIM_HISTORY 16 // Recycles remembered by WFE_POOL_TRIM_DECAY
 
 /**
  * References for a chunk memory allocation.
@@ -21,38 +56,224 @@ typedef struct wfePoolBlock {
     wfeData *start; // Start of block
     wfeData *head;  // Current available memory
     wfeData *end;   // End of block (start+size)
+    wfeUint32 backend; // WFE_POOL_BACKEND_* used to request memory
+    wfeBool resident;  // Pages might be backed by physical memory (mmap only)
+    wfeData *committed; // End of pages ready to be used, end unless block is an arena
 } wfePoolBlock;
 
+/**
+ * Counters of a tier, only collected when runtime is compiled with WFE_POOL_STATS.
+ */
+typedef struct wfePoolTierStats {
+    wfeSize requests;   // Count of served requests
+    wfeSize requested;  // Bytes asked by callers
+    wfeSize served;     // Bytes taken from blocks, served - requested is internal waste
+    wfeSize tailWaste;  // Bytes left at the end of blocks when moving to next one
+    wfeSize used;       // Bytes taken since last recycle, tails included
+    wfeSize peak;       // Highest value of used
+    wfeSize blocks;     // Length of the block chain
+    wfeSize recycles;   // Count of recycles
+    wfeSize histogram[WFE_POOL_CLASSES]; // Requests per size class
+} wfePoolTierStats;
+
+/**
+ * Bytes in use on every tier and large object of a pool, only collected with WFE_POOL_STATS.
+ */
+typedef struct wfePoolUsage {
+    wfeSize used;
+    wfeSize peak; // High-water mark of used
+} wfePoolUsage;
+
 /**
  * A size-based tier of chunks.
+ *
+ * When slot is not zero the tier works as a slab: every request takes a whole slot
+ * and released slots are linked through their own memory to be re-used.
  */
 typedef struct wfePoolTier {
     wfePoolBlock *first, *current;
     wfeSize size;
+    wfeUint32 backend;  // WFE_POOL_BACKEND_* for new blocks
+    wfeSize slot;       // Size of each object on slab mode, zero otherwise
+    wfeData *freeList;  // Released slots, each one stores the next one
+    wfeSize freeCount;  // Count of slots on free list
+    wfeSize freeFloor;  // Lowest free count since last mark, slots below it were not handed out
+    wfeSize live;       // Count of slots in use
+    wfeSize reused;     // Requests served from free list
+    wfeData *last;      // Last object served by current block, the only one that can be extended
+    struct wfePoolShared *shared; // Store of spare blocks, NULL if tier is not shared
+    struct wfePool *parent; // Pool that leases blocks to the tier, NULL if pool is not a child
+    wfeSize index;          // WFE_POOL_TIER_* of tier on its pool
+    wfeUint32 trim;     // WFE_POOL_TRIM_* applied on recycle
+    wfeSize trimLimit;  // Blocks, bytes or recycles depending on trim
+    wfeSize history[WFE_POOL_TRIM_HISTORY]; // Bytes of blocks reached on each recycle, circular
+    wfeSize cycles;     // Count of recycles, next history entry is cycles % WFE_POOL_TRIM_HISTORY
+#ifdef WFE_POOL_STATS
+    wfePoolTierStats stats;
+    wfePoolUsage *usage; // Usage of the pool of the tier, NULL for lonely tiers
+#endif
 } wfePoolTier;
 
+/**
+ * Occupancy report of a slab tier.
+ */
+typedef struct wfePoolOccupancy {
+    wfeSize capacity; // Slots that fit in the block chain
+    wfeSize live;     // Slots in use
+    wfeSize free;     // Released slots waiting to be re-used
+    wfeSize reused;   // Requests served from released slots
+} wfePoolOccupancy;
+
+/**
+ * Header of a large object, stored right before the object on its own mapping.
+ */
+typedef struct wfePoolObject {
+    struct wfePoolObject *prev, *next;    // Live list or cache bucket
+    struct wfePoolObject *older, *newer;  // Cache ordered by release time
+    struct wfePoolObjects *owner;         // Allocator that mapped the object
+    wfeSize size;                         // Mapped bytes, header included
+    wfeSize serial;                       // Order of request, used to rewind
+    wfeSize offset;                       // Bytes from header to object, WFE_POOL_OBJECT_HEADER unless aligned further
+} wfePoolObject;
+
+/**
+ * Allocator of requests too big for the size tiers. Every object has its own mapping so it
+ * can be released individually, released mappings are cached by size class (in pages) and
+ * handed to later requests of similar size until the cache exceeds its limit.
+ */
+typedef struct wfePoolObjects {
+    wfePoolObject *live;                     // Objects in use, newest first
+    wfePoolObject *cache[WFE_POOL_CLASSES];  // Released mappings by page count class
+    wfePoolObject *oldest, *newest;          // Released mappings by age
+    wfeSize liveSize;   // Mapped bytes of objects in use
+    wfeSize cacheSize;  // Mapped bytes of released objects
+    wfeSize cacheLimit; // Biggest cacheSize before oldest mappings are unmapped
+    wfeSize serial;     // Serial of next object
+    wfeUint32 backend;  // WFE_POOL_BACKEND_HUGE_PAGES is honored
+#ifdef WFE_POOL_STATS
+    wfePoolTierStats stats;
+    wfePoolUsage *usage; // Usage of the pool of the allocator, NULL if not owned by a pool
+#endif
+} wfePoolObjects;
+
+/**
+ * Backing store of spare blocks shared by the pools of many threads, indexed by size tier.
+ * Pools bound to a store take blocks from it before requesting new memory and give blocks
+ * back to it when trimming or reclaiming handed off memory.
+ *
+ * Note: thread-safe, each tier is guarded by its own spin lock.
+ */
+typedef struct wfePoolShared {
+    atomic_flag locks[WFE_POOL_TIER_CUSTOM];
+    wfePoolBlock *blocks[WFE_POOL_TIER_CUSTOM]; // Spare blocks of each tier
+    wfeSize counts[WFE_POOL_TIER_CUSTOM];       // Count of spare blocks of each tier
+    atomic_size_t pools;                        // Pools bound to the store and not finalized yet
+} wfePoolShared;
+
+/**
+ * File image loaded on a pool, released on pool finalize.
+ */
+typedef struct wfePoolImage {
+    struct wfePoolImage *next;
+    wfeData *base; // Start of mapped file
+    wfeSize size;  // Bytes of file
+} wfePoolImage;
+
 /**
  * General propouse memory pool, objects are arranged
  * using size tiers.
  *
- * Warning: not thread-safe.
+ * Warning: not thread-safe, every thread needs its own pool. Pools bound to the same
+ * wfePoolShared store can hand their memory off to other pools with wfePoolHandoff.
  */
 typedef struct wfePool {
-    wfePoolTier* tiny;
-    wfePoolTier* small;
-    wfePoolTier* medium;
-    wfePoolTier* large;
-    wfePoolTier* huge;
-    wfePoolTier* custom;
+    union {
+        struct {
+            wfePoolTier* tiny;
+            wfePoolTier* small;
+            wfePoolTier* medium;
+            wfePoolTier* large;
+            wfePoolTier* huge;
+            wfePoolTier* custom; // Always NULL, custom requests are served by objects
+        };
+        wfePoolTier* tiers[WFE_POOL_TIERS];
+    };
     wfePoolTier* fixed;
+    wfePoolObjects objects; // Serves requests of the custom tier
+    wfePoolShared *shared;  // Store of spare blocks, NULL if pool is not shared
+    struct wfePool *parent; // Pool that leases blocks to this one, NULL if pool is not a child
+    wfePoolImage *images;   // Images loaded with wfePoolImageLoad
+    _Atomic(wfePoolBlock *) incoming;         // Blocks handed off by other pools
+    _Atomic(wfePoolObject *) incomingObjects; // Large objects handed off by other pools
     wfeNum threshold;
     wfeError lastError;
+    wfeUint32 backend; // WFE_POOL_BACKEND_* for new tiers
+    wfeUint32 trim;    // WFE_POOL_TRIM_* for new tiers
+    wfeSize trimLimit; // Limit of trim policy
+    wfeSize limits[WFE_POOL_TIERS];     // Biggest request served by each tier (size*threshold)
+    wfeUint8 classes[WFE_POOL_CLASSES]; // First tier that may serve each size class
+#ifdef WFE_POOL_STATS
+    wfePoolUsage usage;
+#endif
 } wfePool;
 
+/**
+ * Position of every tier of a pool, used to rewind temporary allocations.
+ */
+typedef struct wfePoolMarker {
+    wfePoolBlock *block[WFE_POOL_TIERS + 1]; // Current block of each tier, fixed one at last
+    wfeData *head[WFE_POOL_TIERS + 1];       // Head of each current block
+    wfeSize live;                            // Live objects of slab tier
+    wfeData *freeList;                       // Free list of slab tier
+    wfeSize freeCount;                       // Slots on free list of slab tier
+    wfeSize freeFloor;                       // Floor of slab tier before the mark
+    wfeSize serial;                          // Serial of next large object
+#ifdef WFE_POOL_STATS
+    wfeSize used[WFE_POOL_TIERS + 1];        // Used bytes of each tier
+#endif
+} wfePoolMarker;
+
+/**
+ * Snapshot of the counters of every tier of a pool, fixed one at last.
+ */
+typedef struct wfePoolReport {
+    wfePoolTierStats tiers[WFE_POOL_TIERS + 1];
+    wfeSize reserved[WFE_POOL_TIERS + 1]; // Bytes on block chain of each tier
+    wfePoolTierStats total;               // Sum of all tiers, peak is the high-water mark of the whole pool
+    wfeSize totalReserved;                // Bytes on all block chains
+} wfePoolReport;
+
+/**
+ * Calculates the power-of-two size class of a request, that is the smallest k
+ * that satisfies size <= 2^k.
+ *
+ * Params:
+ *  - size of the request.
+ * Returns:
+ *  - Size class, 0 for requests of one byte or less.
+ */
+static inline wfeSize wfePoolSizeClass(wfeSize size) {
+    if (size <= 1)
+        return 0;
+
+#if defined(__GNUC__) || defined(__clang__)
+    return (wfeSize) (sizeof(unsigned long long)*8 - __builtin_clzll((unsigned long long) (size-1)));
+#else
+    wfeSize k = 0;
+    size -= 1;
+    while (size != 0) {
+        size >>= 1;
+        k++;
+    }
+
+    return k;
+#endif
+}
+
 /**
  * Initializes a memory block.
  *
- * Requests memory using malloc and then prepares internal state to properly
+ * Requests memory using calloc and then prepares internal state to properly
  * accept memory writes and reads using pools API.
  *
  * Note: all requested memory is automatically initialized to zero.
@@ -66,6 +287,23 @@ typedef struct wfePool {
  */
 wfeError wfePoolBlockInit(wfePoolBlock *block, wfeSize size);
 
+/**
+ * Initializes a memory block using the given backend.
+ *
+ * WFE_POOL_BACKEND_MMAP maps virtual memory instead of calling calloc, pages read as zero
+ * and are only backed by physical memory once touched, so big blocks do not stall.
+ * WFE_POOL_BACKEND_ARENA only reserves the address range, pages are committed as the head
+ * of the block advances.
+ *
+ * Params:
+ *  - block of memory that is going to be initialized.
+ *  - size of memory chunk to be requested.
+ *  - backend WFE_POOL_BACKEND_* and options.
+ * Return:
+ *  - Same as wfePoolBlockInit.
+ */
+wfeError wfePoolBlockInitBackend(wfePoolBlock *block, wfeSize size, wfeUint32 backend);
+
 /**
  * Releases resources of a memory block.
  *
@@ -114,6 +352,18 @@ wfeSize wfePoolBlockTotalSize(wfePoolBlock *block);
  */
 wfeError wfePoolTierInit(wfePoolTier *tier, wfeSize size);
 
+/**
+ * Initializes a block tier whose blocks are requested using the given backend.
+ *
+ * Params:
+ *  - tier of blocks to initialize.
+ *  - size of each block on tier.
+ *  - backend WFE_POOL_BACKEND_* and options.
+ * Return:
+ *  - Same as wfePoolTierInit.
+ */
+wfeError wfePoolTierInitBackend(wfePoolTier *tier, wfeSize size, wfeUint32 backend);
+
 /**
  * Releases resources of a memory block tier.
  *
@@ -150,30 +400,182 @@ wfeSize wfePoolTierTotalSize(wfePoolTier *tier);
  * specified size and align. If size is bigger than maximum supported chunk size then
  * allocator will automatically request enough memory and will create a custom-size chunk.
  *
+ * Note: the pointer is aligned to any power of two up to the page size, padding is taken
+ * from the block. Slab tiers never pad: a slot is aligned to the lowest power of two of the
+ * slot size (a lonely slot to its block) and align must not go beyond it.
+ *
  * Params:
  *  - tier from memory is going to be taken.
  *  - size of wanted block.
- *  - align of object.
+ *  - align of object, power of two.
  * Returns:
  *  - NULL if could not allocate new block and tier's memory is exhausted.
+ *  - NULL if tier is a slab and size is bigger than a slot.
  *  - An aligned pointer to usable memory space (read and write, not thread safe).
  */
 wfeData *wfePoolTierGet(wfePoolTier *tier, wfeSize size, wfeSize align);
 
+/**
+ * Releases a single object of a slab tier, the slot will be handed by the next request.
+ *
+ * Warning: ptr must have been returned by wfePoolTierGet of the same tier.
+ * Params:
+ *  - tier on slab mode.
+ *  - ptr to object, NULL is ignored.
+ */
+void wfePoolTierFree(wfePoolTier *tier, wfeData *ptr);
+
+/**
+ * Reports the occupancy of a slab tier, capacity is zero when tier is not a slab.
+ *
+ * Params:
+ *  - tier to inspect.
+ *  - occupancy (out) report.
+ */
+void wfePoolTierOccupancy(wfePoolTier *tier, wfePoolOccupancy *occupancy);
+
 /**
  * Cleans up the registers of the tier without loosing or freeing requested memory.
  * Warning: This method does not call free at any time,
  * you also must finalize the tier after program executes.
  *
+ * Note: on mmap tiers, blocks that were not reached since the previous recycle give their
+ * pages back to the system, they stay on the chain and read as zero when re-used.
+ * Blocks beyond the trim policy of the tier are released, see wfePoolTierSetTrim.
+ *
  * Params:
  *  - tier of memory to recycle.
  */
 void wfePoolTierRecycle(wfePoolTier *tier);
 
+/**
+ * Sets the retention policy applied by wfePoolTierRecycle. Recycled tiers are filled from
+ * the first block, so the front of the chain holds the most recently used blocks and only
+ * the tail of the chain is released. The first block is always kept.
+ *
+ *  - WFE_POOL_TRIM_NONE keeps every block, limit is ignored.
+ *  - WFE_POOL_TRIM_BLOCKS keeps the first <limit> blocks.
+ *  - WFE_POOL_TRIM_BYTES keeps blocks while their total size is at most <limit> bytes.
+ *  - WFE_POOL_TRIM_DECAY keeps as many bytes as the biggest footprint of the last <limit>
+ *    recycles (up to WFE_POOL_TRIM_HISTORY), so memory of a spike is released once the
+ *    spike leaves the window.
+ *
+ * Params:
+ *  - tier to configure.
+ *  - trim WFE_POOL_TRIM_* policy.
+ *  - limit of policy.
+ */
+void wfePoolTierSetTrim(wfePoolTier *tier, wfeUint32 trim, wfeSize limit);
+
+/**
+ * Initializes an allocator of large objects.
+ *
+ * Params:
+ *  - objects allocator to initialize.
+ *  - cacheLimit bytes of released mappings kept for re-use, zero unmaps them right away.
+ *  - backend WFE_POOL_BACKEND_* options, objects are always mapped.
+ */
+void wfePoolObjectsInit(wfePoolObjects *objects, wfeSize cacheLimit, wfeUint32 backend);
+
+/**
+ * Unmaps every object of the allocator, live and cached.
+ *
+ * Params:
+ *  - objects allocator to finalize.
+ */
+void wfePoolObjectsFinalize(wfePoolObjects *objects);
+
+/**
+ * Requests a large object, re-using a cached mapping of the same size class when possible.
+ *
+ * Note: memory is zero, cached mappings are discarded when released.
+ * Params:
+ *  - objects allocator.
+ *  - size of object.
+ *  - align of object, power of two up to the page size.
+ * Returns:
+ *  - NULL if memory could not be mapped.
+ *  - A pointer aligned to align and at least WFE_POOL_OBJECT_HEADER.
+ */
+wfeData *wfePoolObjectsGet(wfePoolObjects *objects, wfeSize size, wfeSize align);
+
+/**
+ * Checks whether a pointer is a live object of the allocator by walking its live list, large
+ * objects are few. Any pointer can be checked, memory around it is never read.
+ *
+ * Params:
+ *  - objects allocator.
+ *  - ptr returned by any pool function.
+ * Returns:
+ *  - WFE_TRUE if ptr was returned by wfePoolObjectsGet of the same allocator.
+ */
+wfeBool wfePoolObjectsOwns(wfePoolObjects *objects, wfeData *ptr);
+
+/**
+ * Releases a large object, its mapping is cached or unmapped. Mappings of huge pages are
+ * never cached, they can not be emptied below their page size.
+ *
+ * Params:
+ *  - objects allocator.
+ *  - ptr to object, must be owned by the allocator.
+ */
+void wfePoolObjectsFree(wfePoolObjects *objects, wfeData *ptr);
+
+/**
+ * Releases every live object of the allocator.
+ *
+ * Params:
+ *  - objects allocator.
+ */
+void wfePoolObjectsRecycle(wfePoolObjects *objects);
+
+/**
+ * Initializes a store of spare blocks, empty.
+ *
+ * Params:
+ *  - shared store to initialize.
+ */
+void wfePoolSharedInit(wfePoolShared *shared);
+
+/**
+ * Releases every spare block of a store.
+ *
+ * Warning: pools bound to the store, children included, must be finalized before; their
+ * blocks would otherwise go back to a released store. Asserted on debug builds.
+ * Params:
+ *  - shared store to finalize.
+ */
+void wfePoolSharedFinalize(wfePoolShared *shared);
+
+/**
+ * Takes a spare block of the given size from a store.
+ *
+ * Params:
+ *  - shared store.
+ *  - size of block, must be the size of a tier.
+ * Returns:
+ *  - NULL if the store has no block of that size.
+ *  - A block ready to be used, out of any chain.
+ */
+wfePoolBlock *wfePoolSharedTake(wfePoolShared *shared, wfeSize size);
+
+/**
+ * Gives a block to a store, only blocks with the size of a tier are accepted.
+ *
+ * Params:
+ *  - shared store.
+ *  - block to give, out of any chain.
+ * Returns:
+ *  - WFE_TRUE if the store took the block.
+ *  - WFE_FALSE if block size does not match any tier, caller still owns it.
+ */
+wfeBool wfePoolSharedGive(wfePoolShared *shared, wfePoolBlock *block);
+
 /**
  * Initializes a memory pool.
  *
- * Only sets to zero value each tier so they can be marked as uninitialized.
+ * Only sets to zero value each tier so they can be marked as uninitialized and
+ * builds the size class table for the default threshold (0.25).
  *
  * Params:
  *  - pool to initialize.
@@ -186,7 +588,9 @@ wfeError wfePoolInit(wfePool *pool);
  * Releases all resources of a pool.
  *
  * Finalizes all used tiers calling wfePoolTierFinalize for each, which should
- * also release all chunk chains.
+ * also release all chunk chains. Blocks of child pools are given back to the parent
+ * and blocks of pools bound to a store to the store instead, memory handed off to the
+ * pool is released too.
  *
  * Warning: do not write/read on any reference that points to data stored
  * on finalized pool. It is not guaranteed that memory is still available and
@@ -197,13 +601,73 @@ wfeError wfePoolInit(wfePool *pool);
  */
 void wfePoolFinalize(wfePool *pool);
 
+/**
+ * Initializes a memory pool bound to a store of spare blocks, new blocks are taken from the
+ * store before requesting memory and trimmed blocks are given back to it.
+ *
+ * Params:
+ *  - pool to initialize.
+ *  - shared store, must outlive the pool: finalize the pool before the store.
+ * Return:
+ *  - Same as wfePoolInit.
+ */
+wfeError wfePoolInitShared(wfePool *pool, wfePoolShared *shared);
+
+/**
+ * Initializes a child pool that leases unreached blocks of its parent before requesting
+ * memory, and gives every block of its tiers back to the parent on finalize. Creating and
+ * finalizing short-lived pools (per level, per request, per job) is then nearly free.
+ * Backend, threshold and store are inherited from the parent.
+ *
+ * Warning: parent and child must be used by the same thread, parent must outlive child.
+ * Params:
+ *  - child pool to initialize.
+ *  - parent pool to lease blocks from.
+ * Return:
+ *  - Same as wfePoolInit.
+ */
+wfeError wfePoolInitChild(wfePool *child, wfePool *parent);
+
+/**
+ * Hands every allocation of a pool off to another pool, usually owned by another thread,
+ * without copying. Reached blocks of each size tier and large objects are pushed to the
+ * owner with an atomic operation, memory stays valid until the owner recycles or finalizes,
+ * then blocks return to the shared store. The worker goes on with unreached blocks or blocks
+ * of the store.
+ *
+ * Note: only the worker thread may call this function, owner might be in use meanwhile.
+ * The fixed tier is never handed off. Markers of the worker are invalidated.
+ *
+ * Params:
+ *  - worker pool whose allocations are handed off.
+ *  - owner pool that releases them on its next recycle.
+ * Return:
+ *  - WFE_SUCCESS.
+ *  - WFE_POOL_OMEM_BLOCK if a tier could not get a new block, tiers before it were handed off.
+ */
+wfeError wfePoolHandoff(wfePool *worker, wfePool *owner);
+
+/**
+ * Hands a single large object off to another pool, the rest of the worker is kept. The
+ * mapping of the object is sized to its request, so nothing else is pinned on the owner.
+ *
+ * Note: same threading rules as wfePoolHandoff.
+ * Params:
+ *  - worker pool that owns the object.
+ *  - owner pool that releases it on its next recycle.
+ *  - ptr to object.
+ * Returns:
+ *  - WFE_TRUE if ptr was a live large object of the worker and was handed off.
+ *  - WFE_FALSE otherwise (e.g. ptr was served by a size tier), nothing changes.
+ */
+wfeBool wfePoolHandoffObject(wfePool *worker, wfePool *owner, wfeData *ptr);
+
 /**
  * Sets the fixed tier of the pool, redirecting all memory requests to that chain.
  * Useful for objects that have the same size.
  *
- * Note: fixing size does not restrict bigger o smaller size requests, bigger requests will
- * create a custom chunk within the chain and smaller requests will sectionate current chunk.
- * However it is not recommended because many objects might severly fragment the memory blocks.
+ * Note: smaller requests take a whole slot, bigger requests fail with WFE_POOL_SLOT_SIZE
+ * since every block holds a single slot (see wfePoolSlabTier).
  *
  * Params:
  *  - pool to set fixed size.
@@ -216,6 +680,46 @@ void wfePoolFinalize(wfePool *pool);
  */
 wfeError wfePoolFixedTier(wfePool *pool, wfeSize size);
 
+/**
+ * Sets the fixed tier of the pool on slab mode, every block holds count objects and
+ * objects can be released one by one with wfePoolFree, released slots are re-used before
+ * the block chain grows.
+ *
+ * Note: size is rounded up to hold at least a pointer, wfePoolFixedTier is a slab of one
+ * object per block. Requests bigger than size fail with WFE_POOL_SLOT_SIZE.
+ *
+ * Params:
+ *  - pool to set slab tier.
+ *  - size of each object.
+ *  - count of objects per block.
+ * Return:
+ *  - WFE_SUCCESS.
+ *  - All errors from wfePoolFixedTier.
+ */
+wfeError wfePoolSlabTier(wfePool *pool, wfeSize size, wfeSize count);
+
+/**
+ * Releases a single object, only objects of a slab tier and large objects (custom tier) are
+ * actually released, any other memory waits for the next recycle.
+ *
+ * Params:
+ *  - pool owner of object.
+ *  - ptr to object returned by wfePoolGet, NULL is ignored.
+ */
+void wfePoolFree(wfePool *pool, wfeData *ptr);
+
+/**
+ * Reports the occupancy of the slab tier of the pool.
+ *
+ * Params:
+ *  - pool with a slab tier.
+ *  - occupancy (out) report.
+ * Return:
+ *  - WFE_SUCCESS.
+ *  - WFE_POOL_NOT_SLAB if pool does not have a slab tier.
+ */
+wfeError wfePoolSlabOccupancy(wfePool *pool, wfePoolOccupancy *occupancy);
+
 /**
  * Calculates the allocated memory of all pool, including all tiers with all tiers.
  *
@@ -228,11 +732,57 @@ wfeError wfePoolFixedTier(wfePool *pool, wfeSize size);
 wfeSize wfePoolTotalSize(wfePool *pool);
 
 /**
- * Compares size parameter with each internal tier, if it's <threshold> times smaller then request
- * is assigned to that tier, pasively creating and initializing it, if success reference is returned.
+ * Sets the backend of the pool, only tiers created after this call are affected so call it
+ * right after wfePoolInit.
+ *
+ * Note: WFE_POOL_BACKEND_HUGE_PAGES only applies to large and huge tiers. Tiers of an arena
+ * pool hold a single block of WFE_POOL_ARENA_RESERVE bytes, so every object of a tier is
+ * contiguous and wfePoolExtend grows the last one in place, total size reports reserved bytes.
+ * Params:
+ *  - pool to configure.
+ *  - backend WFE_POOL_BACKEND_* and options, WFE_POOL_BACKEND_HEAP by default.
+ */
+void wfePoolSetBackend(wfePool *pool, wfeUint32 backend);
+
+/**
+ * Sets the threshold of the pool and rebuilds its size class table. A request is served by
+ * the first tier that is at least <threshold> times bigger than the request.
+ *
+ * Warning: do not write pool#threshold directly, the lookup table would not notice it.
+ * Params:
+ *  - pool to configure.
+ *  - threshold ratio between request and tier sizes, in range (0, 1].
+ */
+void wfePoolSetThreshold(wfePool *pool, wfeNum threshold);
+
+/**
+ * Sets the bytes of released large objects that the pool keeps mapped for re-use.
+ *
+ * Params:
+ *  - pool to configure.
+ *  - limit bytes, WFE_POOL_OBJECT_CACHE by default.
+ */
+void wfePoolSetObjectCache(wfePool *pool, wfeSize limit);
+
+/**
+ * Sets the retention policy of every tier of the pool, current and future ones.
+ *
+ * Params:
+ *  - pool to configure.
+ *  - trim WFE_POOL_TRIM_* policy, WFE_POOL_TRIM_NONE by default.
+ *  - limit of policy, see wfePoolTierSetTrim.
+ */
+void wfePoolSetTrim(wfePool *pool, wfeUint32 trim, wfeSize limit);
+
+/**
+ * Looks up the tier for the size class of the request, if it's <threshold> times smaller then
+ * request is assigned to that tier, pasively creating and initializing it, if success reference
+ * is returned. The lookup is a table access plus one comparison, it does not depend on the count
+ * of tiers.
  *
  * Note: if pool has a fixed size tier, then all requests are going to be redirected to that tier,
- * no matter the size.
+ * requests bigger than its slot fail with WFE_POOL_SLOT_SIZE. Requests bigger than the huge
+ * tier limit are large objects, each one is mapped on its own and can be released with wfePoolFree.
  *
  * Warning: this methods is silent when failing, a memory failure might be present at any time on
  * this function. Use pool#lastError to get the problem.
@@ -240,7 +790,8 @@ wfeSize wfePoolTotalSize(wfePool *pool);
  * Params:
  *  - pool to take memory of.
  *  - size of required block.
- *  - align of type, use wfeAlignOf to get the aligment.
+ *  - align of type, use wfeAlignOf to get the aligment. Any power of two up to the page size
+ *    is honored by the returned pointer (e.g. 16 for SSE, 64 for cache lines).
  * Returns:
  *  - NULL if could not allocate or initialize tier handler or memory chunk.
  *  - An aligned pointer to usable memory space (read and write, not thread safe).
@@ -248,8 +799,25 @@ wfeSize wfePoolTotalSize(wfePool *pool);
 wfeData *wfePoolGet(wfePool *pool, wfeSize size, wfeSize align);
 
 /**
- * Recycles all tiers of a pool. This operation does not free any memory so developer must call
- * wfePoolFinalize anyways.
+ * Grows the last object served by a tier in place, without copying nor moving it. Useful
+ * to build big contiguous buffers of unknown size, mainly on arena pools.
+ *
+ * Params:
+ *  - pool owner of object.
+ *  - ptr to object, must be the last object served by its tier.
+ *  - size of object, as requested or after previous extensions.
+ *  - extra bytes to append.
+ * Return:
+ *  - WFE_SUCCESS.
+ *  - WFE_POOL_NOT_LAST if ptr is not the last object of any tier.
+ *  - WFE_POOL_OMEM_CHUNK if the block has no room left or pages could not be committed.
+ */
+wfeError wfePoolExtend(wfePool *pool, wfeData *ptr, wfeSize size, wfeSize extra);
+
+/**
+ * Recycles all tiers of a pool. This operation does not free any memory unless a trim policy
+ * was set, so developer must call wfePoolFinalize anyways. Memory handed off to this pool is
+ * released here.
  *
  * Useful (and fast) way to re-use a pool without allocating or freeing memory.
  * Params:
@@ -257,4 +825,99 @@ wfeData *wfePoolGet(wfePool *pool, wfeSize size, wfeSize align);
  */
 void wfePoolRecycle(wfePool *pool);
 
+/**
+ * Captures the current position of every tier, so temporary allocations done after
+ * this call can be released with wfePoolRewind.
+ *
+ * Params:
+ *  - pool to mark.
+ *  - marker (out) position of tiers.
+ */
+void wfePoolMark(wfePool *pool, wfePoolMarker *marker);
+
+/**
+ * Releases every allocation done after the marker was taken, in O(tiers). Blocks reached
+ * after the mark stay on the chains to be re-used.
+ *
+ * Warning: markers must be rewound in reverse order (as a stack) and a recycle invalidates
+ * all of them. Slots of a slab tier released after the mark are dropped until next recycle,
+ * the free list of the mark is kept unless the scope took slots from it.
+ * Params:
+ *  - pool to rewind.
+ *  - marker taken by wfePoolMark on the same pool.
+ */
+void wfePoolRewind(wfePool *pool, const wfePoolMarker *marker);
+
+/**
+ * Writes every object of a pool (used bytes of each block and large objects) into an image
+ * file, so a later launch can load the same state without running the loaders again.
+ *
+ * Pointers stored on pool memory are not known by the pool, the address of each one must
+ * be given as a slot. They are written as relocations and fixed up on load. Objects keep
+ * their alignment up to the page size.
+ *
+ * Params:
+ *  - pool to write.
+ *  - path of image file, overwritten.
+ *  - key identifying the sources of the state (e.g. a hash of config files and version),
+ *    images with another key are stale.
+ *  - root object handed back by wfePoolImageLoad, might be NULL.
+ *  - slots addresses of pointers stored on pool memory, each one NULL or pointing to pool memory.
+ *  - count of slots.
+ * Return:
+ *  - WFE_SUCCESS.
+ *  - WFE_POOL_IMAGE_OUTSIDE if root, a slot or the pointer of a slot is not on pool memory.
+ *  - WFE_POOL_IMAGE_WRITE if file could not be written.
+ *  - WFE_POOL_OMEM_CHUNK if image could not be built on memory.
+ */
+wfeError wfePoolImageWrite(wfePool *pool, const wfeChar *path, wfeUint64 key, wfeData *root, wfeAny *slots, wfeSize count);
+
+/**
+ * Maps an image written by wfePoolImageWrite and fixes its pointers up. The image belongs
+ * to the pool from now on and is released on wfePoolFinalize, recycles do not touch it.
+ *
+ * Only the header and relocation table are validated, so pages that are never touched are
+ * never read. Compile with WFE_POOL_IMAGE_VERIFY (on for debug builds) to hash the whole
+ * content as well, at the cost of reading every page on load.
+ *
+ * Params:
+ *  - pool that owns the image.
+ *  - path of image file.
+ *  - key of current sources, must match the one given on write.
+ *  - root (out) root object of the image.
+ * Return:
+ *  - WFE_SUCCESS.
+ *  - WFE_POOL_IMAGE_STALE if image is missing, truncated, corrupt (hash mismatch of relocation
+ *    table, or of content with WFE_POOL_IMAGE_VERIFY) or was written for another key, caller
+ *    should fall back to its loaders.
+ *  - WFE_POOL_OMEM_BLOCK if image handler could not be allocated.
+ */
+wfeError wfePoolImageLoad(wfePool *pool, const wfeChar *path, wfeUint64 key, wfeData **root);
+
+/**
+ * Takes a snapshot of the counters of a pool: requests and bytes per tier, internal waste
+ * (alignment and slot rounding), exhausted block tails, peak usage, chain lengths, recycles
+ * and a histogram of request size classes.
+ *
+ * Params:
+ *  - pool to inspect.
+ *  - report (out) snapshot of counters.
+ * Return:
+ *  - WFE_SUCCESS.
+ *  - WFE_POOL_STATS_DISABLED if runtime was compiled without WFE_POOL_STATS.
+ */
+wfeError wfePoolStats(wfePool *pool, wfePoolReport *report);
+
+/**
+ * Writes the counters of a pool as a JSON object, with totals at top level and an object
+ * per tier under "tiers".
+ *
+ * Params:
+ *  - pool to inspect.
+ *  - out stream to write.
+ * Return:
+ *  - Same as wfePoolStats.
+ */
+wfeError wfePoolStatsDump(wfePool *pool, FILE *out);
+
 #endif
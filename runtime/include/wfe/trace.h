@@ -0,0 +1,76 @@
+#ifndef WFE_TRACE_H
+#define WFE_TRACE_H
+#include <wfe/types.h>
+
+#define WFE_TRACE_WRITE_ERROR WFE_MAKE_FILE_ERROR(90) // Trace could not be written
+#define WFE_TRACE_RUNNING WFE_MAKE_API_ERROR(91)      // Tracing was started already
+
+#define WFE_TRACE_DEFAULT_EVENTS 16384 // Events kept per thread by default
+#define WFE_TRACE_ASSET_SIZE 64        // Bytes of asset name kept per event, longer names are cut
+
+// Cache result of a span, see wfeTraceEnd.
+#define WFE_TRACE_CACHE_NONE 0
+#define WFE_TRACE_CACHE_HIT 1
+#define WFE_TRACE_CACHE_MISS 2
+
+/**
+ * Completed span, timestamps are nanoseconds from start of tracing.
+ */
+typedef struct wfeTraceEvent {
+    const wfeChar *span; // Static name of span (e.g. "open", "read", "decode")
+    wfeUint64 start;
+    wfeUint64 duration;
+    wfeSize bytes;       // Bytes read or decoded, zero if none
+    wfeUint32 cache;     // WFE_TRACE_CACHE_*
+    wfeChar asset[WFE_TRACE_ASSET_SIZE]; // Name with extension, empty if unknown
+} wfeTraceEvent;
+
+/**
+ * Starts tracing asset loads. Every thread that records a span gets its own ring of events,
+ * so recording takes no lock; once a ring is full its oldest events are overwritten. While
+ * tracing is stopped spans cost a single relaxed load.
+ *
+ * Params:
+ *  - events kept per thread, WFE_TRACE_DEFAULT_EVENTS is a good start.
+ * Return:
+ *  - WFE_SUCCESS.
+ *  - WFE_TRACE_RUNNING if tracing was started already.
+ */
+wfeError wfeTraceStart(wfeSize events);
+
+/**
+ * Stops tracing and writes every kept event in Chrome trace event format, to be opened with
+ * chrome://tracing or Perfetto. Rings are released.
+ *
+ * Warning: call once loads are finished, threads recording meanwhile might lose their events.
+ * Params:
+ *  - path of JSON file to write, NULL to drop events.
+ * Return:
+ *  - WFE_SUCCESS, also if tracing was not running.
+ *  - WFE_TRACE_WRITE_ERROR if file could not be written.
+ */
+wfeError wfeTraceStop(const wfeChar *path);
+
+/**
+ * Opens a span.
+ *
+ * Returns:
+ *  - Start of span to give to wfeTraceEnd, zero while tracing is stopped.
+ */
+wfeUint64 wfeTraceBegin(void);
+
+/**
+ * Closes a span opened with wfeTraceBegin and records it on the ring of current thread.
+ * Does nothing if start is zero.
+ *
+ * Params:
+ *  - start returned by wfeTraceBegin.
+ *  - span static name of span.
+ *  - name of asset, NULL if unknown.
+ *  - ext of asset, appended to name.
+ *  - bytes read or decoded.
+ *  - cache WFE_TRACE_CACHE_* result of span.
+ */
+void wfeTraceEnd(wfeUint64 start, const wfeChar *span, const wfeChar *name, const wfeChar *ext, wfeSize bytes, wfeUint32 cache);
+
+#endif /* WFE_TRACE_H */
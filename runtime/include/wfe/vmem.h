@@ -0,0 +1,113 @@
+#ifndef WFE_VMEM_H
+#define WFE_VMEM_H
+#include <wfe/types.h>
+
+#define WFE_VMEM_HUGE_PAGES ((wfeUint32) 0x1) // Back mapping with huge pages when possible
+
+#define WFE_VMEM_NORMAL ((wfeUint32) 0)     // No access pattern expected
+#define WFE_VMEM_SEQUENTIAL ((wfeUint32) 1) // Range is read once from start to end, read ahead aggressively
+#define WFE_VMEM_WILL_NEED ((wfeUint32) 2)  // Range is read soon, start reading it now
+#define WFE_VMEM_RANDOM ((wfeUint32) 3)     // Range is read in no order, do not read ahead
+
+/**
+ * Returns the size of a memory page of the system.
+ *
+ * Returns:
+ *  - Page size on bytes.
+ */
+wfeSize wfeVmemPageSize(void);
+
+/**
+ * Maps a range of virtual memory for read and write.
+ *
+ * Pages are not backed until first touched and read as zero, so mapping big ranges
+ * does not stall. When WFE_VMEM_HUGE_PAGES is given it tries explicit huge pages first
+ * and then falls back to transparent huge pages.
+ *
+ * Params:
+ *  - size of range, rounded up to page size.
+ *  - flags WFE_VMEM_* options.
+ * Returns:
+ *  - Start of range.
+ *  - NULL if no address space is available.
+ */
+wfeData *wfeVmemMap(wfeSize size, wfeUint32 flags);
+
+/**
+ * Reserves a range of address space without backing it, pages can not be touched until
+ * they are committed with wfeVmemCommit. Release it with wfeVmemUnmap.
+ *
+ * Params:
+ *  - size of range, rounded up to page size.
+ * Returns:
+ *  - Start of range.
+ *  - NULL if no address space is available.
+ */
+wfeData *wfeVmemReserve(wfeSize size);
+
+/**
+ * Commits pages of a reserved range for read and write, they read as zero. Every page
+ * touched by the range is committed.
+ *
+ * Params:
+ *  - ptr start of range, within a reserved range.
+ *  - size of range.
+ * Returns:
+ *  - WFE_TRUE if pages are ready to be used.
+ *  - WFE_FALSE if the system could not commit them.
+ */
+wfeBool wfeVmemCommit(wfeData *ptr, wfeSize size);
+
+/**
+ * Unmaps a range mapped with wfeVmemMap or reserved with wfeVmemReserve.
+ *
+ * Params:
+ *  - ptr start of range.
+ *  - size used to map the range.
+ */
+void wfeVmemUnmap(wfeData *ptr, wfeSize size);
+
+/**
+ * Maps a whole file for read and write, writes are private to the process (copy on write)
+ * and never reach the file. Pages are read from the file once touched.
+ *
+ * Params:
+ *  - path of file.
+ *  - size (out) bytes of file.
+ * Returns:
+ *  - Start of mapping.
+ *  - NULL if file could not be opened, is empty or could not be mapped.
+ */
+wfeData *wfeVmemMapFile(const wfeChar *path, wfeSize *size);
+
+/**
+ * Unmaps a file mapped with wfeVmemMapFile.
+ *
+ * Params:
+ *  - ptr start of mapping.
+ *  - size of file.
+ */
+void wfeVmemUnmapFile(wfeData *ptr, wfeSize size);
+
+/**
+ * Hints the system about how a mapped range is going to be accessed. Hints are advisory,
+ * they are ignored where the system has no equivalent.
+ *
+ * Params:
+ *  - ptr start of range, usually a mapping from wfeVmemMapFile.
+ *  - size of range.
+ *  - advice one of WFE_VMEM_NORMAL, WFE_VMEM_SEQUENTIAL, WFE_VMEM_WILL_NEED or WFE_VMEM_RANDOM.
+ */
+void wfeVmemAdvise(wfeData *ptr, wfeSize size, wfeUint32 advice);
+
+/**
+ * Gives back the physical pages of a range to the system while keeping the range mapped,
+ * next touch reads zeros. Only whole pages within the range are discarded.
+ *
+ * Params:
+ *  - ptr start of range.
+ *  - size of range.
+ */
+void wfeVmemDiscard(wfeData *ptr, wfeSize size);
+
+#endif /* WFE_VMEM_H */
@@ -0,0 +1,87 @@
+#ifndef WFE_WATCH_H
+#define WFE_WATCH_H
+#include <wfe/types.h>
+#include <wfe/cache.h>
+#include <threads.h>
+
+#define WFE_WATCH_UNSUPPORTED WFE_MAKE_API_ERROR(71)  // System has no file change notifications
+#define WFE_WATCH_ACCESS_ERROR WFE_MAKE_FILE_ERROR(72) // Root or one of its folders could not be watched
+#define WFE_WATCH_THREAD_ERROR WFE_MAKE_FAILURE(73)    // Watcher thread or its lock could not be created
+
+#define WFE_WATCH_SETTLE_MS 50 // Quiet time that closes a burst of changes
+
+/**
+ * File that changed and its new content, read by the watcher thread.
+ */
+typedef struct wfeWatchChange {
+    struct wfeWatchChange *next;
+    wfeChar *key;  // Path relative to root, same as cache keys
+    wfeData *data; // Content allocated with malloc, NULL if file could not be read
+    wfeSize size;
+} wfeWatchChange;
+
+/**
+ * Folder under watch.
+ */
+typedef struct wfeWatchFolder {
+    int wd;        // Watch descriptor
+    wfeChar *path; // Path relative to root, empty for root
+} wfeWatchFolder;
+
+/**
+ * Hot reload of cached assets. A thread waits for files under a root folder (and its
+ * subfolders) to be written, collects changes until no new one arrives for
+ * WFE_WATCH_SETTLE_MS, then reads every changed file at once. wfeWatchPump swaps the new
+ * content into the entries of a cache, so it happens on the game thread between frames and
+ * entries (handles) stay valid. Files that are not cached are dropped.
+ *
+ * Only available on Linux (inotify), init reports WFE_WATCH_UNSUPPORTED elsewhere.
+ * Warning: watch must not move after wfeWatchInit. Pump and finalize from the cache thread.
+ */
+typedef struct wfeWatch {
+    wfeCache *cache;
+    wfeChar *root;
+    wfeWatchFolder *folders;
+    wfeSize folderCount, folderCapacity;
+    wfeWatchChange *ready; // Changes read and waiting for pump, guarded by lock
+    int notify;            // inotify descriptor
+    int stop[2];           // Pipe that wakes the thread to stop
+    thrd_t thread;
+    mtx_t lock;
+} wfeWatch;
+
+/**
+ * Starts watching a root folder for changes of cached assets.
+ *
+ * Params:
+ *  - watch to initialize.
+ *  - cache whose entries are replaced.
+ *  - root folder, NULL for the search path (see wfeAssetSetSearchPath).
+ * Return:
+ *  - WFE_SUCCESS.
+ *  - WFE_WATCH_UNSUPPORTED if system has no file change notifications.
+ *  - WFE_WATCH_ACCESS_ERROR if root could not be watched.
+ *  - WFE_WATCH_THREAD_ERROR if watcher could not be started.
+ */
+wfeError wfeWatchInit(wfeWatch *watch, wfeCache *cache, const wfeChar *root);
+
+/**
+ * Stops the watcher thread and drops changes not pumped yet.
+ *
+ * Params:
+ *  - watch to finalize.
+ */
+void wfeWatchFinalize(wfeWatch *watch);
+
+/**
+ * Swaps content of changed files into the cache, call once per frame before using entries.
+ * Holders of replaced entries see a new version (see wfeCacheEntry#version).
+ *
+ * Params:
+ *  - watch to pump.
+ * Returns:
+ *  - Count of replaced entries.
+ */
+wfeSize wfeWatchPump(wfeWatch *watch);
+
+#endif /* WFE_WATCH_H */
@@ -27,7 +27,7 @@ project "wferuntime-test"
 
     includedirs {"include", "../vendor", "../vendor/msgpack-c/include"}
     files {"tests/main.c", "tests/**.h"}
-    links {"wferuntime", "glfw", "msgpack"}
+    links {"wferuntime", "glfw", "msgpack", "zlib"}
 
     postbuildcommands {
         "./bin/%{cfg.buildcfg}/Tests/wferuntime-test"
@@ -35,6 +35,7 @@ project "wferuntime-test"
 
     filter "platforms:Linux"
         defines {"WFE_USE_STDDEF", "WFE_USE_STDINT"}
+        links {"pthread"}
         removefiles {"src/game_glfm.c"}
 
     filter "platforms:Windows"
@@ -43,3 +44,24 @@ project "wferuntime-test"
 
     filter {}
 
+
+project "wferuntime-bench"
+    dependson {"wferuntime"}
+
+    kind "ConsoleApp"
+    language "C"
+    cdialect "C11"
+    targetdir "bin/%{cfg.buildcfg}/Bench"
+
+    includedirs {"include", "../vendor", "../vendor/msgpack-c/include"}
+    files {"bench/main.c", "bench/**.h"}
+    links {"wferuntime", "glfw", "msgpack", "zlib"}
+
+    filter "platforms:Linux"
+        defines {"WFE_USE_STDDEF", "WFE_USE_STDINT"}
+        links {"pthread"}
+
+    filter "platforms:Windows"
+        defines {"WFE_USE_MSVSCDEF"}
+
+    filter {}
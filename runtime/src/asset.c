@@ -2,16 +2,24 @@
 #include <wfe/types.h>
 #include <wfe/desc.h>
 #include <wfe/pool.h>
+#include <wfe/vmem.h>
+#include <wfe/trace.h>
 #include <string.h>
 #include <stdio.h>
 
 static wfeChar *wfeSearchPath;
 wfeChar *makePath(const wfeChar *name, const wfeChar *ext, wfePool *pool);
+wfeError wfeAssetResolve(const wfeChar *name, const wfeChar *ext, wfePool *pool, const wfeChar **path);
+wfeError wfeAssetPackLoad(const wfeChar *name, const wfeChar *ext, wfePool *pool, const wfeData **data, wfeSize *size);
 
 void wfeAssetSetSearchPath(wfeChar *searchPath) {
     wfeSearchPath = searchPath;
 }
 
+const wfeChar *wfeAssetGetSearchPath(void) {
+    return wfeSearchPath;
+}
+
 wfeError wfeAssetLoadRaw(name, ext, pool, data, size)
     const wfeChar *name;
     const wfeChar *ext;
@@ -19,7 +27,6 @@ wfeError wfeAssetLoadRaw(name, ext, pool, data, size)
     const wfeData **data;
     wfeSize *size;
 {
-    assert(wfeSearchPath != NULL /* Should initialize */);
     assert(name != NULL /* name should exists */);
     assert(ext != NULL /* ext should exists */);
     assert(pool != NULL /* memory should reference something */);
@@ -29,12 +36,30 @@ wfeError wfeAssetLoadRaw(name, ext, pool, data, size)
     *size = 0L;
     *data = NULL;
     wfeChar *fdata = NULL;
-    wfeChar *fpath = makePath(name, ext, pool);
-    if (fpath == NULL) {
-        return pool->lastError;
+
+    // Packs take a lookup and a single read, no path nor open.
+    wfeUint64 trace = wfeTraceBegin();
+    wfeError code = wfeAssetPackLoad(name, ext, pool, data, size);
+    if (!WFE_SHOULD_CONTINUE(code)) {
+        wfeTraceEnd(trace, "pack", name, ext, *size, WFE_TRACE_CACHE_NONE);
+        return code;
+    }
+
+    // Path is only needed to open the file, release it before reading data.
+    wfePoolMarker marker;
+    wfePoolMark(pool, &marker);
+    trace = wfeTraceBegin();
+    const wfeChar *fpath = NULL;
+    code = wfeAssetResolve(name, ext, pool, &fpath);
+    if (WFE_HAVE_FAILED(code)) {
+        wfePoolRewind(pool, &marker);
+        wfeTraceEnd(trace, "open", name, ext, 0L, WFE_TRACE_CACHE_NONE);
+        return code;
     }
 
     FILE *file = fopen(fpath, "r");
+    wfePoolRewind(pool, &marker);
+    wfeTraceEnd(trace, "open", name, ext, 0L, WFE_TRACE_CACHE_NONE);
     if (file == NULL) {
         return WFE_ASSET_FILE_ACCESS_ERROR;
     }
@@ -49,7 +74,9 @@ wfeError wfeAssetLoadRaw(name, ext, pool, data, size)
         return pool->lastError;
     }
 
+    trace = wfeTraceBegin();
     wfeSize rcount = fread(fdata, 1, fsize, file);
+    wfeTraceEnd(trace, "read", name, ext, rcount, WFE_TRACE_CACHE_NONE);
     if (rcount != fsize) {
         fclose(file);
         return WFE_DID_NOT_READ_ALL_FILE;
@@ -61,6 +88,47 @@ wfeError wfeAssetLoadRaw(name, ext, pool, data, size)
     return WFE_SUCCESS;
 }
 
+wfeError wfeAssetMapRaw(const wfeChar *name, const wfeChar *ext, wfePool *pool, wfeUint32 advice, wfeAssetMapping *mapping) {
+    assert(name != NULL /* name should exists */);
+    assert(ext != NULL /* ext should exists */);
+    assert(pool != NULL /* memory should reference something */);
+    assert(mapping != NULL /* Should reference something */);
+
+    mapping->data = NULL;
+    mapping->size = 0L;
+
+    wfePoolMarker marker;
+    wfePoolMark(pool, &marker);
+    const wfeChar *fpath = NULL;
+    wfeError code = wfeAssetResolve(name, ext, pool, &fpath);
+    if (WFE_HAVE_FAILED(code)) {
+        wfePoolRewind(pool, &marker);
+        return code;
+    }
+
+    wfeSize fsize = 0L;
+    wfeData *fdata = wfeVmemMapFile(fpath, &fsize);
+    wfePoolRewind(pool, &marker);
+    if (fdata == NULL) {
+        return WFE_ASSET_FILE_ACCESS_ERROR;
+    }
+
+    wfeVmemAdvise(fdata, fsize, advice);
+    mapping->data = fdata;
+    mapping->size = fsize;
+    return WFE_SUCCESS;
+}
+
+void wfeAssetUnmapRaw(wfeAssetMapping *mapping) {
+    assert(mapping != NULL /* Should reference something */);
+
+    if (mapping->data != NULL) {
+        wfeVmemUnmapFile((wfeData *) mapping->data, mapping->size);
+        mapping->data = NULL;
+        mapping->size = 0L;
+    }
+}
+
 wfeError wfeAssetLoadDesc(const wfeChar *name, wfePool *pool, wfeDesc *desc) {
     wfeError code = WFE_SUCCESS;
     const wfeData *data = NULL;
@@ -74,11 +142,12 @@ wfeError wfeAssetLoadDesc(const wfeChar *name, wfePool *pool, wfeDesc *desc) {
         return code;
     }
 
-    code = wfeDescDecodeBuffer(desc, data, size);
+    code = wfeDescDecodeBufferPool(desc, pool, data, size);
     return code;
 }
 
 wfeChar *makePath(const wfeChar *name, const wfeChar *ext, wfePool *pool) {
+    assert(wfeSearchPath != NULL /* Should initialize, only packs and search roots go without */);
     wfeSize splen = strlen(wfeSearchPath);
     wfeSize nalen = strlen(name);
     wfeSize exlen = strlen(ext);
@@ -88,6 +157,8 @@ wfeChar *makePath(const wfeChar *name, const wfeChar *ext, wfePool *pool) {
         return NULL;
     }
 
+    // Pool memory is only zero the first time it's used.
+    fpath[0] = '\0';
     strcat(fpath, wfeSearchPath);
     if ( (nalen > 0 ? name[nalen] : 0) != WFE_FILE_SEPARATOR && (splen > 0 ? wfeSearchPath[splen-1] : 0) != WFE_FILE_SEPARATOR) {
         strcat(fpath, WFE_FILE_SEPARATOR_STR);
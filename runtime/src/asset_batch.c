@@ -0,0 +1,609 @@
+// io_uring and pread are not part of strict C11.
+#define _DEFAULT_SOURCE
+#include <wfe/asset.h>
+#include <wfe/types.h>
+#include <wfe/pool.h>
+#include <wfe/trace.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <stdatomic.h>
+#include <linux/io_uring.h>
+#include <linux/stat.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(__NR_io_uring_register)
+#define WFE_ASSET_URING
+#endif
+#endif
+#endif
+
+#define WFE_ASSET_RING_ENTRIES 256
+#define WFE_ASSET_RING_WINDOW (WFE_ASSET_RING_ENTRIES / 2) // Items per round, open and statx take two entries each
+#define WFE_ASSET_RING_READ ((wfeSize) 1 << 30)            // Biggest single read, entry lengths are 32 bits
+#define WFE_ASSET_RING_PROBE_OPS 64                        // Opcodes asked to the kernel, covers every one used
+
+// Operations encoded on low bits of user data, item index on the rest.
+#define WFE_ASSET_OP_OPEN 0
+#define WFE_ASSET_OP_STAT 1
+#define WFE_ASSET_OP_READ 2
+#define WFE_ASSET_OP_CLOSE 3
+
+wfeError wfeAssetResolve(const wfeChar *name, const wfeChar *ext, wfePool *pool, const wfeChar **path);
+wfeError wfeAssetPackLoad(const wfeChar *name, const wfeChar *ext, wfePool *pool, const wfeData **data, wfeSize *size);
+
+/**
+ * Sets the result of a failed item.
+ *
+ * Params:
+ *  - item that failed.
+ *  - status of failure.
+ */
+static void wfeAssetBatchFail(wfeAssetBatchItem *item, wfeError status) {
+    item->data = NULL;
+    item->size = 0L;
+    item->status = status;
+}
+
+#ifdef HAVE_UNISTD_H
+/**
+ * Loads items one by one with plain syscalls, used where io_uring is not available.
+ *
+ * Params:
+ *  - items to load.
+ *  - count of items.
+ *  - pool to place data and temporary paths.
+ * Returns:
+ *  - WFE_SUCCESS or pool error that stopped the batch.
+ */
+static wfeError wfeAssetBatchPread(wfeAssetBatchItem *items, wfeSize count, wfePool *pool) {
+    wfePoolMarker marker;
+    struct stat info;
+    const wfeChar *fpath;
+    wfeError status;
+    wfeData *fdata;
+    wfeSize i, done;
+    ssize_t rcount;
+    int fd;
+
+    for (i = 0; i < count; i++) {
+        if (items[i].status != WFE_CONTINUE)
+            continue;
+
+        wfePoolMark(pool, &marker);
+        status = wfeAssetResolve(items[i].name, items[i].ext, pool, &fpath);
+        if (status == WFE_ASSET_FILE_ACCESS_ERROR) {
+            wfePoolRewind(pool, &marker);
+            wfeAssetBatchFail(&items[i], status);
+            continue;
+        }
+
+        if (WFE_HAVE_FAILED(status))
+            return status;
+
+        fd = open(fpath, O_RDONLY);
+        wfePoolRewind(pool, &marker);
+        if (fd < 0 || fstat(fd, &info) != 0) {
+            wfeAssetBatchFail(&items[i], WFE_ASSET_FILE_ACCESS_ERROR);
+            if (fd >= 0)
+                close(fd);
+
+            continue;
+        }
+
+        fdata = wfePoolGet(pool, info.st_size > 0 ? (wfeSize) info.st_size : 1, wfeAlignOf(char));
+        if (fdata == NULL) {
+            close(fd);
+            return pool->lastError;
+        }
+
+        for (done = 0; done < (wfeSize) info.st_size; done += (wfeSize) rcount) {
+            rcount = pread(fd, fdata + done, (wfeSize) info.st_size - done, (off_t) done);
+            if (rcount <= 0)
+                break;
+        }
+
+        close(fd);
+        items[i].data = fdata;
+        items[i].size = done;
+        items[i].status = done == (wfeSize) info.st_size ? WFE_SUCCESS : WFE_DID_NOT_READ_ALL_FILE;
+    }
+
+    return WFE_SUCCESS;
+}
+#endif
+
+#ifdef WFE_ASSET_URING
+/**
+ * Submission and completion rings shared with the kernel.
+ */
+typedef struct wfeAssetRing {
+    int fd;
+    _Atomic wfeUint32 *sqHead;
+    _Atomic wfeUint32 *sqTail;
+    wfeUint32 *sqMask;
+    wfeUint32 *sqArray;
+    _Atomic wfeUint32 *cqHead;
+    _Atomic wfeUint32 *cqTail;
+    wfeUint32 *cqMask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    wfeData *sqMap;
+    wfeData *cqMap;
+    wfeSize sqSize;
+    wfeSize cqSize;
+    wfeSize sqesSize;
+    wfeUint32 queued; // Entries filled and not submitted yet
+} wfeAssetRing;
+
+/**
+ * Checks that the kernel supports every operation used by batches. Kernels before 5.6 set
+ * rings up fine but fail each open, statx or read entry with -EINVAL.
+ *
+ * Params:
+ *  - fd of ring.
+ * Returns:
+ *  - WFE_TRUE if every operation is supported.
+ */
+static wfeBool wfeAssetRingProbe(int fd) {
+    static const wfeUint8 needed[] = {IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_READ_FIXED, IORING_OP_CLOSE};
+    union {
+        struct io_uring_probe probe;
+        wfeData bytes[sizeof(struct io_uring_probe) + WFE_ASSET_RING_PROBE_OPS * sizeof(struct io_uring_probe_op)];
+    } probe;
+    wfeSize i;
+
+    // Kernel refuses probes that are not zeroed, and probes themselves are 5.6 onwards.
+    memset(&probe, 0, sizeof(probe));
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, &probe, WFE_ASSET_RING_PROBE_OPS) < 0)
+        return WFE_FALSE;
+
+    for (i = 0; i < sizeof(needed); i++) {
+        if (needed[i] >= probe.probe.ops_len || (probe.probe.ops[needed[i]].flags & IO_URING_OP_SUPPORTED) == 0)
+            return WFE_FALSE;
+    }
+
+    return WFE_TRUE;
+}
+
+/**
+ * Sets a ring up with raw syscalls, no library is needed.
+ *
+ * Params:
+ *  - ring to initialize.
+ * Returns:
+ *  - WFE_TRUE if ring is ready.
+ *  - WFE_FALSE if kernel does not support io_uring, the operations used or it is not allowed.
+ */
+static wfeBool wfeAssetRingInit(wfeAssetRing *ring) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    memset(ring, 0, sizeof(wfeAssetRing));
+
+    ring->fd = (int) syscall(__NR_io_uring_setup, WFE_ASSET_RING_ENTRIES, &params);
+    if (ring->fd < 0)
+        return WFE_FALSE;
+
+    if (!wfeAssetRingProbe(ring->fd))
+        goto failed_sq;
+
+    ring->sqSize = params.sq_off.array + params.sq_entries * sizeof(wfeUint32);
+    ring->cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+        ring->sqSize = ring->cqSize > ring->sqSize ? ring->cqSize : ring->sqSize;
+        ring->cqSize = ring->sqSize;
+    }
+
+    ring->sqMap = mmap(NULL, ring->sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sqMap == MAP_FAILED)
+        goto failed_sq;
+
+    ring->cqMap = ring->sqMap;
+    if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0) {
+        ring->cqMap = mmap(NULL, ring->cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cqMap == MAP_FAILED)
+            goto failed_cq;
+    }
+
+    ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+        goto failed_sqes;
+
+    ring->sqHead = (_Atomic wfeUint32 *) (ring->sqMap + params.sq_off.head);
+    ring->sqTail = (_Atomic wfeUint32 *) (ring->sqMap + params.sq_off.tail);
+    ring->sqMask = (wfeUint32 *) (ring->sqMap + params.sq_off.ring_mask);
+    ring->sqArray = (wfeUint32 *) (ring->sqMap + params.sq_off.array);
+    ring->cqHead = (_Atomic wfeUint32 *) (ring->cqMap + params.cq_off.head);
+    ring->cqTail = (_Atomic wfeUint32 *) (ring->cqMap + params.cq_off.tail);
+    ring->cqMask = (wfeUint32 *) (ring->cqMap + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (ring->cqMap + params.cq_off.cqes);
+    return WFE_TRUE;
+
+failed_sqes:
+    if (ring->cqMap != ring->sqMap)
+        munmap(ring->cqMap, ring->cqSize);
+failed_cq:
+    munmap(ring->sqMap, ring->sqSize);
+failed_sq:
+    close(ring->fd);
+    return WFE_FALSE;
+}
+
+/**
+ * Releases a ring.
+ *
+ * Params:
+ *  - ring to finalize.
+ */
+static void wfeAssetRingFinalize(wfeAssetRing *ring) {
+    munmap(ring->sqes, ring->sqesSize);
+    if (ring->cqMap != ring->sqMap)
+        munmap(ring->cqMap, ring->cqSize);
+
+    munmap(ring->sqMap, ring->sqSize);
+    close(ring->fd);
+}
+
+/**
+ * Takes the next submission entry, cleared. Callers never queue more than the ring holds.
+ *
+ * Params:
+ *  - ring to queue on.
+ *  - op WFE_ASSET_OP_* of entry.
+ *  - index of item.
+ * Returns:
+ *  - Entry to fill.
+ */
+static struct io_uring_sqe *wfeAssetRingPush(wfeAssetRing *ring, wfeUint32 op, wfeSize index) {
+    wfeUint32 tail = atomic_load_explicit(ring->sqTail, memory_order_relaxed) + ring->queued;
+    struct io_uring_sqe *sqe = &ring->sqes[tail & *ring->sqMask];
+    assert(ring->queued < WFE_ASSET_RING_ENTRIES /* ring should have room */);
+
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->user_data = ((wfeUint64) index << 2) | op;
+    ring->sqArray[tail & *ring->sqMask] = tail & *ring->sqMask;
+    ring->queued++;
+    return sqe;
+}
+
+/**
+ * Submits queued entries and waits for all of them, calling a handler per completion.
+ *
+ * Params:
+ *  - ring to run.
+ *  - items of batch.
+ *  - handle called for each completion with its item, op and result.
+ *  - userdata passed to handle.
+ * Returns:
+ *  - WFE_TRUE when every entry completed.
+ *  - WFE_FALSE if the kernel refused the submission.
+ */
+static wfeBool wfeAssetRingRun(wfeAssetRing *ring, wfeAssetBatchItem *items,
+                               void (*handle)(wfeAssetBatchItem *, wfeUint32, wfeInt32, wfeAny), wfeAny userdata) {
+    wfeUint32 head, tail, pending = ring->queued, submit = ring->queued;
+    struct io_uring_cqe *cqe;
+    long ret;
+
+    atomic_store_explicit(ring->sqTail, atomic_load_explicit(ring->sqTail, memory_order_relaxed) + submit, memory_order_release);
+    ring->queued = 0;
+    while (pending > 0) {
+        ret = syscall(__NR_io_uring_enter, ring->fd, submit, pending, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret < 0)
+            return WFE_FALSE;
+
+        submit -= (wfeUint32) ret < submit ? (wfeUint32) ret : submit;
+        head = atomic_load_explicit(ring->cqHead, memory_order_relaxed);
+        tail = atomic_load_explicit(ring->cqTail, memory_order_acquire);
+        for (; head != tail; head++) {
+            cqe = &ring->cqes[head & *ring->cqMask];
+            handle(&items[cqe->user_data >> 2], (wfeUint32) (cqe->user_data & 3), cqe->res, userdata);
+            pending--;
+        }
+
+        atomic_store_explicit(ring->cqHead, head, memory_order_release);
+    }
+
+    return WFE_TRUE;
+}
+
+/**
+ * State of a window of items while it goes through the ring.
+ */
+typedef struct wfeAssetWindow {
+    wfeInt32 fds[WFE_ASSET_RING_WINDOW];
+    struct statx stats[WFE_ASSET_RING_WINDOW];
+    wfeSize done[WFE_ASSET_RING_WINDOW]; // Bytes read of each item
+    wfeBool unsupported[WFE_ASSET_RING_WINDOW]; // Item got an operation the kernel does not know
+    wfeAssetBatchItem *first; // First item of window
+} wfeAssetWindow;
+
+/**
+ * Closes every file still open on a window, used when the ring stops before closing them.
+ *
+ * Params:
+ *  - window of items.
+ *  - count of items on window.
+ */
+static void wfeAssetWindowClose(wfeAssetWindow *window, wfeSize count) {
+    wfeSize i;
+    for (i = 0; i < count; i++) {
+        if (window->fds[i] >= 0)
+            close(window->fds[i]);
+
+        window->fds[i] = -1;
+    }
+}
+
+// Stores results of ring operations on items.
+static void wfeAssetWindowHandle(wfeAssetBatchItem *item, wfeUint32 op, wfeInt32 res, wfeAny userdata) {
+    wfeAssetWindow *window = (wfeAssetWindow *) userdata;
+    wfeSize index = item - window->first;
+
+    // Operation refused by the kernel, item is left for another backend.
+    if ((res == -EINVAL || res == -EOPNOTSUPP) && op != WFE_ASSET_OP_CLOSE) {
+        window->unsupported[index] = WFE_TRUE;
+        return;
+    }
+
+    switch (op) {
+    case WFE_ASSET_OP_OPEN:
+        window->fds[index] = res;
+        if (res < 0)
+            wfeAssetBatchFail(item, WFE_ASSET_FILE_ACCESS_ERROR);
+        break;
+    case WFE_ASSET_OP_STAT:
+        if (res < 0)
+            wfeAssetBatchFail(item, WFE_ASSET_FILE_ACCESS_ERROR);
+        break;
+    case WFE_ASSET_OP_READ:
+        // Short reads are queued again for the rest, nothing read means file shrank.
+        if (res <= 0)
+            wfeAssetBatchFail(item, WFE_DID_NOT_READ_ALL_FILE);
+        else
+            window->done[index] += (wfeSize) res;
+        break;
+    case WFE_ASSET_OP_CLOSE:
+        window->fds[index] = -1;
+        break;
+    }
+}
+
+/**
+ * Hands the items of a window that did not finish back to another backend, dropping what the
+ * ring read of them.
+ *
+ * Params:
+ *  - window of items.
+ *  - count of items on window.
+ */
+static void wfeAssetWindowAbandon(wfeAssetWindow *window, wfeSize count) {
+    wfeSize i;
+    for (i = 0; i < count; i++) {
+        if (window->first[i].status == WFE_CONTINUE || window->unsupported[i])
+            wfeAssetBatchFail(&window->first[i], WFE_CONTINUE);
+    }
+}
+
+/**
+ * Loads items through io_uring, a window at a time: opens and stats of the window go in one
+ * submission, reads into a single registered pool buffer in a second one (plus one more per
+ * round of short or split reads) and closes in a last one.
+ *
+ * Params:
+ *  - ring to use.
+ *  - items to load.
+ *  - count of items.
+ *  - pool to place data and temporary paths.
+ * Returns:
+ *  - WFE_SUCCESS or pool error that stopped the batch.
+ *  - WFE_CONTINUE if the kernel refused the ring or some operation, items not loaded yet are
+ *    left pending for another backend.
+ */
+static wfeError wfeAssetBatchUring(wfeAssetRing *ring, wfeAssetBatchItem *items, wfeSize count, wfePool *pool) {
+    wfeAssetWindow window;
+    struct io_uring_sqe *sqe;
+    struct iovec region;
+    wfePoolMarker marker;
+    wfeBool registered, fixed = WFE_TRUE;
+    const wfeChar *fpath;
+    wfeError status;
+    wfeData *buffer;
+    wfeSize start, i, n, total, left, queued;
+
+    for (start = 0; start < count; start += n) {
+        n = count - start < WFE_ASSET_RING_WINDOW ? count - start : WFE_ASSET_RING_WINDOW;
+        window.first = &items[start];
+
+        // Paths are only needed until files are open.
+        wfePoolMark(pool, &marker);
+        for (i = 0; i < n; i++) {
+            window.fds[i] = -1;
+            window.unsupported[i] = WFE_FALSE;
+            if (items[start + i].status != WFE_CONTINUE)
+                continue;
+
+            status = wfeAssetResolve(items[start + i].name, items[start + i].ext, pool, &fpath);
+            if (status == WFE_ASSET_FILE_ACCESS_ERROR) {
+                wfeAssetBatchFail(&items[start + i], status);
+                continue;
+            }
+
+            if (WFE_HAVE_FAILED(status))
+                return status;
+
+            sqe = wfeAssetRingPush(ring, WFE_ASSET_OP_OPEN, i);
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = (wfeUint64) (wfeSize) fpath;
+            sqe->open_flags = O_RDONLY;
+
+            sqe = wfeAssetRingPush(ring, WFE_ASSET_OP_STAT, i);
+            sqe->opcode = IORING_OP_STATX;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = (wfeUint64) (wfeSize) fpath;
+            sqe->len = STATX_SIZE;
+            sqe->off = (wfeUint64) (wfeSize) &window.stats[i];
+        }
+
+        if (!wfeAssetRingRun(ring, window.first, wfeAssetWindowHandle, &window)) {
+            wfeAssetWindowClose(&window, n);
+            wfeAssetWindowAbandon(&window, n);
+            wfePoolRewind(pool, &marker);
+            return WFE_CONTINUE;
+        }
+
+        wfePoolRewind(pool, &marker);
+
+        // Whole window goes to a single buffer, so it is registered (pinned) only once.
+        total = 0;
+        for (i = 0; i < n; i++) {
+            if (items[start + i].status == WFE_CONTINUE && !window.unsupported[i])
+                total += (wfeSize) window.stats[i].stx_size;
+        }
+
+        buffer = wfePoolGet(pool, total > 0 ? total : 1, wfeAlignOf(char));
+        if (buffer == NULL) {
+            wfeAssetWindowClose(&window, n);
+            return pool->lastError;
+        }
+
+        region.iov_base = buffer;
+        region.iov_len = total > 0 ? total : 1;
+        registered = WFE_FALSE;
+        if (fixed && total > 0) {
+            registered = syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, &region, 1) == 0;
+            fixed = registered; // Locked memory limits do not change, stop trying once refused.
+        }
+
+        for (i = 0; i < n; i++) {
+            window.done[i] = 0;
+            if (items[start + i].status != WFE_CONTINUE || window.unsupported[i])
+                continue;
+
+            items[start + i].data = buffer;
+            items[start + i].size = (wfeSize) window.stats[i].stx_size;
+            buffer += items[start + i].size;
+        }
+
+        // Each round reads what is left of every item, up to WFE_ASSET_RING_READ bytes each.
+        do {
+            queued = 0;
+            for (i = 0; i < n; i++) {
+                if (items[start + i].status != WFE_CONTINUE || window.unsupported[i] || window.done[i] >= items[start + i].size)
+                    continue;
+
+                left = items[start + i].size - window.done[i];
+                sqe = wfeAssetRingPush(ring, WFE_ASSET_OP_READ, i);
+                sqe->opcode = registered ? IORING_OP_READ_FIXED : IORING_OP_READ;
+                sqe->fd = window.fds[i];
+                sqe->addr = (wfeUint64) (wfeSize) (items[start + i].data + window.done[i]);
+                sqe->len = (wfeUint32) (left < WFE_ASSET_RING_READ ? left : WFE_ASSET_RING_READ);
+                sqe->off = (wfeUint64) window.done[i];
+                queued++;
+            }
+
+            if (queued > 0 && !wfeAssetRingRun(ring, window.first, wfeAssetWindowHandle, &window)) {
+                wfeAssetWindowClose(&window, n);
+                wfeAssetWindowAbandon(&window, n);
+                return WFE_CONTINUE;
+            }
+        } while (queued > 0);
+
+        if (registered)
+            syscall(__NR_io_uring_register, ring->fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+
+        for (i = 0; i < n; i++) {
+            if (items[start + i].status == WFE_CONTINUE && !window.unsupported[i])
+                items[start + i].status = WFE_SUCCESS;
+
+            if (window.fds[i] < 0)
+                continue;
+
+            sqe = wfeAssetRingPush(ring, WFE_ASSET_OP_CLOSE, i);
+            sqe->opcode = IORING_OP_CLOSE;
+            sqe->fd = window.fds[i];
+        }
+
+        if (!wfeAssetRingRun(ring, window.first, wfeAssetWindowHandle, &window))
+            wfeAssetWindowClose(&window, n);
+
+        // A kernel that refused an operation refuses it for every window.
+        for (i = 0; i < n; i++) {
+            if (window.unsupported[i]) {
+                wfeAssetWindowAbandon(&window, n);
+                return WFE_CONTINUE;
+            }
+        }
+    }
+
+    return WFE_SUCCESS;
+}
+#endif
+
+wfeError wfeAssetLoadBatch(wfeAssetBatchItem *items, wfeSize count, wfePool *pool, wfeUint32 flags) {
+    wfeError status = WFE_SUCCESS;
+    wfeUint64 trace = wfeTraceBegin();
+    wfeSize i, bytes = 0L;
+    assert(items != NULL || count == 0 /* items should reference something */);
+    assert(pool != NULL /* memory should reference something */);
+
+    // Items found on packs are done, the rest stay pending (WFE_CONTINUE) for the backend.
+    for (i = 0; i < count; i++) {
+        assert(items[i].name != NULL /* name should exists */);
+        assert(items[i].ext != NULL /* ext should exists */);
+        wfeAssetBatchFail(&items[i], WFE_CONTINUE);
+        status = wfeAssetPackLoad(items[i].name, items[i].ext, pool, &items[i].data, &items[i].size);
+        if (status == WFE_CONTINUE)
+            continue;
+
+        items[i].status = status;
+        if (WFE_HAVE_FAILED(status) && status != WFE_DID_NOT_READ_ALL_FILE)
+            return status;
+    }
+
+    status = WFE_SUCCESS;
+
+#ifdef WFE_ASSET_URING
+    wfeAssetRing ring;
+    if ((flags & WFE_ASSET_BATCH_NO_URING) == 0 && wfeAssetRingInit(&ring)) {
+        status = wfeAssetBatchUring(&ring, items, count, pool);
+        wfeAssetRingFinalize(&ring);
+        if (status != WFE_CONTINUE)
+            goto finalize;
+    }
+#endif
+
+#ifdef HAVE_UNISTD_H
+    status = wfeAssetBatchPread(items, count, pool);
+#else
+    for (i = 0; i < count; i++)
+        if (items[i].status == WFE_CONTINUE)
+            items[i].status = wfeAssetLoadRaw(items[i].name, items[i].ext, pool, &items[i].data, &items[i].size);
+#endif
+
+#ifdef WFE_ASSET_URING
+finalize:
+#endif
+    if (WFE_HAVE_FAILED(status))
+        return status;
+
+    // Batch is a single span, backends read items interleaved.
+    for (i = 0; i < count; i++)
+        bytes += items[i].size;
+
+    wfeTraceEnd(trace, "batch", NULL, NULL, bytes, WFE_TRACE_CACHE_NONE);
+    for (i = 0; i < count; i++) {
+        if (WFE_HAVE_FAILED(items[i].status))
+            return items[i].status;
+    }
+
+    return WFE_SUCCESS;
+}
@@ -0,0 +1,347 @@
+// Folder listing is not part of strict C11.
+#define _DEFAULT_SOURCE
+#include <wfe/asset.h>
+#include <wfe/types.h>
+#include <wfe/pool.h>
+#include <wfe/trace.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <assert.h>
+
+#ifdef HAVE_UNISTD_H
+#include <dirent.h>
+#include <sys/stat.h>
+#elif defined(_WINDOWS)
+#include <windows.h>
+#endif
+
+#define WFE_ASSET_INDEX_BASIS ((wfeUint64) 0xcbf29ce484222325) // FNV-1a offset basis
+#define WFE_ASSET_INDEX_INITIAL 1024 // Slots of a new index, always a power of two
+
+/**
+ * Indexed file, relative path is the key.
+ */
+typedef struct wfeAssetIndexEntry {
+    wfeUint64 hash;           // Hash of relative path, zero for empty slots
+    const wfeChar *relative;  // Path from root, as assets are named (e.g. "level1/door.desc")
+    wfeSize relativeSize;
+    const wfeChar *path;      // Path to open, root included
+} wfeAssetIndexEntry;
+
+static wfeAssetIndexEntry *wfeIndex = NULL;
+static wfeSize wfeIndexCapacity = 0;
+static wfeSize wfeIndexCount = 0;
+static wfePool wfeIndexPool; // Holds paths of indexed files
+
+wfeChar *makePath(const wfeChar *name, const wfeChar *ext, wfePool *pool);
+void wfeAssetManifestNote(const wfeChar *name, const wfeChar *ext);
+
+/**
+ * Hashes a relative path given in pieces with 64 bit FNV-1a, so name and extension do not
+ * need to be joined.
+ *
+ * Params:
+ *  - hash to continue, WFE_ASSET_INDEX_BASIS to start.
+ *  - str piece of path.
+ *  - size of piece.
+ * Returns:
+ *  - Hash including piece.
+ */
+static wfeUint64 wfeAssetIndexHash(wfeUint64 hash, const wfeChar *str, wfeSize size) {
+    wfeSize i;
+    for (i = 0; i < size; i++) {
+        hash ^= (wfeUint8) str[i];
+        hash *= (wfeUint64) 0x100000001b3;
+    }
+
+    return hash;
+}
+
+/**
+ * Finds the slot of a relative path given in pieces, or the empty slot where it belongs.
+ *
+ * Params:
+ *  - hash of path.
+ *  - name first piece of path.
+ *  - nalen size of name.
+ *  - ext second piece of path.
+ *  - exlen size of ext.
+ * Returns:
+ *  - Slot of path, empty if path is not indexed.
+ */
+static wfeAssetIndexEntry *wfeAssetIndexFind(wfeUint64 hash, const wfeChar *name, wfeSize nalen, const wfeChar *ext, wfeSize exlen) {
+    wfeSize slot = (wfeSize) hash & (wfeIndexCapacity - 1);
+    wfeAssetIndexEntry *entry;
+
+    for (;; slot = (slot + 1) & (wfeIndexCapacity - 1)) {
+        entry = &wfeIndex[slot];
+        if (entry->hash == 0)
+            return entry;
+
+        if (entry->hash == hash && entry->relativeSize == nalen + exlen &&
+            memcmp(entry->relative, name, nalen) == 0 && memcmp(entry->relative + nalen, ext, exlen) == 0)
+            return entry;
+    }
+}
+
+/**
+ * Doubles the slots of the index and places entries again.
+ *
+ * Returns:
+ *  - WFE_TRUE if index grew.
+ */
+static wfeBool wfeAssetIndexGrow(void) {
+    wfeAssetIndexEntry *old = wfeIndex, *entry;
+    wfeSize capacity = wfeIndexCapacity, i;
+
+    wfeIndex = calloc(capacity > 0 ? capacity * 2 : WFE_ASSET_INDEX_INITIAL, sizeof(wfeAssetIndexEntry));
+    if (wfeIndex == NULL) {
+        wfeIndex = old;
+        return WFE_FALSE;
+    }
+
+    wfeIndexCapacity = capacity > 0 ? capacity * 2 : WFE_ASSET_INDEX_INITIAL;
+    for (i = 0; i < capacity; i++) {
+        if (old[i].hash == 0)
+            continue;
+
+        entry = wfeAssetIndexFind(old[i].hash, old[i].relative, old[i].relativeSize, "", 0);
+        *entry = old[i];
+    }
+
+    free(old);
+    return WFE_TRUE;
+}
+
+/**
+ * Adds a file to the index, a file of a later root replaces the one indexed before.
+ *
+ * Params:
+ *  - path to open, root included.
+ *  - relative path from root.
+ * Returns:
+ *  - WFE_SUCCESS.
+ *  - WFE_ASSET_INDEX_OMEM if index could not grow.
+ *  - WFE_POOL_* in case that pool returns error.
+ */
+static wfeError wfeAssetIndexPut(const wfeChar *path, const wfeChar *relative) {
+    wfeSize relen = strlen(relative), palen = strlen(path);
+    wfeAssetIndexEntry *entry;
+    wfeChar *copy;
+    wfeUint64 hash;
+
+    // Load factor stays under one half.
+    if ((wfeIndexCount + 1) * 2 > wfeIndexCapacity && !wfeAssetIndexGrow())
+        return WFE_ASSET_INDEX_OMEM;
+
+    hash = wfeAssetIndexHash(WFE_ASSET_INDEX_BASIS, relative, relen);
+    hash = hash != 0 ? hash : 1;
+    entry = wfeAssetIndexFind(hash, relative, relen, "", 0);
+
+    // Relative path is the tail of the path, both share memory.
+    copy = wfePoolGet(&wfeIndexPool, palen + 1, wfeAlignOf(char));
+    if (copy == NULL)
+        return wfeIndexPool.lastError;
+
+    memcpy(copy, path, palen + 1);
+    if (entry->hash == 0)
+        wfeIndexCount++;
+
+    entry->hash = hash;
+    entry->relative = copy + palen - relen;
+    entry->relativeSize = relen;
+    entry->path = copy;
+    return WFE_SUCCESS;
+}
+
+/**
+ * Indexes every file under a folder, recursively.
+ *
+ * Params:
+ *  - path of folder, root included.
+ *  - skip bytes of root and separator on path, what is left is the relative path.
+ *  - scratch pool for paths of folders and files, finalized by caller once root is scanned.
+ * Returns:
+ *  - WFE_SUCCESS.
+ *  - WFE_ASSET_FILE_ACCESS_ERROR if folder could not be listed.
+ *  - All errors from wfeAssetIndexPut.
+ */
+static wfeError wfeAssetIndexScan(const wfeChar *path, wfeSize skip, wfePool *scratch) {
+    wfeError status = WFE_SUCCESS;
+    wfeSize palen = strlen(path), itlen;
+    wfeChar *child;
+#ifdef HAVE_UNISTD_H
+    struct dirent *item;
+    struct stat info;
+    DIR *dir = opendir(path);
+    if (dir == NULL)
+        return WFE_ASSET_FILE_ACCESS_ERROR;
+
+    while (!WFE_HAVE_FAILED(status) && (item = readdir(dir)) != NULL) {
+        if (strcmp(item->d_name, ".") == 0 || strcmp(item->d_name, "..") == 0)
+            continue;
+
+        itlen = strlen(item->d_name);
+        child = wfePoolGet(scratch, palen + itlen + 2, wfeAlignOf(char));
+        if (child == NULL) {
+            status = scratch->lastError; break;
+        }
+
+        // Links to folders are skipped, a link to one of its parents would never end.
+        sprintf(child, "%s%s%s", path, WFE_FILE_SEPARATOR_STR, item->d_name);
+        if (lstat(child, &info) != 0 || (S_ISLNK(info.st_mode) && (stat(child, &info) != 0 || S_ISDIR(info.st_mode))))
+            continue;
+
+        if (S_ISDIR(info.st_mode))
+            status = wfeAssetIndexScan(child, skip, scratch);
+        else if (S_ISREG(info.st_mode))
+            status = wfeAssetIndexPut(child, child + skip);
+    }
+
+    closedir(dir);
+#elif defined(_WINDOWS)
+    WIN32_FIND_DATAA item;
+    HANDLE find;
+
+    child = wfePoolGet(scratch, palen + 3, wfeAlignOf(char));
+    if (child == NULL)
+        return scratch->lastError;
+
+    sprintf(child, "%s\\*", path);
+    find = FindFirstFileA(child, &item);
+    if (find == INVALID_HANDLE_VALUE)
+        return WFE_ASSET_FILE_ACCESS_ERROR;
+
+    do {
+        if (strcmp(item.cFileName, ".") == 0 || strcmp(item.cFileName, "..") == 0)
+            continue;
+
+        itlen = strlen(item.cFileName);
+        child = wfePoolGet(scratch, palen + itlen + 2, wfeAlignOf(char));
+        if (child == NULL) {
+            status = scratch->lastError; break;
+        }
+
+        sprintf(child, "%s%s%s", path, WFE_FILE_SEPARATOR_STR, item.cFileName);
+        if (item.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            status = wfeAssetIndexScan(child, skip, scratch);
+        else
+            status = wfeAssetIndexPut(child, child + skip);
+    } while (!WFE_HAVE_FAILED(status) && FindNextFileA(find, &item));
+
+    FindClose(find);
+#else
+    (void) palen; (void) itlen; (void) child; (void) skip; (void) scratch;
+    status = WFE_ASSET_FILE_ACCESS_ERROR;
+#endif
+
+    return status;
+}
+
+wfeError wfeAssetAddSearchRoot(const wfeChar *root) {
+    wfeError status;
+    wfeChar *path;
+    wfePool scratch;
+    wfeSize rolen;
+    assert(root != NULL /* root should reference a folder */);
+
+    if (wfeIndex == NULL) {
+        if (!wfeAssetIndexGrow())
+            return WFE_ASSET_INDEX_OMEM;
+
+        status = wfePoolInit(&wfeIndexPool);
+        if (WFE_HAVE_FAILED(status)) {
+            free(wfeIndex);
+            wfeIndex = NULL;
+            wfeIndexCapacity = 0;
+            return status;
+        }
+    }
+
+    // Folder paths are temporary, the index pool keeps only file paths.
+    rolen = strlen(root);
+    while (rolen > 1 && root[rolen - 1] == WFE_FILE_SEPARATOR)
+        rolen--;
+
+    status = wfePoolInit(&scratch);
+    if (WFE_HAVE_FAILED(status))
+        return status;
+
+    path = wfePoolGet(&scratch, rolen + 1, wfeAlignOf(char));
+    if (path == NULL) {
+        status = scratch.lastError; goto finalize;
+    }
+
+    memcpy(path, root, rolen);
+    path[rolen] = '\0';
+    status = wfeAssetIndexScan(path, rolen + 1, &scratch);
+
+finalize:
+    wfePoolFinalize(&scratch);
+    return status;
+}
+
+void wfeAssetClearSearchRoots(void) {
+    if (wfeIndex == NULL)
+        return;
+
+    free(wfeIndex);
+    wfeIndex = NULL;
+    wfeIndexCapacity = 0;
+    wfeIndexCount = 0;
+    wfePoolFinalize(&wfeIndexPool);
+}
+
+/**
+ * Resolves the path to open for an asset. With search roots the index answers, found or not,
+ * without building strings nor touching the disk. Otherwise path is built on the search path.
+ *
+ * Params:
+ *  - name and folder of asset.
+ *  - ext for extension of asset.
+ *  - pool to build path on, only without search roots.
+ *  - path (out) path to open.
+ * Returns:
+ *  - WFE_SUCCESS.
+ *  - WFE_ASSET_FILE_ACCESS_ERROR if no search root holds the asset.
+ *  - WFE_POOL_* in case that pool returns error.
+ */
+wfeError wfeAssetLocate(const wfeChar *name, const wfeChar *ext, wfePool *pool, const wfeChar **path) {
+    wfeAssetIndexEntry *entry;
+    wfeSize nalen, exlen;
+    wfeUint64 hash;
+
+    if (wfeIndex == NULL) {
+        *path = makePath(name, ext, pool);
+        return *path != NULL ? WFE_SUCCESS : pool->lastError;
+    }
+
+    nalen = strlen(name);
+    exlen = strlen(ext);
+    hash = wfeAssetIndexHash(wfeAssetIndexHash(WFE_ASSET_INDEX_BASIS, name, nalen), ext, exlen);
+    entry = wfeAssetIndexFind(hash != 0 ? hash : 1, name, nalen, ext, exlen);
+    *path = entry->path;
+    return entry->hash != 0 ? WFE_SUCCESS : WFE_ASSET_FILE_ACCESS_ERROR;
+}
+
+/**
+ * Same as wfeAssetLocate for loads, noting the asset on the manifest being recorded.
+ *
+ * Params:
+ *  - name and folder of asset.
+ *  - ext for extension of asset.
+ *  - pool to build path on, only without search roots.
+ *  - path (out) path to open.
+ * Returns:
+ *  - All results from wfeAssetLocate.
+ */
+wfeError wfeAssetResolve(const wfeChar *name, const wfeChar *ext, wfePool *pool, const wfeChar **path) {
+    wfeUint64 trace = wfeTraceBegin();
+    wfeError status = wfeAssetLocate(name, ext, pool, path);
+    wfeTraceEnd(trace, "resolve", name, ext, 0L, WFE_TRACE_CACHE_NONE);
+    if (status == WFE_SUCCESS)
+        wfeAssetManifestNote(name, ext);
+
+    return status;
+}
@@ -0,0 +1,304 @@
+// posix_fadvise is not part of strict C11.
+#define _DEFAULT_SOURCE
+#include <wfe/asset.h>
+#include <wfe/types.h>
+#include <wfe/pool.h>
+#include <wfx/hashmap.h>
+#include <stdatomic.h>
+#include <threads.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <assert.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+#define WFE_ASSET_PREFETCH_BUFFER 65536 // Bytes read at once where files can not be advised
+
+/**
+ * Asset accessed while recording, kept in order of first access.
+ */
+typedef struct wfeAssetManifestEntry {
+    struct wfeAssetManifestEntry *next;
+    wfeUint64 offset; // Nanoseconds from start of recording to first access
+    wfeChar *key;     // Name with extension
+} wfeAssetManifestEntry;
+
+static once_flag wfeManifestOnce = ONCE_FLAG_INIT;
+static mtx_t wfeManifestLock;             // Guards every recording static below
+static atomic_bool wfeManifestRecording;  // Checked without lock by every resolve
+static wfeChar *wfeManifestPath;
+static wfeUint64 wfeManifestStart;
+static wfePool wfeManifestPool;           // Holds entries and their keys
+static wfeHashmap wfeManifestKeys;        // Keys seen, only first access is recorded
+static wfeAssetManifestEntry *wfeManifestHead, *wfeManifestTail;
+
+static wfeBool wfePrefetchRunning = WFE_FALSE;
+static atomic_bool wfePrefetchCancel;
+static atomic_size_t wfePrefetchCount;
+static wfeChar *wfePrefetchManifest;      // Content of manifest, owned by prefetch thread until joined
+static thrd_t wfePrefetchThread;
+
+wfeError wfeAssetLocate(const wfeChar *name, const wfeChar *ext, wfePool *pool, const wfeChar **path);
+
+// Current monotonic-enough time in nanoseconds, only used for offsets.
+static wfeUint64 wfeAssetManifestNow(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (wfeUint64) ts.tv_sec * 1000000000 + (wfeUint64) ts.tv_nsec;
+}
+
+static void wfeAssetManifestInitLock(void) {
+    mtx_init(&wfeManifestLock, mtx_plain);
+}
+
+/**
+ * Records the first access to an asset, called by every load that resolves a file.
+ *
+ * Params:
+ *  - name and folder of asset.
+ *  - ext for extension of asset.
+ */
+void wfeAssetManifestNote(const wfeChar *name, const wfeChar *ext) {
+    wfeSize nalen, exlen;
+    wfeAssetManifestEntry *entry;
+    wfePoolMarker marker;
+    wfeAny found;
+    wfeChar *key;
+
+    if (!atomic_load_explicit(&wfeManifestRecording, memory_order_relaxed))
+        return;
+
+    nalen = strlen(name);
+    exlen = strlen(ext);
+    mtx_lock(&wfeManifestLock);
+    if (!atomic_load(&wfeManifestRecording))
+        goto finalize;
+
+    // Key is built on the pool and dropped again if asset was seen.
+    wfePoolMark(&wfeManifestPool, &marker);
+    key = wfePoolGet(&wfeManifestPool, nalen + exlen + 1, wfeAlignOf(char));
+    if (key == NULL)
+        goto finalize;
+
+    memcpy(key, name, nalen);
+    memcpy(key + nalen, ext, exlen + 1);
+    if (wfeHashmapGet(&wfeManifestKeys, key, &found) == WFE_SUCCESS) {
+        wfePoolRewind(&wfeManifestPool, &marker);
+        goto finalize;
+    }
+
+    entry = (wfeAssetManifestEntry *) wfePoolGet(&wfeManifestPool, sizeof(wfeAssetManifestEntry), wfeAlignOf(wfeAssetManifestEntry));
+    if (entry == NULL || WFE_HAVE_FAILED(wfeHashmapPut(&wfeManifestKeys, key, entry))) {
+        wfePoolRewind(&wfeManifestPool, &marker);
+        goto finalize;
+    }
+
+    entry->next = NULL;
+    entry->offset = wfeAssetManifestNow() - wfeManifestStart;
+    entry->key = key;
+    if (wfeManifestTail != NULL)
+        wfeManifestTail->next = entry;
+    else
+        wfeManifestHead = entry;
+
+    wfeManifestTail = entry;
+
+finalize:
+    mtx_unlock(&wfeManifestLock);
+}
+
+wfeError wfeAssetManifestRecord(const wfeChar *path) {
+    wfeError status = WFE_SUCCESS;
+    wfeSize palen;
+    assert(path != NULL /* path should reference a file */);
+
+    call_once(&wfeManifestOnce, wfeAssetManifestInitLock);
+    mtx_lock(&wfeManifestLock);
+    if (atomic_load(&wfeManifestRecording))
+        goto finalize;
+
+    palen = strlen(path);
+    wfeManifestPath = malloc(palen + 1);
+    if (wfeManifestPath == NULL) {
+        status = WFE_ASSET_MANIFEST_OMEM; goto finalize;
+    }
+
+    status = wfeHashmapInit(&wfeManifestKeys);
+    if (WFE_HAVE_FAILED(status)) {
+        free(wfeManifestPath);
+        goto finalize;
+    }
+
+    memcpy(wfeManifestPath, path, palen + 1);
+    wfePoolInit(&wfeManifestPool);
+    wfeManifestHead = NULL;
+    wfeManifestTail = NULL;
+    wfeManifestStart = wfeAssetManifestNow();
+    atomic_store(&wfeManifestRecording, WFE_TRUE);
+
+finalize:
+    mtx_unlock(&wfeManifestLock);
+    return status;
+}
+
+wfeError wfeAssetManifestFinish(void) {
+    wfeError status = WFE_SUCCESS;
+    wfeAssetManifestEntry *entry;
+    FILE *file;
+
+    call_once(&wfeManifestOnce, wfeAssetManifestInitLock);
+    mtx_lock(&wfeManifestLock);
+    if (!atomic_load(&wfeManifestRecording))
+        goto finalize;
+
+    atomic_store(&wfeManifestRecording, WFE_FALSE);
+    file = fopen(wfeManifestPath, "w");
+    if (file == NULL) {
+        status = WFE_ASSET_FILE_ACCESS_ERROR;
+    } else {
+        // One asset per line, microseconds from start then the key up to the end of line.
+        for (entry = wfeManifestHead; entry != NULL; entry = entry->next)
+            fprintf(file, "%llu %s\n", (unsigned long long) (entry->offset / 1000), entry->key);
+
+        if (fclose(file) != 0)
+            status = WFE_ASSET_FILE_ACCESS_ERROR;
+    }
+
+    wfeHashmapFinalize(&wfeManifestKeys);
+    wfePoolFinalize(&wfeManifestPool);
+    free(wfeManifestPath);
+    wfeManifestPath = NULL;
+    wfeManifestHead = NULL;
+    wfeManifestTail = NULL;
+
+finalize:
+    mtx_unlock(&wfeManifestLock);
+    return status;
+}
+
+/**
+ * Asks the system to bring a file into the page cache, without copying it anywhere.
+ *
+ * Params:
+ *  - path of file.
+ * Returns:
+ *  - WFE_TRUE if file exists and was advised or read.
+ */
+static wfeBool wfeAssetPrefetchFile(const wfeChar *path) {
+#if defined(HAVE_UNISTD_H) && defined(POSIX_FADV_WILLNEED)
+    // Read-ahead is queued by the kernel, the call returns before pages are read.
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return WFE_FALSE;
+
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+    return WFE_TRUE;
+#else
+    // No advice available, reading the file leaves it on the page cache the same.
+    wfeData buffer[WFE_ASSET_PREFETCH_BUFFER];
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return WFE_FALSE;
+
+    while (!atomic_load(&wfePrefetchCancel) && fread(buffer, 1, sizeof(buffer), file) == sizeof(buffer));
+    fclose(file);
+    return WFE_TRUE;
+#endif
+}
+
+/**
+ * Body of prefetch thread, walks the manifest in order of first access.
+ *
+ * Params:
+ *  - arg unused.
+ * Returns:
+ *  - Zero always.
+ */
+static int wfeAssetPrefetchRun(void *arg) {
+    wfeChar *line = wfePrefetchManifest, *next, *key;
+    const wfeChar *path;
+    wfePoolMarker marker;
+    wfePool pool;
+    (void) arg;
+
+    wfePoolInit(&pool);
+    wfePoolMark(&pool, &marker);
+    for (; *line != '\0' && !atomic_load(&wfePrefetchCancel); line = next) {
+        next = strchr(line, '\n');
+        if (next != NULL)
+            *next++ = '\0';
+        else
+            next = line + strlen(line);
+
+        // Key is the whole name, index and search path take it without extension.
+        key = strchr(line, ' ');
+        if (key == NULL || key[1] == '\0')
+            continue;
+
+        if (wfeAssetLocate(key + 1, "", &pool, &path) == WFE_SUCCESS && wfeAssetPrefetchFile(path))
+            atomic_fetch_add(&wfePrefetchCount, 1);
+
+        wfePoolRewind(&pool, &marker);
+    }
+
+    wfePoolFinalize(&pool);
+    return 0;
+}
+
+wfeError wfeAssetManifestPrefetch(const wfeChar *path) {
+    long length;
+    FILE *file;
+    assert(path != NULL /* path should reference a file */);
+    assert(!wfePrefetchRunning /* previous prefetch should be ended */);
+
+    file = fopen(path, "rb");
+    if (file == NULL)
+        return WFE_ASSET_FILE_ACCESS_ERROR;
+
+    if (fseek(file, 0L, SEEK_END) != 0 || (length = ftell(file)) < 0 || fseek(file, 0L, SEEK_SET) != 0) {
+        fclose(file);
+        return WFE_ASSET_FILE_ACCESS_ERROR;
+    }
+
+    wfePrefetchManifest = malloc((wfeSize) length + 1);
+    if (wfePrefetchManifest == NULL) {
+        fclose(file);
+        return WFE_ASSET_MANIFEST_OMEM;
+    }
+
+    if (fread(wfePrefetchManifest, 1, (wfeSize) length, file) != (wfeSize) length) {
+        free(wfePrefetchManifest);
+        fclose(file);
+        return WFE_DID_NOT_READ_ALL_FILE;
+    }
+
+    fclose(file);
+    wfePrefetchManifest[length] = '\0';
+    atomic_store(&wfePrefetchCancel, WFE_FALSE);
+    atomic_store(&wfePrefetchCount, 0);
+    if (thrd_create(&wfePrefetchThread, wfeAssetPrefetchRun, NULL) != thrd_success) {
+        free(wfePrefetchManifest);
+        return WFE_ASSET_MANIFEST_THREAD_ERROR;
+    }
+
+    wfePrefetchRunning = WFE_TRUE;
+    return WFE_SUCCESS;
+}
+
+wfeSize wfeAssetManifestEndPrefetch(wfeBool cancel) {
+    if (!wfePrefetchRunning)
+        return 0;
+
+    atomic_store(&wfePrefetchCancel, cancel);
+    thrd_join(wfePrefetchThread, NULL);
+    free(wfePrefetchManifest);
+    wfePrefetchManifest = NULL;
+    wfePrefetchRunning = WFE_FALSE;
+    return atomic_load(&wfePrefetchCount);
+}
@@ -0,0 +1,746 @@
+// pread is not part of strict C11.
+#define _DEFAULT_SOURCE
+#include <wfe/asset.h>
+#include <wfe/types.h>
+#include <wfe/pool.h>
+#include <zlib/zlib.h>
+#include <stdatomic.h>
+#include <threads.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <assert.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#include <fcntl.h>
+#elif defined(_WINDOWS)
+#include <windows.h>
+#endif
+
+#define WFE_ASSET_PACK_MAGIC ((wfeUint64) 0x314b434150454657) // "WFEPACK1"
+#define WFE_ASSET_PACK_VERSION 2
+#define WFE_ASSET_PACK_ALIGN 4096   // Entries start on page boundaries
+#define WFE_ASSET_PACK_CHUNK 262144 // Uncompressed bytes of each deflate stream
+#define WFE_ASSET_PACK_BASIS ((wfeUint64) 0xcbf29ce484222325) // FNV-1a offset basis
+
+/**
+ * Head of a pack file, followed by the TOC, the names and the entries. Values are written
+ * in host byte order.
+ */
+typedef struct wfeAssetPackHeader {
+    wfeUint64 magic;     // WFE_ASSET_PACK_MAGIC
+    wfeUint32 version;   // WFE_ASSET_PACK_VERSION
+    wfeUint32 count;     // Count of entries
+    wfeUint64 namesSize; // Bytes of names after TOC
+    wfeUint32 align;     // Alignment of entries
+    wfeUint32 reserved;
+} wfeAssetPackHeader;
+
+/**
+ * TOC entry, TOC is sorted by hash.
+ *
+ * Compressed entries start with the compressed size of each chunk (wfeUint32), followed by
+ * one zlib stream per chunk. Streams are independent, so they inflate on different threads.
+ */
+typedef struct wfeAssetPackEntry {
+    wfeUint64 hash;     // Hash of name, see wfeAssetPackHash
+    wfeUint64 offset;   // Offset of data on file
+    wfeUint64 size;     // Bytes of data once loaded
+    wfeUint64 stored;   // Bytes of data on file
+    wfeUint32 name;     // Offset of name on names
+    wfeUint32 nameSize; // Bytes of name, not null-terminated
+    wfeUint32 chunk;    // Uncompressed bytes of each chunk, zero if entry is stored as is
+    wfeUint32 reserved;
+} wfeAssetPackEntry;
+
+/**
+ * Entry being inflated, chunks are taken by the loading thread and by inflate workers.
+ */
+typedef struct wfeAssetPackJob {
+    const wfeData *src;       // First stream
+    const wfeUint32 *sizes;   // Compressed bytes of each stream
+    const wfeUint64 *starts;  // Offset of each stream from src
+    wfeData *dst;             // Output, size bytes
+    wfeUint64 size;
+    wfeUint32 chunk;
+    wfeSize count;            // Count of chunks
+    atomic_size_t next;       // Next chunk to take
+    atomic_bool failed;       // A stream was corrupt
+    wfeSize active;           // Workers running chunks, guarded by inflate lock
+} wfeAssetPackJob;
+
+/**
+ * Mounted pack, TOC and names stay on memory.
+ */
+typedef struct wfeAssetPack {
+    wfeAssetPackEntry *toc;
+    wfeChar *names;
+    wfeUint32 count;
+#ifdef HAVE_UNISTD_H
+    int fd;
+#elif defined(_WINDOWS)
+    HANDLE file;
+#else
+    FILE *file;
+#endif
+} wfeAssetPack;
+
+static wfeAssetPack wfePacks[WFE_ASSET_MAX_PACKS];
+static wfeSize wfePackCount = 0;
+
+// Inflate workers, a single job is shared at a time, other loads inflate on their own.
+static thrd_t wfeInflateThreads[WFE_ASSET_MAX_INFLATE_WORKERS];
+static wfeSize wfeInflateCount = 0;
+static wfeAssetPackJob *wfeInflateJob = NULL;
+static wfeBool wfeInflateStop = WFE_FALSE;
+static mtx_t wfeInflateLock;
+static cnd_t wfeInflateWake;     // Signals workers about a new job or stop
+static cnd_t wfeInflateFinished; // Signals the loading thread about idle workers
+
+// Counters of compressed entries, see wfeAssetPackStats.
+static atomic_uint_fast64_t wfeInflateEntries;
+static atomic_uint_fast64_t wfeInflateStored;
+static atomic_uint_fast64_t wfeInflateSize;
+static atomic_uint_fast64_t wfeInflateNanoseconds;
+
+/**
+ * Hashes an entry name given in pieces with 64 bit FNV-1a, so name and extension do not
+ * need to be joined.
+ *
+ * Params:
+ *  - hash to continue, WFE_ASSET_PACK_BASIS to start.
+ *  - str piece of name.
+ *  - size of piece.
+ * Returns:
+ *  - Hash including piece.
+ */
+static wfeUint64 wfeAssetPackHash(wfeUint64 hash, const wfeChar *str, wfeSize size) {
+    wfeSize i;
+    for (i = 0; i < size; i++) {
+        hash ^= (wfeUint8) str[i];
+        hash *= (wfeUint64) 0x100000001b3;
+    }
+
+    return hash;
+}
+
+/**
+ * Reads bytes of a mounted pack at an offset. Reads do not move a shared file position, so
+ * loader workers can read the same pack at once (except on systems with stdio only).
+ *
+ * Params:
+ *  - pack to read.
+ *  - buf to write.
+ *  - size to read.
+ *  - offset on pack file.
+ * Returns:
+ *  - WFE_TRUE if every byte was read.
+ */
+static wfeBool wfeAssetPackRead(wfeAssetPack *pack, wfeData *buf, wfeSize size, wfeUint64 offset) {
+#ifdef HAVE_UNISTD_H
+    wfeSize done;
+    ssize_t rcount;
+    for (done = 0; done < size; done += (wfeSize) rcount) {
+        rcount = pread(pack->fd, buf + done, size - done, (off_t) (offset + done));
+        if (rcount <= 0)
+            return WFE_FALSE;
+    }
+
+    return WFE_TRUE;
+#elif defined(_WINDOWS)
+    OVERLAPPED position;
+    wfeSize done;
+    DWORD rcount;
+    for (done = 0; done < size; done += (wfeSize) rcount) {
+        memset(&position, 0, sizeof(position));
+        position.Offset = (DWORD) (offset + done);
+        position.OffsetHigh = (DWORD) ((offset + done) >> 32);
+        rcount = 0;
+        if (!ReadFile(pack->file, buf + done, (DWORD) (size - done < 0x40000000 ? size - done : 0x40000000), &rcount, &position) || rcount == 0)
+            return WFE_FALSE;
+    }
+
+    return WFE_TRUE;
+#else
+    return fseek(pack->file, (long) offset, SEEK_SET) == 0 && fread(buf, 1, size, pack->file) == size;
+#endif
+}
+
+// Closes file of a pack and releases its TOC.
+static void wfeAssetPackClose(wfeAssetPack *pack) {
+#ifdef HAVE_UNISTD_H
+    close(pack->fd);
+#elif defined(_WINDOWS)
+    CloseHandle(pack->file);
+#else
+    fclose(pack->file);
+#endif
+    free(pack->toc);
+}
+
+// Current monotonic-enough time in nanoseconds, only used for rates.
+static wfeUint64 wfeAssetPackNow(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (wfeUint64) ts.tv_sec * 1000000000 + (wfeUint64) ts.tv_nsec;
+}
+
+/**
+ * Inflates chunks of a job until none is left to take.
+ *
+ * Params:
+ *  - job to run.
+ */
+static void wfeAssetPackInflateChunks(wfeAssetPackJob *job) {
+    wfeUint64 expected;
+    uLongf length;
+    wfeSize i;
+
+    while ((i = atomic_fetch_add(&job->next, 1)) < job->count) {
+        if (atomic_load(&job->failed))
+            continue;
+
+        expected = i + 1 < job->count ? job->chunk : job->size - (wfeUint64) i * job->chunk;
+        length = (uLongf) expected;
+        if (uncompress((Bytef *) job->dst + (wfeSize) i * job->chunk, &length, (const Bytef *) job->src + job->starts[i], job->sizes[i]) != Z_OK ||
+            length != expected)
+            atomic_store(&job->failed, WFE_TRUE);
+    }
+}
+
+/**
+ * Body of inflate workers, helps with the shared job until stopped.
+ *
+ * Params:
+ *  - arg unused.
+ * Returns:
+ *  - Zero always.
+ */
+static int wfeAssetPackInflateRun(void *arg) {
+    wfeAssetPackJob *job;
+    (void) arg;
+
+    mtx_lock(&wfeInflateLock);
+    while (!wfeInflateStop) {
+        job = wfeInflateJob;
+        if (job != NULL && atomic_load(&job->next) < job->count) {
+            job->active++;
+            mtx_unlock(&wfeInflateLock);
+            wfeAssetPackInflateChunks(job);
+            mtx_lock(&wfeInflateLock);
+            if (--job->active == 0)
+                cnd_signal(&wfeInflateFinished);
+            continue;
+        }
+
+        cnd_wait(&wfeInflateWake, &wfeInflateLock);
+    }
+
+    mtx_unlock(&wfeInflateLock);
+    return 0;
+}
+
+/**
+ * Inflates a job on this thread, along with inflate workers when they are idle.
+ *
+ * Params:
+ *  - job to run.
+ * Returns:
+ *  - WFE_TRUE if every stream inflated to its expected size.
+ */
+static wfeBool wfeAssetPackInflate(wfeAssetPackJob *job) {
+    wfeBool shared = WFE_FALSE;
+
+    if (wfeInflateCount > 0 && job->count > 1) {
+        mtx_lock(&wfeInflateLock);
+        if (wfeInflateJob == NULL) {
+            wfeInflateJob = job;
+            shared = WFE_TRUE;
+            cnd_broadcast(&wfeInflateWake);
+        }
+
+        mtx_unlock(&wfeInflateLock);
+    }
+
+    wfeAssetPackInflateChunks(job);
+
+    // Job lives on this stack, workers must leave it before returning.
+    if (shared) {
+        mtx_lock(&wfeInflateLock);
+        while (job->active > 0)
+            cnd_wait(&wfeInflateFinished, &wfeInflateLock);
+
+        wfeInflateJob = NULL;
+        mtx_unlock(&wfeInflateLock);
+    }
+
+    return !atomic_load(&job->failed);
+}
+
+// Stops and joins inflate workers, releasing their locks.
+static void wfeAssetPackStopWorkers(void) {
+    wfeSize i;
+
+    mtx_lock(&wfeInflateLock);
+    wfeInflateStop = WFE_TRUE;
+    cnd_broadcast(&wfeInflateWake);
+    mtx_unlock(&wfeInflateLock);
+
+    for (i = 0; i < wfeInflateCount; i++)
+        thrd_join(wfeInflateThreads[i], NULL);
+
+    wfeInflateCount = 0;
+    cnd_destroy(&wfeInflateFinished);
+    cnd_destroy(&wfeInflateWake);
+    mtx_destroy(&wfeInflateLock);
+}
+
+wfeError wfeAssetSetInflateWorkers(wfeSize count) {
+    wfeSize i;
+
+    if (count > WFE_ASSET_MAX_INFLATE_WORKERS)
+        return WFE_ASSET_INFLATE_COUNT;
+
+    if (wfeInflateCount > 0)
+        wfeAssetPackStopWorkers();
+
+    if (count == 0)
+        return WFE_SUCCESS;
+
+    wfeInflateStop = WFE_FALSE;
+    wfeInflateJob = NULL;
+    if (mtx_init(&wfeInflateLock, mtx_plain) != thrd_success)
+        goto failed_lock;
+
+    if (cnd_init(&wfeInflateWake) != thrd_success)
+        goto failed_wake;
+
+    if (cnd_init(&wfeInflateFinished) != thrd_success)
+        goto failed_finished;
+
+    for (i = 0; i < count; i++) {
+        if (thrd_create(&wfeInflateThreads[i], wfeAssetPackInflateRun, NULL) != thrd_success) {
+            wfeAssetPackStopWorkers();
+            return WFE_ASSET_INFLATE_THREAD_ERROR;
+        }
+
+        wfeInflateCount++;
+    }
+
+    return WFE_SUCCESS;
+
+failed_finished:
+    cnd_destroy(&wfeInflateWake);
+failed_wake:
+    mtx_destroy(&wfeInflateLock);
+failed_lock:
+    return WFE_ASSET_INFLATE_THREAD_ERROR;
+}
+
+void wfeAssetPackStats(wfeAssetPackReport *report) {
+    assert(report != NULL /* report should reference something */);
+
+    report->entries = (wfeUint64) atomic_load(&wfeInflateEntries);
+    report->stored = (wfeUint64) atomic_load(&wfeInflateStored);
+    report->size = (wfeUint64) atomic_load(&wfeInflateSize);
+    report->nanoseconds = (wfeUint64) atomic_load(&wfeInflateNanoseconds);
+}
+
+void wfeAssetPackStatsDump(FILE *out) {
+    wfeAssetPackReport report;
+    assert(out != NULL /* out must reference a stream */);
+
+    wfeAssetPackStats(&report);
+    fprintf(out, "{\"entries\": %llu, \"stored\": %llu, \"size\": %llu, \"nanoseconds\": %llu, \"ratio\": %.3f, \"mbps\": %.1f}\n",
+            (unsigned long long) report.entries, (unsigned long long) report.stored,
+            (unsigned long long) report.size, (unsigned long long) report.nanoseconds,
+            report.size > 0 ? (double) report.stored / (double) report.size : 1.0,
+            report.nanoseconds > 0 ? (double) report.size * 1e3 / (double) report.nanoseconds : 0.0);
+}
+
+wfeError wfeAssetMountPack(const wfeChar *path) {
+    wfeAssetPackHeader header;
+    wfeAssetPack *pack;
+    wfeSize tocSize, i;
+    assert(path != NULL /* path should reference a file */);
+
+    if (wfePackCount == WFE_ASSET_MAX_PACKS)
+        return WFE_ASSET_PACK_LIMIT;
+
+    pack = &wfePacks[wfePackCount];
+    pack->toc = NULL;
+#ifdef HAVE_UNISTD_H
+    pack->fd = open(path, O_RDONLY);
+    if (pack->fd < 0)
+        return WFE_ASSET_FILE_ACCESS_ERROR;
+#elif defined(_WINDOWS)
+    pack->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (pack->file == INVALID_HANDLE_VALUE)
+        return WFE_ASSET_FILE_ACCESS_ERROR;
+#else
+    pack->file = fopen(path, "rb");
+    if (pack->file == NULL)
+        return WFE_ASSET_FILE_ACCESS_ERROR;
+#endif
+
+    if (!wfeAssetPackRead(pack, (wfeData *) &header, sizeof(header), 0) || header.magic != WFE_ASSET_PACK_MAGIC ||
+        header.version != WFE_ASSET_PACK_VERSION || header.namesSize > (wfeUint64) 0xffffffff)
+        goto invalid;
+
+    // TOC and names are read at once, they are next to each other.
+    tocSize = header.count * sizeof(wfeAssetPackEntry);
+    pack->toc = malloc(tocSize + (wfeSize) header.namesSize + 1);
+    if (pack->toc == NULL || !wfeAssetPackRead(pack, (wfeData *) pack->toc, tocSize + (wfeSize) header.namesSize, sizeof(header)))
+        goto invalid;
+
+    pack->names = (wfeChar *) pack->toc + tocSize;
+    pack->count = header.count;
+    for (i = 0; i < pack->count; i++) {
+        if ((wfeUint64) pack->toc[i].name + pack->toc[i].nameSize > header.namesSize ||
+            (i > 0 && pack->toc[i].hash < pack->toc[i-1].hash) ||
+            (pack->toc[i].chunk == 0 && pack->toc[i].stored != pack->toc[i].size))
+            goto invalid;
+    }
+
+    wfePackCount++;
+    return WFE_SUCCESS;
+
+invalid:
+    wfeAssetPackClose(pack);
+    return WFE_ASSET_PACK_INVALID;
+}
+
+void wfeAssetUnmountPacks(void) {
+    while (wfePackCount > 0)
+        wfeAssetPackClose(&wfePacks[--wfePackCount]);
+}
+
+/**
+ * Reads a compressed entry and inflates it. Compressed bytes live on pool only while the
+ * entry inflates.
+ *
+ * Params:
+ *  - pack holding entry.
+ *  - entry to load, with chunk bigger than zero.
+ *  - pool for temporary memory.
+ *  - dst output of entry->size bytes.
+ * Returns:
+ *  - WFE_SUCCESS if entry is inflated.
+ *  - WFE_DID_NOT_READ_ALL_FILE if pack is shorter than entry.
+ *  - WFE_ASSET_PACK_INVALID if streams are corrupt.
+ *  - WFE_POOL_* in case that pool returns error.
+ */
+static wfeError wfeAssetPackLoadCompressed(wfeAssetPack *pack, const wfeAssetPackEntry *entry, wfePool *pool, wfeData *dst) {
+    wfeError status = WFE_SUCCESS;
+    wfeAssetPackJob job;
+    wfePoolMarker marker;
+    wfeUint64 *starts, total, begin;
+    wfeData *src;
+    wfeSize i, count;
+
+    count = (wfeSize) ((entry->size + entry->chunk - 1) / entry->chunk);
+    if (entry->stored < (wfeUint64) count * sizeof(wfeUint32))
+        return WFE_ASSET_PACK_INVALID;
+
+    wfePoolMark(pool, &marker);
+    src = wfePoolGet(pool, entry->stored > 0 ? (wfeSize) entry->stored : 1, wfeAlignOf(wfeUint32));
+    starts = (wfeUint64 *) wfePoolGet(pool, sizeof(wfeUint64) * (count + 1), wfeAlignOf(wfeUint64));
+    if (src == NULL || starts == NULL) {
+        status = pool->lastError; goto finalize;
+    }
+
+    if (!wfeAssetPackRead(pack, src, (wfeSize) entry->stored, entry->offset)) {
+        status = WFE_DID_NOT_READ_ALL_FILE; goto finalize;
+    }
+
+    // Streams must fill the entry exactly.
+    job.sizes = (const wfeUint32 *) src;
+    job.src = src + count * sizeof(wfeUint32);
+    total = 0;
+    for (i = 0; i < count; i++) {
+        starts[i] = total;
+        total += job.sizes[i];
+    }
+
+    if (total != entry->stored - count * sizeof(wfeUint32)) {
+        status = WFE_ASSET_PACK_INVALID; goto finalize;
+    }
+
+    begin = wfeAssetPackNow();
+    job.starts = starts;
+    job.dst = dst;
+    job.size = entry->size;
+    job.chunk = entry->chunk;
+    job.count = count;
+    job.active = 0;
+    atomic_init(&job.next, 0);
+    atomic_init(&job.failed, WFE_FALSE);
+    if (!wfeAssetPackInflate(&job)) {
+        status = WFE_ASSET_PACK_INVALID; goto finalize;
+    }
+
+    atomic_fetch_add(&wfeInflateEntries, 1);
+    atomic_fetch_add(&wfeInflateStored, entry->stored);
+    atomic_fetch_add(&wfeInflateSize, entry->size);
+    atomic_fetch_add(&wfeInflateNanoseconds, wfeAssetPackNow() - begin);
+
+finalize:
+    wfePoolRewind(pool, &marker);
+    return status;
+}
+
+/**
+ * Loads an asset from mounted packs, packs mounted last are looked up first so they can
+ * override older ones.
+ *
+ * Params:
+ *  - name and folder of asset.
+ *  - ext for extension of asset.
+ *  - pool to allocate memory.
+ *  - data (out) reference to asset start.
+ *  - size (out) size of data.
+ * Returns:
+ *  - WFE_CONTINUE if no pack holds the asset.
+ *  - Same as wfeAssetLoadRaw otherwise.
+ */
+wfeError wfeAssetPackLoad(const wfeChar *name, const wfeChar *ext, wfePool *pool, const wfeData **data, wfeSize *size) {
+    wfeSize nalen, exlen, p, low, high, mid;
+    wfeAssetPackEntry *entry;
+    wfeAssetPack *pack;
+    wfeUint64 hash;
+    wfeData *fdata;
+    wfeError status;
+
+    if (wfePackCount == 0)
+        return WFE_CONTINUE;
+
+    nalen = strlen(name);
+    exlen = strlen(ext);
+    hash = wfeAssetPackHash(wfeAssetPackHash(WFE_ASSET_PACK_BASIS, name, nalen), ext, exlen);
+    for (p = wfePackCount; p-- > 0;) {
+        pack = &wfePacks[p];
+
+        // First entry with the hash, collisions are next to it.
+        low = 0;
+        high = pack->count;
+        while (low < high) {
+            mid = (low + high) / 2;
+            if (pack->toc[mid].hash < hash)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+
+        for (; low < pack->count && pack->toc[low].hash == hash; low++) {
+            entry = &pack->toc[low];
+            if (entry->nameSize != nalen + exlen || memcmp(pack->names + entry->name, name, nalen) != 0 ||
+                memcmp(pack->names + entry->name + nalen, ext, exlen) != 0)
+                continue;
+
+            fdata = wfePoolGet(pool, entry->size > 0 ? (wfeSize) entry->size : 1, wfeAlignOf(char));
+            if (fdata == NULL)
+                return pool->lastError;
+
+            status = entry->chunk == 0 ? (wfeAssetPackRead(pack, fdata, (wfeSize) entry->size, entry->offset) ? WFE_SUCCESS : WFE_DID_NOT_READ_ALL_FILE)
+                                       : wfeAssetPackLoadCompressed(pack, entry, pool, fdata);
+            if (WFE_HAVE_FAILED(status))
+                return status;
+
+            *data = fdata;
+            *size = (wfeSize) entry->size;
+            return WFE_SUCCESS;
+        }
+    }
+
+    return WFE_CONTINUE;
+}
+
+// Orders TOC entries by hash.
+static int wfeAssetPackCompare(const void *a, const void *b) {
+    const wfeAssetPackEntry *ea = a, *eb = b;
+    return ea->hash < eb->hash ? -1 : (ea->hash > eb->hash ? 1 : 0);
+}
+
+/**
+ * Compresses an entry into independent chunk streams.
+ *
+ * Params:
+ *  - src data of entry.
+ *  - size of data, bigger than zero.
+ *  - level of zlib, from 1 to 9.
+ *  - pool to allocate output, left on pool.
+ *  - packed (out) output, sizes of chunks first.
+ *  - stored (out) bytes of output.
+ * Returns:
+ *  - WFE_SUCCESS if entry is compressed.
+ *  - WFE_ASSET_PACK_WRITE if zlib failed.
+ *  - WFE_POOL_* in case that pool returns error.
+ */
+static wfeError wfeAssetPackDeflate(const wfeData *src, wfeSize size, wfeInt32 level, wfePool *pool, wfeData **packed, wfeSize *stored) {
+    wfeSize count = (size + WFE_ASSET_PACK_CHUNK - 1) / WFE_ASSET_PACK_CHUNK, i, length;
+    wfeUint32 *sizes;
+    wfeData *dst;
+    uLongf written;
+
+    dst = wfePoolGet(pool, count * (sizeof(wfeUint32) + compressBound(WFE_ASSET_PACK_CHUNK)), wfeAlignOf(wfeUint32));
+    if (dst == NULL)
+        return pool->lastError;
+
+    sizes = (wfeUint32 *) dst;
+    *stored = count * sizeof(wfeUint32);
+    for (i = 0; i < count; i++) {
+        length = size - i * WFE_ASSET_PACK_CHUNK < WFE_ASSET_PACK_CHUNK ? size - i * WFE_ASSET_PACK_CHUNK : WFE_ASSET_PACK_CHUNK;
+        written = compressBound(WFE_ASSET_PACK_CHUNK);
+        if (compress2((Bytef *) dst + *stored, &written, (const Bytef *) src + i * WFE_ASSET_PACK_CHUNK, (uLong) length, level) != Z_OK)
+            return WFE_ASSET_PACK_WRITE;
+
+        sizes[i] = (wfeUint32) written;
+        *stored += written;
+    }
+
+    *packed = dst;
+    return WFE_SUCCESS;
+}
+
+wfeError wfeAssetPackWrite(const wfeChar *path, const wfeChar *root, const wfeChar **names, wfeSize count, wfeInt32 level, wfePool *pool) {
+    static const wfeChar padding[WFE_ASSET_PACK_ALIGN];
+    wfeError status = WFE_SUCCESS;
+    wfeAssetPackHeader header;
+    wfeAssetPackEntry *toc;
+    wfePoolMarker marker, entryMarker;
+    wfeChar **paths;
+    wfeSize *order;
+    const wfeData *source;
+    wfeData *content, *packed = NULL;
+    wfeSize i, nameSize, rootSize, stored = 0;
+    wfeUint64 offset, aligned;
+    FILE *out = NULL, *in = NULL;
+    long length;
+    assert(path != NULL /* path should reference a file */);
+    assert(root != NULL /* root should reference a folder */);
+    assert(names != NULL || count == 0 /* names should reference something */);
+    assert(level >= 0 && level <= 9 /* level should be a zlib level */);
+    assert(pool != NULL /* memory should reference something */);
+
+    wfePoolMark(pool, &marker);
+    rootSize = strlen(root);
+    toc = (wfeAssetPackEntry *) wfePoolGet(pool, sizeof(wfeAssetPackEntry) * (count + 1), wfeAlignOf(wfeAssetPackEntry));
+    paths = (wfeChar **) wfePoolGet(pool, sizeof(wfeChar *) * (count + 1), wfeAlignOf(wfeChar *));
+    order = (wfeSize *) wfePoolGet(pool, sizeof(wfeSize) * (count + 1), wfeAlignOf(wfeSize));
+    if (toc == NULL || paths == NULL || order == NULL) {
+        status = pool->lastError; goto finalize;
+    }
+
+    header.magic = WFE_ASSET_PACK_MAGIC;
+    header.version = WFE_ASSET_PACK_VERSION;
+    header.count = (wfeUint32) count;
+    header.namesSize = 0;
+    header.align = WFE_ASSET_PACK_ALIGN;
+    header.reserved = 0;
+
+    // Measure sources, names are written in the order given.
+    for (i = 0; i < count; i++) {
+        nameSize = strlen(names[i]);
+        paths[i] = wfePoolGet(pool, rootSize + nameSize + 2, wfeAlignOf(char));
+        if (paths[i] == NULL) {
+            status = pool->lastError; goto finalize;
+        }
+
+        sprintf(paths[i], "%s%s%s", root, WFE_FILE_SEPARATOR_STR, names[i]);
+        in = fopen(paths[i], "rb");
+        if (in == NULL || fseek(in, 0L, SEEK_END) != 0 || (length = ftell(in)) < 0) {
+            status = WFE_ASSET_FILE_ACCESS_ERROR; goto finalize;
+        }
+
+        fclose(in);
+        in = NULL;
+        memset(&toc[i], 0, sizeof(wfeAssetPackEntry));
+        toc[i].hash = wfeAssetPackHash(WFE_ASSET_PACK_BASIS, names[i], nameSize);
+        toc[i].offset = (wfeUint64) i; // Source of entry until TOC is sorted
+        toc[i].size = (wfeUint64) length;
+        toc[i].name = (wfeUint32) header.namesSize;
+        toc[i].nameSize = (wfeUint32) nameSize;
+        header.namesSize += nameSize;
+    }
+
+    qsort(toc, count, sizeof(wfeAssetPackEntry), wfeAssetPackCompare);
+    for (i = 0; i < count; i++)
+        order[i] = (wfeSize) toc[i].offset;
+
+    // TOC is written again once stored sizes are known.
+    out = fopen(path, "wb");
+    if (out == NULL || fwrite(&header, sizeof(header), 1, out) != 1 ||
+        fwrite(toc, sizeof(wfeAssetPackEntry), count, out) != count) {
+        status = WFE_ASSET_PACK_WRITE; goto finalize;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (fwrite(names[i], 1, strlen(names[i]), out) != strlen(names[i])) {
+            status = WFE_ASSET_PACK_WRITE; goto finalize;
+        }
+    }
+
+    // Entries in TOC order, so the file is read forward when every entry is loaded.
+    offset = sizeof(header) + sizeof(wfeAssetPackEntry) * count + header.namesSize;
+    for (i = 0; i < count; i++) {
+        wfePoolMark(pool, &entryMarker);
+        content = wfePoolGet(pool, toc[i].size > 0 ? (wfeSize) toc[i].size : 1, wfeAlignOf(char));
+        if (content == NULL) {
+            status = pool->lastError; goto finalize;
+        }
+
+        in = fopen(paths[order[i]], "rb");
+        if (in == NULL) {
+            status = WFE_ASSET_FILE_ACCESS_ERROR; goto finalize;
+        }
+
+        if (fread(content, 1, (wfeSize) toc[i].size, in) != (wfeSize) toc[i].size || fgetc(in) != EOF) {
+            status = WFE_DID_NOT_READ_ALL_FILE; goto finalize;
+        }
+
+        fclose(in);
+        in = NULL;
+
+        // Entries that do not shrink are stored as is.
+        source = content;
+        toc[i].stored = toc[i].size;
+        if (level > 0 && toc[i].size > 0) {
+            status = wfeAssetPackDeflate(content, (wfeSize) toc[i].size, level, pool, &packed, &stored);
+            if (WFE_HAVE_FAILED(status))
+                goto finalize;
+
+            if (stored < toc[i].size) {
+                source = packed;
+                toc[i].stored = stored;
+                toc[i].chunk = WFE_ASSET_PACK_CHUNK;
+            }
+        }
+
+        aligned = wfePoolMemoryAlign(offset, WFE_ASSET_PACK_ALIGN);
+        if (fwrite(padding, 1, (wfeSize) (aligned - offset), out) != (wfeSize) (aligned - offset) ||
+            fwrite(source, 1, (wfeSize) toc[i].stored, out) != (wfeSize) toc[i].stored) {
+            status = WFE_ASSET_PACK_WRITE; goto finalize;
+        }
+
+        toc[i].offset = aligned;
+        offset = aligned + toc[i].stored;
+        wfePoolRewind(pool, &entryMarker);
+    }
+
+    if (fseek(out, (long) sizeof(header), SEEK_SET) != 0 ||
+        fwrite(toc, sizeof(wfeAssetPackEntry), count, out) != count) {
+        status = WFE_ASSET_PACK_WRITE; goto finalize;
+    }
+
+finalize:
+    if (in != NULL)
+        fclose(in);
+
+    if (out != NULL && fclose(out) != 0 && !WFE_HAVE_FAILED(status))
+        status = WFE_ASSET_PACK_WRITE;
+
+    wfePoolRewind(pool, &marker);
+    return status;
+}
@@ -0,0 +1,217 @@
+#include <wfe/asset.h>
+#include <wfe/types.h>
+#include <wfe/pool.h>
+#include <wfe/trace.h>
+#include <threads.h>
+#include <stdio.h>
+#include <assert.h>
+
+wfeError wfeAssetResolve(const wfeChar *name, const wfeChar *ext, wfePool *pool, const wfeChar **path);
+wfeError wfeAssetPackLoad(const wfeChar *name, const wfeChar *ext, wfePool *pool, const wfeData **data, wfeSize *size);
+
+/**
+ * Ring of chunk buffers shared by the read-ahead thread and the consumer. Slots are filled
+ * and consumed in order, counters only grow and slot of chunk n is n % depth.
+ */
+typedef struct wfeAssetStream {
+    FILE *file;
+    wfeData *buffers; // depth buffers of chunk bytes
+    wfeSize *sizes;   // Bytes read on each slot
+    wfeSize chunk, depth;
+    wfeSize filled;   // Chunks read
+    wfeSize consumed; // Chunks delivered
+    wfeBool ended;    // Reader reached end of file or failed
+    wfeBool failed;   // Reader could not read
+    wfeBool stop;     // Consumer stopped
+    mtx_t lock;
+    cnd_t produced;
+    cnd_t released;
+} wfeAssetStream;
+
+/**
+ * Body of read-ahead thread, fills free slots until end of file or stop.
+ *
+ * Params:
+ *  - arg stream to fill.
+ * Returns:
+ *  - Zero always.
+ */
+static int wfeAssetStreamRead(void *arg) {
+    wfeAssetStream *stream = (wfeAssetStream *) arg;
+    wfeSize slot, rcount;
+    wfeBool ended = WFE_FALSE;
+
+    while (!ended) {
+        mtx_lock(&stream->lock);
+        while (stream->filled - stream->consumed == stream->depth && !stream->stop)
+            cnd_wait(&stream->released, &stream->lock);
+
+        if (stream->stop) {
+            mtx_unlock(&stream->lock);
+            break;
+        }
+
+        slot = stream->filled % stream->depth;
+        mtx_unlock(&stream->lock);
+
+        // Slot is out of the consumer reach until filled grows.
+        rcount = fread(stream->buffers + slot * stream->chunk, 1, stream->chunk, stream->file);
+        ended = rcount < stream->chunk;
+
+        mtx_lock(&stream->lock);
+        stream->sizes[slot] = rcount;
+        if (rcount > 0)
+            stream->filled++;
+
+        stream->ended = ended;
+        stream->failed = ended && ferror(stream->file);
+        cnd_signal(&stream->produced);
+        mtx_unlock(&stream->lock);
+    }
+
+    return 0;
+}
+
+/**
+ * Delivers a buffer that is already on memory in chunks, used for assets served by packs.
+ *
+ * Params:
+ *  - data to deliver.
+ *  - size of data.
+ *  - chunk bytes of each delivery.
+ *  - callback and userdata as given to wfeAssetStreamRaw.
+ * Returns:
+ *  - Same as wfeAssetStreamRaw.
+ */
+static wfeError wfeAssetStreamMemory(const wfeData *data, wfeSize size, wfeSize chunk, wfeAssetStreamCallback callback, wfeAny userdata) {
+    wfeError status;
+    wfeSize offset;
+
+    for (offset = 0; offset < size; offset += chunk) {
+        status = callback(data + offset, size - offset < chunk ? size - offset : chunk, offset, userdata);
+        if (!WFE_SHOULD_CONTINUE(status))
+            return status;
+    }
+
+    return WFE_SUCCESS;
+}
+
+wfeError wfeAssetStreamRaw(const wfeChar *name, const wfeChar *ext, wfePool *pool, wfeSize chunk, wfeSize depth,
+                           wfeAssetStreamCallback callback, wfeAny userdata) {
+    wfeError status = WFE_SUCCESS, result;
+    wfeAssetStream stream;
+    wfePoolMarker marker;
+    const wfeChar *fpath;
+    const wfeData *data;
+    wfeSize slot, size, offset = 0;
+    wfeUint64 trace = wfeTraceBegin();
+    thrd_t reader;
+    assert(name != NULL /* name should exists */);
+    assert(ext != NULL /* ext should exists */);
+    assert(pool != NULL /* memory should reference something */);
+    assert(chunk > 0 /* chunks should hold something */);
+    assert(depth >= 2 /* ring needs a slot to read while another is consumed */);
+    assert(callback != NULL /* callback should receive chunks */);
+
+    wfePoolMark(pool, &marker);
+
+    // Packed assets are read whole, packs keep entries compressed or page aligned.
+    status = wfeAssetPackLoad(name, ext, pool, &data, &size);
+    if (!WFE_SHOULD_CONTINUE(status)) {
+        if (!WFE_HAVE_FAILED(status)) {
+            status = wfeAssetStreamMemory(data, size, chunk, callback, userdata);
+            offset = size;
+        }
+
+        goto finalize;
+    }
+
+    status = wfeAssetResolve(name, ext, pool, &fpath);
+    if (WFE_HAVE_FAILED(status))
+        goto finalize;
+
+    stream.file = fopen(fpath, "rb");
+    if (stream.file == NULL) {
+        status = WFE_ASSET_FILE_ACCESS_ERROR; goto finalize;
+    }
+
+    // Chunks are read straight into the ring, stdio buffer would copy them again.
+    setvbuf(stream.file, NULL, _IONBF, 0);
+    stream.buffers = wfePoolGet(pool, chunk * depth, wfeAlignOf(wfeUint64));
+    stream.sizes = (wfeSize *) wfePoolGet(pool, sizeof(wfeSize) * depth, wfeAlignOf(wfeSize));
+    if (stream.buffers == NULL || stream.sizes == NULL) {
+        fclose(stream.file);
+        status = pool->lastError; goto finalize;
+    }
+
+    stream.chunk = chunk;
+    stream.depth = depth;
+    stream.filled = 0;
+    stream.consumed = 0;
+    stream.ended = WFE_FALSE;
+    stream.failed = WFE_FALSE;
+    stream.stop = WFE_FALSE;
+    if (mtx_init(&stream.lock, mtx_plain) != thrd_success) {
+        fclose(stream.file);
+        status = WFE_ASSET_STREAM_THREAD_ERROR; goto finalize;
+    }
+
+    if (cnd_init(&stream.produced) != thrd_success)
+        goto failed_produced;
+
+    if (cnd_init(&stream.released) != thrd_success)
+        goto failed_released;
+
+    if (thrd_create(&reader, wfeAssetStreamRead, &stream) != thrd_success)
+        goto failed_reader;
+
+    // Consumer runs on this thread while the reader fills the next slots.
+    mtx_lock(&stream.lock);
+    for (;;) {
+        while (stream.filled == stream.consumed && !stream.ended)
+            cnd_wait(&stream.produced, &stream.lock);
+
+        if (stream.filled == stream.consumed) {
+            status = stream.failed ? WFE_DID_NOT_READ_ALL_FILE : WFE_SUCCESS;
+            break;
+        }
+
+        slot = stream.consumed % stream.depth;
+        size = stream.sizes[slot];
+        mtx_unlock(&stream.lock);
+
+        result = callback(stream.buffers + slot * stream.chunk, size, offset, userdata);
+        offset += size;
+
+        mtx_lock(&stream.lock);
+        stream.consumed++;
+        cnd_signal(&stream.released);
+        if (!WFE_SHOULD_CONTINUE(result)) {
+            status = result;
+            stream.stop = WFE_TRUE;
+            break;
+        }
+    }
+
+    mtx_unlock(&stream.lock);
+    thrd_join(reader, NULL);
+    cnd_destroy(&stream.released);
+    cnd_destroy(&stream.produced);
+    mtx_destroy(&stream.lock);
+    fclose(stream.file);
+    goto finalize;
+
+failed_reader:
+    cnd_destroy(&stream.released);
+failed_released:
+    cnd_destroy(&stream.produced);
+failed_produced:
+    mtx_destroy(&stream.lock);
+    fclose(stream.file);
+    status = WFE_ASSET_STREAM_THREAD_ERROR;
+
+finalize:
+    wfePoolRewind(pool, &marker);
+    wfeTraceEnd(trace, "stream", name, ext, offset, WFE_TRACE_CACHE_NONE);
+    return status;
+}
@@ -0,0 +1,305 @@
+#include <wfe/cache.h>
+#include <wfe/asset.h>
+#include <wfe/pool.h>
+#include <wfe/trace.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/**
+ * Unlinks an entry from the LRU list.
+ *
+ * Params:
+ *  - cache owner of list.
+ *  - entry on list.
+ */
+static void wfeCacheUnlink(wfeCache *cache, wfeCacheEntry *entry) {
+    if (entry->prev != NULL)
+        entry->prev->next = entry->next;
+    else
+        cache->head = entry->next;
+
+    if (entry->next != NULL)
+        entry->next->prev = entry->prev;
+    else
+        cache->tail = entry->prev;
+
+    entry->prev = NULL;
+    entry->next = NULL;
+}
+
+// Releases data and trees replaced while the entry was referenced.
+static void wfeCacheReleaseRetired(wfeCacheEntry *entry) {
+    wfeCacheRetired *retired;
+
+    while (entry->retired != NULL) {
+        retired = entry->retired;
+        entry->retired = retired->next;
+        if (retired->decoded)
+            wfeDescFinalize(&retired->desc);
+
+        free(retired->data);
+        free(retired);
+    }
+}
+
+// Releases memory of an entry, it must be out of the map and the list.
+static void wfeCacheDestroy(wfeCacheEntry *entry) {
+    wfeCacheReleaseRetired(entry);
+    if (entry->decoded)
+        wfeDescFinalize(&entry->desc);
+
+    free(entry->replaced);
+    free(entry);
+}
+
+/**
+ * Evicts entries without references, least recently released first, until the cost of
+ * entries fits on the budget.
+ *
+ * Params:
+ *  - cache to trim.
+ */
+static void wfeCacheTrim(wfeCache *cache) {
+    wfeCacheEntry *entry;
+
+    while (cache->stats.bytes > cache->budget && cache->head != NULL) {
+        entry = cache->head;
+        wfeCacheUnlink(cache, entry);
+        wfeHashmapRemove(&cache->map, entry->key);
+        cache->stats.bytes -= entry->cost;
+        cache->stats.entries--;
+        cache->stats.evictions++;
+        wfeCacheDestroy(entry);
+    }
+}
+
+// Frees an entry while the whole map is being dropped.
+static wfeError wfeCacheDrop(wfeAny userdata, wfeAny item) {
+    (void) userdata;
+    wfeCacheDestroy((wfeCacheEntry *) item);
+    return WFE_SUCCESS;
+}
+
+wfeError wfeCacheInit(wfeCache *cache, wfeSize budget) {
+    wfeError status;
+    assert(cache != NULL /* cache must not be null */);
+
+    status = wfeHashmapInit(&cache->map);
+    if (WFE_HAVE_FAILED(status))
+        return status;
+
+    wfePoolInit(&cache->scratch);
+    cache->head = NULL;
+    cache->tail = NULL;
+    cache->budget = budget;
+    memset(&cache->stats, 0, sizeof(cache->stats));
+    return WFE_SUCCESS;
+}
+
+void wfeCacheFinalize(wfeCache *cache) {
+    assert(cache != NULL /* cache must not be null */);
+
+    wfeHashmapIterate(&cache->map, wfeCacheDrop, NULL);
+    wfeHashmapFinalize(&cache->map);
+    wfePoolFinalize(&cache->scratch);
+    cache->head = NULL;
+    cache->tail = NULL;
+    memset(&cache->stats, 0, sizeof(cache->stats));
+}
+
+wfeError wfeCacheAcquire(wfeCache *cache, const wfeChar *name, const wfeChar *ext, wfeCacheEntry **entry) {
+    wfeError status = WFE_SUCCESS;
+    wfeCacheEntry *found;
+    wfePoolMarker marker;
+    const wfeData *data;
+    wfeChar *key;
+    wfeSize nalen, exlen, size;
+    wfeUint64 trace = wfeTraceBegin();
+    wfeUint32 cached = WFE_TRACE_CACHE_MISS;
+    assert(cache != NULL /* cache must not be null */);
+    assert(name != NULL /* name should exists */);
+    assert(ext != NULL /* ext should exists */);
+    assert(entry != NULL /* entry should reference something */);
+
+    *entry = NULL;
+    nalen = strlen(name);
+    exlen = strlen(ext);
+
+    // Key is built on scratch memory first, entries hold their own copy.
+    wfePoolMark(&cache->scratch, &marker);
+    key = wfePoolGet(&cache->scratch, nalen + exlen + 1, wfeAlignOf(char));
+    if (key == NULL) {
+        status = cache->scratch.lastError; goto finalize;
+    }
+
+    memcpy(key, name, nalen);
+    memcpy(key + nalen, ext, exlen + 1);
+    if (wfeHashmapGet(&cache->map, key, (wfeAny *) &found) == WFE_SUCCESS) {
+        if (found->refs++ == 0)
+            wfeCacheUnlink(cache, found);
+
+        cache->stats.hits++;
+        cached = WFE_TRACE_CACHE_HIT;
+        *entry = found;
+        goto finalize;
+    }
+
+    cache->stats.misses++;
+    status = wfeAssetLoadRaw(name, ext, &cache->scratch, &data, &size);
+    if (WFE_HAVE_FAILED(status))
+        goto finalize;
+
+    // Entry, data and key share a single allocation, data right after entry keeps its alignment.
+    found = malloc(sizeof(wfeCacheEntry) + size + nalen + exlen + 1);
+    if (found == NULL) {
+        status = WFE_CACHE_OMEM; goto finalize;
+    }
+
+    memcpy((wfeData *) (found + 1), data, size);
+    memcpy((wfeChar *) (found + 1) + size, key, nalen + exlen + 1);
+    found->data = (const wfeData *) (found + 1);
+    found->key = (const wfeChar *) (found + 1) + size;
+    found->size = size;
+    found->refs = 1;
+    found->cost = size;
+    found->version = 0;
+    found->decoded = WFE_FALSE;
+    found->replaced = NULL;
+    found->retired = NULL;
+    found->prev = NULL;
+    found->next = NULL;
+
+    status = wfeHashmapPut(&cache->map, found->key, found);
+    if (WFE_HAVE_FAILED(status)) {
+        free(found);
+        goto finalize;
+    }
+
+    cache->stats.entries++;
+    cache->stats.bytes += found->cost;
+    *entry = found;
+    wfeCacheTrim(cache);
+
+finalize:
+    wfePoolRewind(&cache->scratch, &marker);
+    wfeTraceEnd(trace, "cache", name, ext, *entry != NULL ? (*entry)->size : 0L, cached);
+    return status;
+}
+
+wfeError wfeCacheAcquireDesc(wfeCache *cache, const wfeChar *name, wfeCacheEntry **entry, wfeDesc *desc) {
+    wfeError status;
+    assert(desc != NULL /* desc should reference something */);
+
+    status = wfeCacheAcquire(cache, name, ".desc", entry);
+    if (WFE_HAVE_FAILED(status))
+        return status;
+
+    if (!(*entry)->decoded) {
+        wfeDescInit(&(*entry)->desc);
+        status = (*entry)->size > 0 ? wfeDescDecodeBuffer(&(*entry)->desc, (*entry)->data, (*entry)->size) : WFE_DESC_MSGPACK_ERROR;
+        if (WFE_HAVE_FAILED(status)) {
+            wfeDescFinalize(&(*entry)->desc);
+            wfeCacheRelease(cache, *entry);
+            *entry = NULL;
+            return status;
+        }
+
+        (*entry)->decoded = WFE_TRUE;
+    }
+
+    wfeCacheEntryDesc(*entry, desc);
+    return WFE_SUCCESS;
+}
+
+void wfeCacheEntryDesc(wfeCacheEntry *entry, wfeDesc *desc) {
+    assert(entry != NULL && entry->decoded /* entry should hold a desc */);
+    assert(desc != NULL /* desc should reference something */);
+
+    // Holders iterate on their own copy, the tree is shared.
+    *desc = entry->desc;
+    desc->currentKey = 0;
+}
+
+wfeError wfeCacheReplace(wfeCache *cache, const wfeChar *key, wfeData *data, wfeSize size) {
+    wfeError status = WFE_SUCCESS;
+    wfeCacheRetired *retired;
+    wfeCacheEntry *entry;
+    assert(cache != NULL /* cache must not be null */);
+    assert(key != NULL /* key should exists */);
+    assert(data != NULL /* data should reference something */);
+
+    if (wfeHashmapGet(&cache->map, key, (wfeAny *) &entry) != WFE_SUCCESS)
+        return WFE_HASHMAP_MISSING;
+
+    // Holders might still read current data or tree, they are kept until the last release.
+    if (entry->refs > 0) {
+        retired = malloc(sizeof(wfeCacheRetired));
+        if (retired == NULL)
+            return WFE_CACHE_OMEM;
+
+        retired->data = entry->replaced;
+        retired->decoded = entry->decoded;
+        retired->desc = entry->desc;
+        retired->next = entry->retired;
+        entry->retired = retired;
+    } else {
+        free(entry->replaced);
+        if (entry->decoded)
+            wfeDescFinalize(&entry->desc);
+    }
+
+    entry->replaced = data;
+    entry->data = data;
+    entry->size = size;
+    entry->version++;
+    cache->stats.bytes = cache->stats.bytes - entry->cost + size;
+    entry->cost = size;
+
+    if (entry->decoded) {
+        wfeDescInit(&entry->desc);
+        status = size > 0 ? wfeDescDecodeBuffer(&entry->desc, data, size) : WFE_DESC_MSGPACK_ERROR;
+        if (WFE_HAVE_FAILED(status)) {
+            wfeDescFinalize(&entry->desc);
+            entry->decoded = WFE_FALSE;
+        }
+    }
+
+    if (entry->refs == 0)
+        wfeCacheTrim(cache);
+
+    return status;
+}
+
+void wfeCacheRelease(wfeCache *cache, wfeCacheEntry *entry) {
+    assert(cache != NULL /* cache must not be null */);
+    assert(entry != NULL && entry->refs > 0 /* entry should be acquired */);
+
+    if (--entry->refs > 0)
+        return;
+
+    wfeCacheReleaseRetired(entry);
+    entry->prev = cache->tail;
+    entry->next = NULL;
+    if (cache->tail != NULL)
+        cache->tail->next = entry;
+    else
+        cache->head = entry;
+
+    cache->tail = entry;
+    wfeCacheTrim(cache);
+}
+
+void wfeCacheSetBudget(wfeCache *cache, wfeSize budget) {
+    assert(cache != NULL /* cache must not be null */);
+
+    cache->budget = budget;
+    wfeCacheTrim(cache);
+}
+
+void wfeCacheReadStats(wfeCache *cache, wfeCacheStats *stats) {
+    assert(cache != NULL /* cache must not be null */);
+    assert(stats != NULL /* stats should reference something */);
+
+    *stats = cache->stats;
+}
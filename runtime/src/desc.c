@@ -1,5 +1,7 @@
 #include <wfe/desc.h>
+#include <wfe/trace.h>
 #include <msgpack.h>
+#include <string.h>
 
 wfeError wfeDescInit(wfeDesc *desc) {
     assert(desc != NULL /* desc should reference something */);
@@ -13,7 +15,8 @@ wfeError wfeDescInit(wfeDesc *desc) {
 void wfeDescFinalize(wfeDesc *desc) {
     assert(desc != NULL /* desc should reference something */);
 
-    if (WFE_TRUE == desc->haveMap) {
+    // Maps decoded on a pool have no zone, pool owns them.
+    if (WFE_TRUE == desc->haveMap && desc->result.zone != NULL) {
         msgpack_unpacked_destroy(&desc->result);
         desc->haveMap = WFE_FALSE;
     }
@@ -30,7 +33,9 @@ wfeError wfeDescDecodeBuffer(wfeDesc *desc, const wfeData *buf, const wfeSize le
     msgpack_unpacked_init(&desc->result);
     desc->haveMap = WFE_TRUE;
 
+    wfeUint64 trace = wfeTraceBegin();
     ret = msgpack_unpack_next(&desc->result, buf, len, &offset);
+    wfeTraceEnd(trace, "decode", NULL, NULL, len, WFE_TRACE_CACHE_NONE);
     if (ret == MSGPACK_UNPACK_SUCCESS) {
         msgpack_object obj = desc->result.data;
         if (obj.type != MSGPACK_OBJECT_MAP) {
@@ -44,6 +49,147 @@ wfeError wfeDescDecodeBuffer(wfeDesc *desc, const wfeData *buf, const wfeSize le
     return WFE_DESC_MSGPACK_ERROR;
 }
 
+/**
+ * Measures the bytes that msgpack will request to its zone when unpacking the first object
+ * of a buffer. Only arrays and maps take zone memory, strings, binaries and extensions
+ * reference the buffer.
+ *
+ * Params:
+ *  - buf of bytes with msgpack encoded data.
+ *  - len of buffer.
+ *  - need (out) bytes of zone memory.
+ * Return:
+ *  - WFE_SUCCESS when first object fits on buffer.
+ *  - WFE_DESC_MSGPACK_ERROR if buffer is truncated or holds an invalid type.
+ */
+static wfeError wfeDescMeasure(const wfeData *buf, const wfeSize len, wfeSize *need) {
+    const wfeUint8 *cur = (const wfeUint8 *) buf, *end = cur + len;
+    wfeSize pending = 1, body, head, size, i;
+    wfeUint8 type;
+
+    *need = 0;
+    while (pending > 0) {
+        if (cur >= end) {
+            return WFE_DESC_MSGPACK_ERROR;
+        }
+
+        pending--;
+        type = *cur++;
+        body = 0; head = 0; size = 0;
+        if (type <= 0x7f || type >= 0xe0) {
+            // fixint has no payload.
+        } else if (type <= 0x8f) {
+            size = type & 0x0f;
+            pending += size * 2;
+            *need += size * sizeof(msgpack_object_kv) + MSGPACK_ZONE_ALIGN;
+        } else if (type <= 0x9f) {
+            size = type & 0x0f;
+            pending += size;
+            *need += size * sizeof(msgpack_object) + MSGPACK_ZONE_ALIGN;
+        } else if (type <= 0xbf) {
+            body = type & 0x1f;
+        } else {
+            switch (type) {
+            case 0xc0: case 0xc2: case 0xc3: break;              // nil, false, true
+            case 0xc4: case 0xd9: head = 1; break;               // bin8, str8
+            case 0xc5: case 0xda: head = 2; break;               // bin16, str16
+            case 0xc6: case 0xdb: head = 4; break;               // bin32, str32
+            case 0xc7: head = 1; body = 1; break;                // ext8, plus type byte
+            case 0xc8: head = 2; body = 1; break;                // ext16, plus type byte
+            case 0xc9: head = 4; body = 1; break;                // ext32, plus type byte
+            case 0xcc: case 0xd0: body = 1; break;               // uint8, int8
+            case 0xcd: case 0xd1: body = 2; break;               // uint16, int16
+            case 0xca: case 0xce: case 0xd2: body = 4; break;    // float32, uint32, int32
+            case 0xcb: case 0xcf: case 0xd3: body = 8; break;    // float64, uint64, int64
+            case 0xd4: body = 2; break;                          // fixext1
+            case 0xd5: body = 3; break;                          // fixext2
+            case 0xd6: body = 5; break;                          // fixext4
+            case 0xd7: body = 9; break;                          // fixext8
+            case 0xd8: body = 17; break;                         // fixext16
+            case 0xdc: case 0xde: head = 2; break;               // array16, map16
+            case 0xdd: case 0xdf: head = 4; break;               // array32, map32
+            default: return WFE_DESC_MSGPACK_ERROR;
+            }
+
+            // Lengths are big endian, containers count items instead of bytes.
+            if ((wfeSize) (end - cur) < head) {
+                return WFE_DESC_MSGPACK_ERROR;
+            }
+
+            for (i = 0; i < head; i++) {
+                size = (size << 8) | *cur++;
+            }
+
+            if (type == 0xdc || type == 0xdd) {
+                pending += size;
+                *need += size * sizeof(msgpack_object) + MSGPACK_ZONE_ALIGN;
+            } else if (type == 0xde || type == 0xdf) {
+                pending += size * 2;
+                *need += size * sizeof(msgpack_object_kv) + MSGPACK_ZONE_ALIGN;
+            } else {
+                body += size;
+            }
+        }
+
+        // Every item takes at least one byte, bigger counts can not fit on buffer.
+        if ((wfeSize) (end - cur) < body || pending > (wfeSize) (end - cur)) {
+            return WFE_DESC_MSGPACK_ERROR;
+        }
+
+        cur += body;
+    }
+
+    return WFE_SUCCESS;
+}
+
+wfeError wfeDescDecodeBufferPool(wfeDesc *desc, wfePool *pool, const wfeData *buf, const wfeSize len) {
+    wfeSize offset = 0L, need = 0L;
+    wfeUint64 trace = wfeTraceBegin();
+    msgpack_zone zone;
+    msgpack_object obj;
+    wfeError status;
+    wfeData *tree;
+    msgpack_unpack_return ret;
+
+    assert(desc != NULL /* desc should reference something */);
+    assert(pool != NULL /* pool should reference something */);
+    assert(buf != NULL /* buffer should contain data */);
+    assert(len > 0L /* buffer should contain data */);
+
+    status = wfeDescMeasure(buf, len, &need);
+    if (WFE_HAVE_FAILED(status)) {
+        return status;
+    }
+
+    tree = wfePoolGet(pool, need > 0 ? need : 1, MSGPACK_ZONE_ALIGN);
+    if (tree == NULL) {
+        return pool->lastError;
+    }
+
+    // Zone starts with the whole tree as free space, so it never needs a chunk of its own.
+    memset(&zone, 0, sizeof(msgpack_zone));
+    zone.chunk_list.free = need;
+    zone.chunk_list.ptr = tree;
+    zone.chunk_size = MSGPACK_ZONE_CHUNK_SIZE;
+    ret = msgpack_unpack(buf, len, &offset, &zone, &obj);
+    wfeTraceEnd(trace, "decode", NULL, NULL, len, WFE_TRACE_CACHE_NONE);
+    if (ret != MSGPACK_UNPACK_SUCCESS && ret != MSGPACK_UNPACK_EXTRA_BYTES) {
+        return WFE_DESC_MSGPACK_ERROR;
+    }
+
+    assert(zone.chunk_list.head == NULL /* tree should fit on measured memory */);
+    if (obj.type != MSGPACK_OBJECT_MAP) {
+        return WFE_DESC_UNSUPPORTED_TYPE;
+    }
+
+    desc->haveMap = WFE_TRUE;
+    desc->result.zone = NULL;
+    desc->result.data = obj;
+    desc->map = obj.via.map;
+    desc->currentKey = 0;
+    return WFE_SUCCESS;
+}
+
 wfeError wfeDescNextKey(wfeDesc *desc, const wfeChar **keystr, wfeSize *const keysize){
     assert(desc != NULL /* desc should reference something */);
     assert(keystr != NULL /* keystr should reference shometing */);
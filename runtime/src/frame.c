@@ -0,0 +1,83 @@
+#include <wfe/frame.h>
+#include <wfe/pool.h>
+#include <wfe/types.h>
+#include <assert.h>
+
+wfeError wfeFrameInit(wfeFrameAllocator *frames, wfeSize count) {
+    wfeSize i;
+    assert(frames != NULL /* frames should reference something */);
+
+    if (count == 0 || count > WFE_FRAME_MAX_POOLS)
+        return WFE_FRAME_INVALID_COUNT;
+
+    for (i = 0; i < count; i++) {
+        wfePoolInit(&frames->pools[i]);
+        frames->fences[i] = NULL;
+    }
+
+    // First wfeFrameBegin moves to the first pool.
+    frames->count = count;
+    frames->current = count - 1;
+    frames->frame = 0;
+    frames->wait = NULL;
+    frames->userdata = NULL;
+    return WFE_SUCCESS;
+}
+
+void wfeFrameFinalize(wfeFrameAllocator *frames) {
+    wfeSize i, index;
+    assert(frames != NULL /* frames should reference something */);
+
+    // Oldest frame first, right after the current one.
+    for (i = 1; i <= frames->count; i++) {
+        index = (frames->current + i) % frames->count;
+        if (frames->fences[index] != NULL && frames->wait != NULL)
+            frames->wait(frames->fences[index], frames->userdata);
+
+        frames->fences[index] = NULL;
+        wfePoolFinalize(&frames->pools[index]);
+    }
+
+    frames->count = 0;
+}
+
+void wfeFrameSetFence(wfeFrameAllocator *frames, wfeFrameFenceWait wait, wfeAny userdata) {
+    assert(frames != NULL /* frames should reference something */);
+    frames->wait = wait;
+    frames->userdata = userdata;
+}
+
+void wfeFrameBegin(wfeFrameAllocator *frames) {
+    wfeSize next;
+    assert(frames != NULL /* frames should reference something */);
+    assert(frames->count > 0 /* frames should be initialized */);
+
+    next = (frames->current + 1) % frames->count;
+
+    // Consumer might still be reading the oldest frame.
+    if (frames->fences[next] != NULL) {
+        if (frames->wait != NULL)
+            frames->wait(frames->fences[next], frames->userdata);
+
+        frames->fences[next] = NULL;
+    }
+
+    wfePoolRecycle(&frames->pools[next]);
+    frames->current = next;
+    frames->frame++;
+}
+
+void wfeFrameEnd(wfeFrameAllocator *frames, wfeAny fence) {
+    assert(frames != NULL /* frames should reference something */);
+    frames->fences[frames->current] = fence;
+}
+
+wfePool *wfeFramePool(wfeFrameAllocator *frames) {
+    assert(frames != NULL /* frames should reference something */);
+    return &frames->pools[frames->current];
+}
+
+wfeData *wfeFrameGet(wfeFrameAllocator *frames, wfeSize size, wfeSize align) {
+    assert(frames != NULL /* frames should reference something */);
+    return wfePoolGet(&frames->pools[frames->current], size, align);
+}
@@ -5,6 +5,8 @@
 #include <wfe/pool.h>
 #include <wfe/desc.h>
 #include <wfe/game.h>
+#include <wfe/frame.h>
+#include <wfe/trace.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
@@ -25,11 +27,18 @@ typedef struct wfeGame {
     GLFWwindow *window;
     wfeError lastError;
     wfePool miscPool;
+    wfeFrameAllocator frames;
 } wfeGame;
 
+// Timeout of each wait on a frame fence (nanoseconds)
+#define WFE_GAME_FENCE_TIMEOUT ((GLuint64) 1000000000)
+
 // Callback to handle framebuffer resizes (i.e. from window resize)
 void wfeHandleFramebufferResize(GLFWwindow *window, GLint width, GLint height);
 
+// Waits until GPU is done with a frame and releases its fence
+void wfeWaitFrameFence(wfeAny fence, wfeAny userdata);
+
 // Dumps description file into configuration
 wfeError wfeConfigureGame(wfeGameConfig *config, const wfeChar *cname, wfePool *pool);
 
@@ -50,6 +59,24 @@ wfeGame *wfeGameMake(wfeChar *cname, wfeAny context) {
         goto finalize;
     }
 
+    game->lastError = wfeFrameInit(&game->frames, WFE_GAME_FRAMES);
+    if (WFE_HAVE_FAILED(game->lastError)) {
+        goto finalize;
+    }
+
+    // Opt-in load tracing, written on finalize.
+    if (getenv("WFE_TRACE") != NULL) {
+        wfeTraceStart(WFE_TRACE_DEFAULT_EVENTS);
+    }
+
+    // Opt-in preload manifest: replays the last run and records this one for the next.
+    // Both are best effort, the first run has nothing to replay.
+    const wfeChar *manifest = getenv("WFE_ASSET_MANIFEST");
+    if (manifest != NULL && wfeAssetGetSearchPath() != NULL) {
+        wfeAssetManifestPrefetch(manifest);
+        wfeAssetManifestRecord(manifest);
+    }
+
     // Configure game
     wfeGameConfig config;
     game->lastError = wfeConfigureGame(&config, cname, &game->miscPool);
@@ -91,8 +118,16 @@ wfeGame *wfeGameMake(wfeChar *cname, wfeAny context) {
     // Default viewport
     glViewport(0, 0, config.width, config.height);
 
+    // Frame memory is released once GPU has consumed the frame.
+    wfeFrameSetFence(&game->frames, wfeWaitFrameFence, NULL);
+    wfeGameBeginFrame(game);
+
 finalize:
     if (WFE_HAS_FAILED(game->lastError)) {
+        wfeAssetManifestEndPrefetch(WFE_TRUE);
+        wfeAssetManifestFinish();
+        wfeTraceStop(getenv("WFE_TRACE"));
+        wfeFrameFinalize(&game->frames);
         if (game->window != NULL) {
             glfwDestroyWindow(game->window);
         }
@@ -106,6 +141,10 @@ finalize:
 
 void wfeGameFinalize(wfeGame *game) {
     assert(game != NULL /* A game should exists */);
+    wfeAssetManifestEndPrefetch(WFE_TRUE);
+    wfeAssetManifestFinish();
+    wfeTraceStop(getenv("WFE_TRACE"));
+    wfeFrameFinalize(&game->frames);
     if (game->window != NULL) {
         glfwDestroyWindow(game->window);
     }
@@ -127,6 +166,47 @@ wfeAny wfeGameGetContext(wfeGame *game) {
     return game->window;
 }
 
+void wfeGameBeginFrame(wfeGame *game) {
+    wfeFrameBegin(&game->frames);
+}
+
+void wfeGameEndFrame(wfeGame *game) {
+    GLsync fence = NULL;
+
+    // Fences require GLES 3.0, without them frames are considered consumed at swap.
+    if (glFenceSync != NULL) {
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    wfeFrameEnd(&game->frames, fence);
+}
+
+wfePool *wfeGameFramePool(wfeGame *game) {
+    return wfeFramePool(&game->frames);
+}
+
+wfeBool wfeGameStep(wfeGame *game) {
+    assert(game != NULL /* A game should exists */);
+
+    // Fence goes before the swap so it covers every command of the frame.
+    wfeGameEndFrame(game);
+    glfwSwapBuffers(game->window);
+    glfwPollEvents();
+    wfeGameBeginFrame(game);
+    return GL_FALSE == glfwWindowShouldClose(game->window);
+}
+
+void wfeWaitFrameFence(wfeAny fence, wfeAny userdata) {
+    GLsync sync = (GLsync) fence;
+    GLenum status = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, WFE_GAME_FENCE_TIMEOUT);
+    (void) userdata;
+    while (status == GL_TIMEOUT_EXPIRED) {
+        status = glClientWaitSync(sync, 0, WFE_GAME_FENCE_TIMEOUT);
+    }
+
+    glDeleteSync(sync);
+}
+
 wfeError wfeConfigureGame(wfeGameConfig *config, const wfeChar *cname, wfePool *pool) {
     wfeError code = WFE_SUCCESS;
     const wfeChar *kname = NULL;
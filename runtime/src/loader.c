@@ -0,0 +1,296 @@
+#include <wfe/loader.h>
+#include <wfe/asset.h>
+#include <wfe/pool.h>
+#include <string.h>
+#include <assert.h>
+
+// Ticket layout, slot on low half and generation of slot on high half.
+#define wfeLoaderTicketMake(slot, generation) (((wfeLoaderTicket) (generation) << 32) | (wfeLoaderTicket) (slot))
+#define wfeLoaderTicketSlot(ticket) ((wfeUint32) ((ticket) & 0xffffffff))
+#define wfeLoaderTicketGeneration(ticket) ((wfeUint32) ((ticket) >> 32))
+
+/**
+ * Reads status of a request, loader lock must be held.
+ *
+ * Params:
+ *  - loader of request.
+ *  - ticket of request.
+ * Returns:
+ *  - Same as wfeLoaderPoll.
+ */
+static wfeError wfeLoaderStatus(wfeLoader *loader, wfeLoaderTicket ticket) {
+    wfeLoaderRequest *request = &loader->requests[wfeLoaderTicketSlot(ticket)];
+    if (request->generation != wfeLoaderTicketGeneration(ticket) || request->state == WFE_LOADER_FREE)
+        return WFE_DONE;
+
+    return request->state == WFE_LOADER_DONE ? request->status : WFE_CONTINUE;
+}
+
+/**
+ * Body of worker threads, takes queued requests until loader stops.
+ *
+ * Params:
+ *  - arg worker running the loop.
+ * Returns:
+ *  - Zero always.
+ */
+static int wfeLoaderRun(void *arg) {
+    wfeLoaderWorker *worker = (wfeLoaderWorker *) arg;
+    wfeLoader *loader = worker->loader;
+    wfeLoaderRequest *request;
+    const wfeData *data;
+    wfeSize size, staged;
+    wfeError status;
+    wfeUint32 slot;
+
+    mtx_lock(&loader->lock);
+    for (;;) {
+        while (loader->queueCount == 0 && !loader->stop)
+            cnd_wait(&loader->wake, &loader->lock);
+
+        if (loader->stop)
+            break;
+
+        slot = loader->queue[loader->queueHead];
+        loader->queueHead = (loader->queueHead + 1) % WFE_LOADER_MAX_REQUESTS;
+        loader->queueCount--;
+        request = &loader->requests[slot];
+        request->state = WFE_LOADER_LOADING;
+        staged = worker->staged;
+        mtx_unlock(&loader->lock);
+
+        // Pump only reads the pool while data waits on it.
+        if (staged == 0)
+            wfePoolRecycle(&worker->pool);
+
+        // Read happens without the lock, request fields do not change until it is done.
+        data = NULL;
+        size = 0L;
+        status = wfeAssetLoadRaw(request->name, request->ext, &worker->pool, &data, &size);
+        if (WFE_HAVE_FAILED(status)) {
+            data = NULL;
+            size = 0L;
+        }
+
+        // Large objects are mapped for this file alone, anything else is copied by the pump.
+        staged = data != NULL && !wfePoolHandoffObject(&worker->pool, request->pool, (wfeData *) data);
+
+        mtx_lock(&loader->lock);
+        request->data = data;
+        request->size = size;
+        request->status = status;
+        request->worker = staged ? worker : NULL;
+        worker->staged += staged;
+        request->state = WFE_LOADER_DONE;
+        loader->done[(loader->doneHead + loader->doneCount) % WFE_LOADER_MAX_REQUESTS] = slot;
+        loader->doneCount++;
+        cnd_broadcast(&loader->finished);
+    }
+
+    mtx_unlock(&loader->lock);
+    return 0;
+}
+
+wfeError wfeLoaderInit(wfeLoader *loader, wfeSize count) {
+    wfeSize i;
+    assert(loader != NULL /* loader must not be null */);
+
+    if (count == 0 || count > WFE_LOADER_MAX_WORKERS)
+        return WFE_LOADER_INVALID_COUNT;
+
+    for (i = 0; i < WFE_LOADER_MAX_REQUESTS; i++) {
+        loader->requests[i].state = WFE_LOADER_FREE;
+        loader->requests[i].generation = 1;
+        loader->free[i] = (wfeUint32) (WFE_LOADER_MAX_REQUESTS - 1 - i);
+    }
+
+    loader->queueHead = 0;
+    loader->queueCount = 0;
+    loader->doneHead = 0;
+    loader->doneCount = 0;
+    loader->freeCount = WFE_LOADER_MAX_REQUESTS;
+    loader->count = 0;
+    loader->stop = WFE_FALSE;
+    wfePoolSharedInit(&loader->shared);
+
+    if (mtx_init(&loader->lock, mtx_plain) != thrd_success)
+        goto failed_lock;
+
+    if (cnd_init(&loader->wake) != thrd_success)
+        goto failed_wake;
+
+    if (cnd_init(&loader->finished) != thrd_success)
+        goto failed_finished;
+
+    for (i = 0; i < count; i++) {
+        wfeLoaderWorker *worker = &loader->workers[i];
+        worker->loader = loader;
+        worker->staged = 0;
+        wfePoolInitShared(&worker->pool, &loader->shared);
+        if (thrd_create(&worker->thread, wfeLoaderRun, worker) != thrd_success) {
+            wfePoolFinalize(&worker->pool);
+            wfeLoaderFinalize(loader);
+            return WFE_LOADER_THREAD_ERROR;
+        }
+
+        loader->count++;
+    }
+
+    return WFE_SUCCESS;
+
+failed_finished:
+    cnd_destroy(&loader->wake);
+failed_wake:
+    mtx_destroy(&loader->lock);
+failed_lock:
+    wfePoolSharedFinalize(&loader->shared);
+    return WFE_LOADER_THREAD_ERROR;
+}
+
+void wfeLoaderFinalize(wfeLoader *loader) {
+    wfeSize i;
+    assert(loader != NULL /* loader must not be null */);
+
+    mtx_lock(&loader->lock);
+    loader->stop = WFE_TRUE;
+    cnd_broadcast(&loader->wake);
+    mtx_unlock(&loader->lock);
+
+    for (i = 0; i < loader->count; i++) {
+        thrd_join(loader->workers[i].thread, NULL);
+        wfePoolFinalize(&loader->workers[i].pool);
+    }
+
+    loader->count = 0;
+    cnd_destroy(&loader->finished);
+    cnd_destroy(&loader->wake);
+    mtx_destroy(&loader->lock);
+    wfePoolSharedFinalize(&loader->shared);
+}
+
+wfeError wfeLoaderSubmit(wfeLoader *loader, const wfeChar *name, const wfeChar *ext, wfePool *pool,
+                         wfeLoaderCallback callback, wfeAny userdata, wfeLoaderTicket *ticket) {
+    wfeLoaderRequest *request;
+    wfeUint32 slot;
+    assert(loader != NULL /* loader must not be null */);
+    assert(name != NULL /* name should exists */);
+    assert(ext != NULL /* ext should exists */);
+    assert(pool != NULL /* pool must not be null */);
+    assert(ticket != NULL /* ticket should reference something */);
+
+    *ticket = 0;
+    mtx_lock(&loader->lock);
+    if (loader->freeCount == 0) {
+        mtx_unlock(&loader->lock);
+        return WFE_LOADER_FULL;
+    }
+
+    slot = loader->free[--loader->freeCount];
+    request = &loader->requests[slot];
+    request->name = name;
+    request->ext = ext;
+    request->pool = pool;
+    request->callback = callback;
+    request->userdata = userdata;
+    request->data = NULL;
+    request->size = 0L;
+    request->status = WFE_SUCCESS;
+    request->worker = NULL;
+    request->state = WFE_LOADER_QUEUED;
+
+    loader->queue[(loader->queueHead + loader->queueCount) % WFE_LOADER_MAX_REQUESTS] = slot;
+    loader->queueCount++;
+    *ticket = wfeLoaderTicketMake(slot, request->generation);
+    cnd_signal(&loader->wake);
+    mtx_unlock(&loader->lock);
+    return WFE_SUCCESS;
+}
+
+wfeError wfeLoaderPoll(wfeLoader *loader, wfeLoaderTicket ticket) {
+    wfeError status;
+    assert(loader != NULL /* loader must not be null */);
+    assert(wfeLoaderTicketSlot(ticket) < WFE_LOADER_MAX_REQUESTS /* ticket must come from submit */);
+
+    mtx_lock(&loader->lock);
+    status = wfeLoaderStatus(loader, ticket);
+    mtx_unlock(&loader->lock);
+    return status;
+}
+
+wfeError wfeLoaderWait(wfeLoader *loader, wfeLoaderTicket ticket) {
+    wfeError status;
+    assert(loader != NULL /* loader must not be null */);
+    assert(wfeLoaderTicketSlot(ticket) < WFE_LOADER_MAX_REQUESTS /* ticket must come from submit */);
+
+    mtx_lock(&loader->lock);
+    status = wfeLoaderStatus(loader, ticket);
+    while (WFE_SHOULD_CONTINUE(status)) {
+        cnd_wait(&loader->finished, &loader->lock);
+        status = wfeLoaderStatus(loader, ticket);
+    }
+
+    mtx_unlock(&loader->lock);
+    return status;
+}
+
+wfeSize wfeLoaderPump(wfeLoader *loader, wfeSize max) {
+    wfeLoaderRequest *request;
+    wfeLoaderWorker *worker;
+    wfeLoaderCallback callback;
+    wfeLoaderTicket ticket;
+    const wfeData *data;
+    wfeData *copy;
+    wfePool *pool;
+    wfeAny userdata;
+    wfeError status;
+    wfeSize size, delivered = 0;
+    wfeUint32 slot;
+    assert(loader != NULL /* loader must not be null */);
+
+    mtx_lock(&loader->lock);
+    while (loader->doneCount > 0 && (max == 0 || delivered < max)) {
+        slot = loader->done[loader->doneHead];
+        loader->doneHead = (loader->doneHead + 1) % WFE_LOADER_MAX_REQUESTS;
+        loader->doneCount--;
+
+        request = &loader->requests[slot];
+        ticket = wfeLoaderTicketMake(slot, request->generation);
+        callback = request->callback;
+        userdata = request->userdata;
+        data = request->data;
+        size = request->size;
+        status = request->status;
+        worker = request->worker;
+        pool = request->pool;
+
+        // Slot is released before the callback, so callbacks can queue new requests.
+        request->state = WFE_LOADER_FREE;
+        request->generation = request->generation + 1 != 0 ? request->generation + 1 : 1;
+        loader->free[loader->freeCount++] = slot;
+        mtx_unlock(&loader->lock);
+
+        // Data waiting on a worker pool is copied, worker does not recycle until it is released.
+        if (worker != NULL) {
+            copy = size > 0 ? wfePoolGet(pool, size, wfeAlignOf(char)) : NULL;
+            if (copy != NULL)
+                memcpy(copy, data, size);
+            else if (size > 0)
+                status = pool->lastError;
+
+            data = copy;
+            size = copy != NULL ? size : 0L;
+            mtx_lock(&loader->lock);
+            worker->staged--;
+            mtx_unlock(&loader->lock);
+        }
+
+        if (callback != NULL)
+            callback(ticket, status, data, size, userdata);
+
+        delivered++;
+        mtx_lock(&loader->lock);
+    }
+
+    mtx_unlock(&loader->lock);
+    return delivered;
+}
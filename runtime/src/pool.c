@@ -1,16 +1,80 @@
 #include <wfe/pool.h>
 #include <wfe/types.h>
+#include <wfe/vmem.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
+#ifdef WFE_POOL_STATS
+#define wfePoolStatsAdd(tier, member, value) ((tier)->stats.member += (value))
+#define wfePoolStatsUsed(tier, value) wfePoolStatsUse(&(tier)->stats, (tier)->usage, (tier)->stats.used + (value))
+
+/**
+ * Sets the used bytes of a tier or of large objects, following the change on the usage
+ * of their pool.
+ *
+ * Params:
+ *  - stats of tier or large objects.
+ *  - usage of pool, might be NULL.
+ *  - used bytes from now on.
+ */
+static inline void wfePoolStatsUse(wfePoolTierStats *stats, wfePoolUsage *usage, wfeSize used) {
+    if (usage != NULL) {
+        usage->used = usage->used - stats->used + used;
+        if (usage->used > usage->peak)
+            usage->peak = usage->used;
+    }
+
+    stats->used = used;
+    if (stats->used > stats->peak)
+        stats->peak = stats->used;
+}
+#else
+#define wfePoolStatsAdd(tier, member, value)
+#define wfePoolStatsUsed(tier, value)
+#endif
+
+/**
+ * Accounts a request served by a tier.
+ *
+ * Params:
+ *  - tier that served the request.
+ *  - requested bytes by caller.
+ *  - served bytes taken from blocks.
+ */
+static inline void wfePoolStatsRequest(wfePoolTier *tier, wfeSize requested, wfeSize served) {
+#ifdef WFE_POOL_STATS
+    wfeSize cls = wfePoolSizeClass(requested);
+    tier->stats.requests++;
+    tier->stats.requested += requested;
+    tier->stats.served += served;
+    tier->stats.histogram[cls < WFE_POOL_CLASSES ? cls : WFE_POOL_CLASSES-1]++;
+    wfePoolStatsUse(&tier->stats, tier->usage, tier->stats.used + served);
+#else
+    (void) tier; (void) requested; (void) served;
+#endif
+}
+
 wfeError wfePoolBlockInit(wfePoolBlock *block, wfeSize size) {
+    return wfePoolBlockInitBackend(block, size, WFE_POOL_BACKEND_HEAP);
+}
+
+wfeError wfePoolBlockInitBackend(wfePoolBlock *block, wfeSize size, wfeUint32 backend) {
     wfeData *mem = NULL;
     assert(block != NULL /* block should not be null */);
     assert(size > 0 /* size should be at least 1 */);
 
-    // Allocate and empty memory for block.
-    // TODESIGN: Is a good idea to include a memory profile?
-    mem = calloc(1, size);
+    // Allocate and empty memory for block, mapped memory is already zero.
+    if ((backend & WFE_POOL_BACKEND_MASK) == WFE_POOL_BACKEND_MMAP) {
+        mem = wfeVmemMap(size, (backend & WFE_POOL_BACKEND_HUGE_PAGES) != 0 ? WFE_VMEM_HUGE_PAGES : 0);
+    } else if ((backend & WFE_POOL_BACKEND_MASK) == WFE_POOL_BACKEND_ARENA) {
+        mem = wfeVmemReserve(size);
+    } else {
+        mem = calloc(1, size);
+    }
+
     if (mem == NULL)
         return WFE_POOL_OMEM_CHUNK;
 
@@ -19,6 +83,9 @@ wfeError wfePoolBlockInit(wfePoolBlock *block, wfeSize size) {
     block->head = mem;
     block->next = NULL;
     block->end = mem+size;
+    block->backend = backend;
+    block->resident = WFE_FALSE;
+    block->committed = (backend & WFE_POOL_BACKEND_MASK) == WFE_POOL_BACKEND_ARENA ? mem : block->end;
     return WFE_SUCCESS;
 }
 
@@ -27,7 +94,11 @@ void wfePoolBlockFinalize(wfePoolBlock *block) {
 
     // Free memory only if it haven't been released yet.
     if (block->start != NULL){
-        free(block->start);
+        if ((block->backend & WFE_POOL_BACKEND_MASK) != WFE_POOL_BACKEND_HEAP) {
+            wfeVmemUnmap(block->start, block->end - block->start);
+        } else {
+            free(block->start);
+        }
     }
 
     block->next = NULL;
@@ -36,6 +107,34 @@ void wfePoolBlockFinalize(wfePoolBlock *block) {
     block->end = NULL;
 }
 
+/**
+ * Commits pages of an arena block up to the given address, in steps of at least
+ * WFE_POOL_ARENA_COMMIT bytes to keep system calls few.
+ *
+ * Params:
+ *  - block to commit.
+ *  - until address, within block.
+ * Returns:
+ *  - WFE_TRUE if pages up to address are ready to be used.
+ */
+static wfeBool wfePoolBlockCommit(wfePoolBlock *block, wfeData *until) {
+    wfeSize page = wfeVmemPageSize(), grow;
+
+    if (until <= block->committed)
+        return WFE_TRUE;
+
+    grow = (until - block->committed + page - 1) & ~(page - 1);
+    grow = grow > WFE_POOL_ARENA_COMMIT ? grow : WFE_POOL_ARENA_COMMIT;
+    if (grow > (wfeSize) (block->end - block->committed))
+        grow = block->end - block->committed;
+
+    if (!wfeVmemCommit(block->committed, grow))
+        return WFE_FALSE;
+
+    block->committed += grow;
+    return WFE_TRUE;
+}
+
 wfeSize wfePoolBlockAvailable(wfePoolBlock *block) {
     assert(block != NULL /* block should not be null */);
     return block->end - block->head;
@@ -47,13 +146,49 @@ wfeSize wfePoolBlockTotalSize(wfePoolBlock *block) {
 }
 
 wfeError wfePoolTierInit(wfePoolTier *tier, wfeSize size) {
-    wfeError status = WFE_SUCCESS;
-    assert(tier != NULL /* block should not be null */);
-    assert(size > 0 /* size should be at least 1 */);
+    return wfePoolTierInitBackend(tier, size, WFE_POOL_BACKEND_HEAP);
+}
 
+/**
+ * Sets default state for tier members, without any block.
+ *
+ * Params:
+ *  - tier to reset.
+ *  - size of each block on tier.
+ *  - backend WFE_POOL_BACKEND_* and options.
+ */
+static void wfePoolTierReset(wfePoolTier *tier, wfeSize size, wfeUint32 backend) {
     tier->first = NULL;
     tier->current = NULL;
     tier->size = size;
+    tier->backend = backend;
+    tier->slot = 0;
+    tier->freeList = NULL;
+    tier->freeCount = 0;
+    tier->freeFloor = 0;
+    tier->live = 0;
+    tier->reused = 0;
+    tier->last = NULL;
+    tier->shared = NULL;
+    tier->parent = NULL;
+    tier->index = WFE_POOL_TIERS;
+    tier->trim = WFE_POOL_TRIM_NONE;
+    tier->trimLimit = 0;
+    tier->cycles = 0;
+    memset(tier->history, 0, sizeof(tier->history));
+#ifdef WFE_POOL_STATS
+    memset(&tier->stats, 0, sizeof(wfePoolTierStats));
+    tier->stats.blocks = 1;
+    tier->usage = NULL;
+#endif
+}
+
+wfeError wfePoolTierInitBackend(wfePoolTier *tier, wfeSize size, wfeUint32 backend) {
+    wfeError status = WFE_SUCCESS;
+    assert(tier != NULL /* block should not be null */);
+    assert(size > 0 /* size should be at least 1 */);
+
+    wfePoolTierReset(tier, size, backend);
 
     // Expand chain to first chunk.
     tier->first = malloc(sizeof(wfePoolBlock));
@@ -62,12 +197,15 @@ wfeError wfePoolTierInit(wfePoolTier *tier, wfeSize size) {
     }
 
     // Initialize first chunk and point current to first.
-    status = wfePoolBlockInit(tier->first, size);
+    status = wfePoolBlockInitBackend(tier->first, size, backend);
     tier->current = tier->first;
+    tier->current->resident = WFE_TRUE;
 
 finalize:
     if (WFE_HAS_FAILED(status) && tier->first != NULL) {
         free(tier->first);
+        tier->first = NULL;
+        tier->current = NULL;
     }
 
     return status;
@@ -115,20 +253,135 @@ wfeSize wfePoolTierTotalSize(wfePoolTier *tier) {
     return len;
 }
 
+/**
+ * Leases the next unreached block of a tier of a parent pool.
+ *
+ * Params:
+ *  - parent pool.
+ *  - index of tier.
+ *  - size of wanted block.
+ * Returns:
+ *  - NULL if parent tier has no unreached block of that size.
+ *  - A block out of any chain.
+ */
+static wfePoolBlock *wfePoolLease(wfePool *parent, wfeSize index, wfeSize size) {
+    wfePoolTier *tier = parent->tiers[index];
+    wfePoolBlock *block;
+
+    if (tier == NULL || tier->current->next == NULL || wfePoolBlockTotalSize(tier->current->next) != size)
+        return NULL;
+
+    block = tier->current->next;
+    tier->current->next = block->next;
+    block->next = NULL;
+    block->head = block->start;
+    wfePoolStatsAdd(tier, blocks, -1);
+    return block;
+}
+
+/**
+ * Takes a spare block for a tier, from its parent pool first and then from its store.
+ *
+ * Params:
+ *  - tier that needs a block.
+ * Returns:
+ *  - NULL if there is no spare block, a block out of any chain otherwise.
+ */
+static wfePoolBlock *wfePoolTierSpare(wfePoolTier *tier) {
+    wfePoolBlock *block = NULL;
+
+    if (tier->parent != NULL)
+        block = wfePoolLease(tier->parent, tier->index, tier->size);
+
+    if (block == NULL && tier->shared != NULL)
+        block = wfePoolSharedTake(tier->shared, tier->size);
+
+    return block;
+}
+
+/**
+ * Calculates the alignment every block of a backend starts with.
+ *
+ * Params:
+ *  - backend of block.
+ * Returns:
+ *  - Page size for mapped blocks, malloc alignment otherwise.
+ */
+static inline wfeSize wfePoolBlockBase(wfeUint32 backend) {
+    return (backend & WFE_POOL_BACKEND_MASK) == WFE_POOL_BACKEND_MMAP ? wfeVmemPageSize() : wfeAlignOf(max_align_t);
+}
+
+/**
+ * Calculates the worst padding needed to align a request at the start of a new block.
+ *
+ * Params:
+ *  - backend of block.
+ *  - align of request.
+ * Returns:
+ *  - Zero if blocks already start aligned, align-1 otherwise.
+ */
+static inline wfeSize wfePoolBlockSlack(wfeUint32 backend, wfeSize align) {
+    return align > wfePoolBlockBase(backend) ? align - 1 : 0;
+}
+
+/**
+ * Calculates the alignment every slot of a slab tier gets without padding: the lowest
+ * power of two of the slot size, or the block alignment for a lonely slot.
+ *
+ * Params:
+ *  - tier on slab mode.
+ * Returns:
+ *  - Biggest align a slot honors.
+ */
+static inline wfeSize wfePoolSlotAlign(wfePoolTier *tier) {
+    wfeSize base = wfePoolBlockBase(tier->backend), low = tier->slot & (~tier->slot + 1);
+    return tier->size == tier->slot || low > base ? base : low;
+}
+
 wfeData *wfePoolTierGet(wfePoolTier *tier, wfeSize size, wfeSize align) {
     wfePoolBlock *tmp = NULL;
     wfeData *ptr = NULL;
     wfeError res = WFE_SUCCESS;
+    wfeSize requested = size, pad = 0, slack;
     assert(tier != NULL /* tier must not be null */);
     assert(size > 0 /* Size must be at least 1 */);
+    assert(align > 0 && (align & (align - 1)) == 0 /* align must be a power of two */);
+
+    if (tier->slot != 0) {
+        // Slab mode: requests must fit a slot, slots are never padded to keep their stride.
+        assert(align <= wfePoolSlotAlign(tier) /* slots are not aligned that far */);
+        if (size > tier->slot)
+            return NULL;
 
-    // Align memory to prevent hardware exceptions or slowness
-    size = wfePoolMemoryAlign(size, align);
+        // Re-use released slots first, otherwise take a whole slot.
+        if (tier->freeList != NULL) {
+            ptr = tier->freeList;
+            tier->freeList = *((wfeData **) ptr);
+            tier->freeCount--;
+            if (tier->freeCount < tier->freeFloor)
+                tier->freeFloor = tier->freeCount;
+
+            tier->reused++;
+            tier->live++;
+            wfePoolStatsRequest(tier, requested, tier->slot);
+            return ptr;
+        }
 
-    // Allocate a bigger chunk if required size is major than current chunksize
-    if (size > tier->size) {
+        size = tier->slot;
+        align = 1;
+    } else {
+        // Keep size a multiple of align so arrays of the same type stay aligned.
+        size = wfePoolMemoryAlign(size, align);
+    }
+
+    // Allocate a bigger chunk if required size (plus worst padding) is major than current chunksize
+    slack = wfePoolBlockSlack(tier->backend, align);
+    if (size + slack > tier->size) {
         tmp = malloc(sizeof(wfePoolBlock));
-        res = wfePoolBlockInit(tmp, size);
+        if (tmp == NULL)
+            return NULL;
+
+        res = wfePoolBlockInitBackend(tmp, size + slack, tier->backend);
         if (WFE_HAS_FAILED(res)) {
             if (tmp != NULL) {
                 free(tmp);
@@ -142,103 +395,868 @@ wfeData *wfePoolTierGet(wfePoolTier *tier, wfeSize size, wfeSize align) {
             tmp->next = tier->current->next;
         }
 
-        // Insert block on the chain.
+        // Insert block on the chain, the rest of current block is lost until recycle.
+        wfePoolStatsAdd(tier, tailWaste, tier->current->end - tier->current->head);
+        wfePoolStatsUsed(tier, tier->current->end - tier->current->head);
+        wfePoolStatsAdd(tier, blocks, 1);
         tier->current->next = tmp;
         tier->current = tmp;
     }
 
-    tmp = tier->current;
-    ptr = tmp->head; // Usable memory
-    tmp->head += size; // Move head to next block.
+    // Blocks are not aligned beyond malloc alignment (or page on mmap), pad the pointer itself.
+    pad = wfePoolMemoryAlign((wfeSize) tier->current->head, align) - (wfeSize) tier->current->head;
 
-    // Check if current block is exhausted.
-    if (tmp->head >= tmp->end) {
+    // Check if current block is exhausted. Re-used and spare blocks might start less aligned
+    // than a new one (other backend or slack), keep moving until the padded request fits.
+    while (tier->current->head + pad + size > tier->current->end) {
+        tmp = tier->current;
+        wfePoolStatsAdd(tier, tailWaste, tmp->end - tmp->head);
+        wfePoolStatsUsed(tier, tmp->end - tmp->head);
 
         // Is the current next block already allocated?
         if (tmp->next != NULL){
             // Re-use block.
             tmp->next->head = tmp->next->start;
             tier->current = tmp->next;
+        } else if ((tmp->next = wfePoolTierSpare(tier)) != NULL) {
+            // Otherwise take a spare block of the parent or the store.
+            wfePoolStatsAdd(tier, blocks, 1);
+            tier->current = tmp->next;
         } else {
-            // Otherwise extend tier with new block
+            // Or extend tier with new block of the tier size.
             tmp->next = malloc(sizeof(wfePoolBlock));
-            res = wfePoolBlockInit(tmp->next, size);
+            if (tmp->next == NULL)
+                return NULL;
+
+            res = wfePoolBlockInitBackend(tmp->next, tier->size, tier->backend);
             if (WFE_HAS_FAILED(res)) {
                 if (tmp->next != NULL) {
                     free(tmp->next);
+                    tmp->next = NULL;
                 }
 
                 return NULL;
             }
 
+            wfePoolStatsAdd(tier, blocks, 1);
             tier->current = tmp->next;
         }
 
-        // Set ptr to the first location in the new block
-        ptr = tier->current->head;
-        tier->current->head += size;
+        pad = wfePoolMemoryAlign((wfeSize) tier->current->head, align) - (wfeSize) tier->current->head;
     }
 
+    ptr = tier->current->head + pad; // Usable memory
+    if (ptr + size > tier->current->committed && !wfePoolBlockCommit(tier->current, ptr + size))
+        return NULL;
+
+    tier->current->head = ptr + size; // Move head to next block.
+    tier->last = ptr;
+    tier->current->resident = WFE_TRUE;
+    if (tier->slot != 0)
+        tier->live++;
+
+    wfePoolStatsRequest(tier, requested, pad + size);
     return ptr;
 }
 
+void wfePoolTierFree(wfePoolTier *tier, wfeData *ptr) {
+    assert(tier != NULL /* tier must not be null */);
+    assert(tier->slot != 0 /* only slab tiers release single objects */);
+    assert(tier->live > 0 /* released more objects than requested */);
+
+    if (ptr == NULL)
+        return;
+
+    // Released slot stores the link to the next free slot.
+    *((wfeData **) ptr) = tier->freeList;
+    tier->freeList = ptr;
+    tier->freeCount++;
+    tier->live--;
+    wfePoolStatsUsed(tier, -tier->slot);
+}
+
+void wfePoolTierOccupancy(wfePoolTier *tier, wfePoolOccupancy *occupancy) {
+    assert(tier != NULL /* tier must not be null */);
+    assert(occupancy != NULL /* occupancy must reference something */);
+
+    occupancy->capacity = tier->slot != 0 ? wfePoolTierTotalSize(tier) / tier->slot : 0;
+    occupancy->live = tier->live;
+    occupancy->free = tier->freeCount;
+    occupancy->reused = tier->reused;
+}
+
+/**
+ * Gives a block back to a store, or releases it if there is no store or it does not fit.
+ *
+ * Params:
+ *  - shared store, might be NULL.
+ *  - block out of any chain.
+ */
+static void wfePoolBlockRelease(wfePoolShared *shared, wfePoolBlock *block) {
+    if (shared != NULL && wfePoolSharedGive(shared, block))
+        return;
+
+    wfePoolBlockFinalize(block);
+    free(block); // Release the header.
+}
+
+/**
+ * Releases the tail of the block chain that does not fit in the trim policy of the tier.
+ *
+ * Params:
+ *  - tier to trim, already rewound to its first block.
+ *  - footprint bytes of blocks reached since the previous recycle.
+ */
+static void wfePoolTierTrim(wfePoolTier *tier, wfeSize footprint) {
+    wfePoolBlock *cur, *tmp;
+    wfeSize i, window, kept, count, budget = 0;
+
+    tier->history[tier->cycles % WFE_POOL_TRIM_HISTORY] = footprint;
+    tier->cycles++;
+
+    switch (tier->trim) {
+    case WFE_POOL_TRIM_BLOCKS:
+    case WFE_POOL_TRIM_BYTES:
+        budget = tier->trimLimit;
+        break;
+    case WFE_POOL_TRIM_DECAY:
+        // Biggest footprint of the window, older entries than the window are ignored.
+        window = tier->trimLimit < WFE_POOL_TRIM_HISTORY ? tier->trimLimit : WFE_POOL_TRIM_HISTORY;
+        window = window < tier->cycles ? window : tier->cycles;
+        for (i = 1; i <= window; i++) {
+            kept = tier->history[(tier->cycles - i) % WFE_POOL_TRIM_HISTORY];
+            budget = kept > budget ? kept : budget;
+        }
+        break;
+    default:
+        return;
+    }
+
+    // First block is always kept, then keep going while the next block fits.
+    cur = tier->first;
+    kept = wfePoolBlockTotalSize(cur);
+    count = 1;
+    while (cur->next != NULL) {
+        if (tier->trim == WFE_POOL_TRIM_BLOCKS ? count >= budget : kept + wfePoolBlockTotalSize(cur->next) > budget)
+            break;
+
+        cur = cur->next;
+        kept += wfePoolBlockTotalSize(cur);
+        count++;
+    }
+
+    tmp = cur->next;
+    cur->next = NULL;
+    while (tmp != NULL) {
+        cur = tmp->next;
+        tmp->next = NULL;
+        wfePoolBlockRelease(tier->shared, tmp);
+        wfePoolStatsAdd(tier, blocks, -1);
+        tmp = cur;
+    }
+}
+
 void wfePoolTierRecycle(wfePoolTier *tier) {
+    wfePoolBlock *cur = NULL;
+    wfeSize footprint = 0;
     assert(tier != NULL /* tier must not be null */);
+
+    for (cur = tier->first; cur != tier->current; cur = cur->next)
+        footprint += wfePoolBlockTotalSize(cur);
+
+    footprint += wfePoolBlockTotalSize(tier->current);
+
+    // Blocks after current were not needed since the previous recycle, give their pages back.
+    for (cur = tier->current->next; cur != NULL; cur = cur->next) {
+        if (cur->resident && (cur->backend & WFE_POOL_BACKEND_MASK) == WFE_POOL_BACKEND_MMAP) {
+            wfeVmemDiscard(cur->start, cur->end - cur->start);
+            cur->resident = WFE_FALSE;
+        }
+    }
+
     tier->current = tier->first;
+    tier->last = NULL;
+    wfePoolTierTrim(tier, footprint);
     tier->current->head = tier->current->start;
+    tier->freeList = NULL;
+    tier->freeCount = 0;
+    tier->freeFloor = 0;
+    tier->live = 0;
+    wfePoolStatsAdd(tier, recycles, 1);
+#ifdef WFE_POOL_STATS
+    wfePoolStatsUse(&tier->stats, tier->usage, 0);
+#endif
+}
+
+void wfePoolTierSetTrim(wfePoolTier *tier, wfeUint32 trim, wfeSize limit) {
+    assert(tier != NULL /* tier must not be null */);
+    assert(trim <= WFE_POOL_TRIM_DECAY /* unknown trim policy */);
+    tier->trim = trim;
+    tier->trimLimit = limit;
+}
+
+#define WFE_POOL_OBJECT_MAGIC ((wfeSize) 0x5746454f424a4543) // Marks the serial of a live object
+
+/**
+ * Calculates the cache bucket of a mapping size.
+ *
+ * Params:
+ *  - size of mapping, multiple of page size.
+ * Returns:
+ *  - Size class of the count of pages.
+ */
+static inline wfeSize wfePoolObjectBucket(wfeSize size) {
+    wfeSize cls = wfePoolSizeClass(size / wfeVmemPageSize());
+    return cls < WFE_POOL_CLASSES ? cls : WFE_POOL_CLASSES - 1;
+}
+
+/**
+ * Removes a mapping from the cache.
+ *
+ * Params:
+ *  - objects allocator.
+ *  - object cached on allocator.
+ */
+static void wfePoolObjectsUncache(wfePoolObjects *objects, wfePoolObject *object) {
+    wfeSize bucket = wfePoolObjectBucket(object->size);
+
+    if (object->prev != NULL)
+        object->prev->next = object->next;
+    else
+        objects->cache[bucket] = object->next;
+
+    if (object->next != NULL)
+        object->next->prev = object->prev;
+
+    if (object->older != NULL)
+        object->older->newer = object->newer;
+    else
+        objects->oldest = object->newer;
+
+    if (object->newer != NULL)
+        object->newer->older = object->older;
+    else
+        objects->newest = object->older;
+
+    objects->cacheSize -= object->size;
+}
+
+/**
+ * Caches a released mapping, unmapping the oldest ones beyond the cache limit.
+ *
+ * Params:
+ *  - objects allocator.
+ *  - object already removed from live list.
+ */
+static void wfePoolObjectsCache(wfePoolObjects *objects, wfePoolObject *object) {
+    wfeSize bucket, page = wfeVmemPageSize();
+
+    // Huge pages are not discarded below their size, they would keep stale data.
+    if (object->size > objects->cacheLimit || (objects->backend & WFE_POOL_BACKEND_HUGE_PAGES) != 0) {
+        wfeVmemUnmap((wfeData *) object, object->size);
+        return;
+    }
+
+    // Keep only the header page resident, following requests read zero anyways.
+    object->serial = 0;
+    memset((wfeData *) object + WFE_POOL_OBJECT_HEADER, 0, page - WFE_POOL_OBJECT_HEADER);
+    wfeVmemDiscard((wfeData *) object + page, object->size - page);
+
+    bucket = wfePoolObjectBucket(object->size);
+    object->prev = NULL;
+    object->next = objects->cache[bucket];
+    if (object->next != NULL)
+        object->next->prev = object;
+    objects->cache[bucket] = object;
+
+    object->newer = NULL;
+    object->older = objects->newest;
+    if (object->older != NULL)
+        object->older->newer = object;
+    else
+        objects->oldest = object;
+    objects->newest = object;
+    objects->cacheSize += object->size;
+
+    while (objects->cacheSize > objects->cacheLimit) {
+        object = objects->oldest;
+        wfePoolObjectsUncache(objects, object);
+        wfeVmemUnmap((wfeData *) object, object->size);
+    }
+}
+
+void wfePoolObjectsInit(wfePoolObjects *objects, wfeSize cacheLimit, wfeUint32 backend) {
+    wfeSize i;
+    assert(objects != NULL /* objects must not be null */);
+
+    objects->live = NULL;
+    for (i = 0; i < WFE_POOL_CLASSES; i++)
+        objects->cache[i] = NULL;
+
+    objects->oldest = NULL;
+    objects->newest = NULL;
+    objects->liveSize = 0;
+    objects->cacheSize = 0;
+    objects->cacheLimit = cacheLimit;
+    objects->serial = 1;
+    objects->backend = backend;
+#ifdef WFE_POOL_STATS
+    memset(&objects->stats, 0, sizeof(wfePoolTierStats));
+    objects->usage = NULL;
+#endif
+}
+
+void wfePoolObjectsFinalize(wfePoolObjects *objects) {
+    wfePoolObject *tmp;
+    assert(objects != NULL /* objects must not be null */);
+
+    while (objects->live != NULL) {
+        tmp = objects->live;
+        objects->live = tmp->next;
+        wfeVmemUnmap((wfeData *) tmp, tmp->size);
+    }
+
+    while (objects->oldest != NULL) {
+        tmp = objects->oldest;
+        wfePoolObjectsUncache(objects, tmp);
+        wfeVmemUnmap((wfeData *) tmp, tmp->size);
+    }
+
+    objects->liveSize = 0;
+}
+
+wfeData *wfePoolObjectsGet(wfePoolObjects *objects, wfeSize size, wfeSize align) {
+    wfePoolObject *object = NULL, *cur;
+    wfeSize page = wfeVmemPageSize(), bucket, mapped;
+    wfeSize offset = align > WFE_POOL_OBJECT_HEADER ? align : WFE_POOL_OBJECT_HEADER;
+    assert(objects != NULL /* objects must not be null */);
+    assert(align <= page /* large objects are aligned up to a page */);
+
+    mapped = (size + offset + page - 1) & ~(page - 1);
+
+    // Same bucket might hold smaller mappings, every mapping of next bucket is big enough.
+    bucket = wfePoolObjectBucket(mapped);
+    for (cur = objects->cache[bucket]; cur != NULL && object == NULL; cur = cur->next) {
+        if (cur->size >= mapped)
+            object = cur;
+    }
+
+    if (object == NULL && bucket + 1 < WFE_POOL_CLASSES)
+        object = objects->cache[bucket + 1];
+
+    if (object != NULL) {
+        wfePoolObjectsUncache(objects, object);
+    } else {
+        object = (wfePoolObject *) wfeVmemMap(mapped, (objects->backend & WFE_POOL_BACKEND_HUGE_PAGES) != 0 ? WFE_VMEM_HUGE_PAGES : 0);
+        if (object == NULL)
+            return NULL;
+
+        object->size = mapped;
+        object->owner = objects;
+    }
+
+    object->serial = objects->serial++ ^ WFE_POOL_OBJECT_MAGIC;
+    object->offset = offset;
+    object->older = NULL;
+    object->newer = NULL;
+    object->prev = NULL;
+    object->next = objects->live;
+    if (object->next != NULL)
+        object->next->prev = object;
+    objects->live = object;
+    objects->liveSize += object->size;
+
+#ifdef WFE_POOL_STATS
+    bucket = wfePoolSizeClass(size);
+    objects->stats.requests++;
+    objects->stats.requested += size;
+    objects->stats.served += object->size;
+    objects->stats.histogram[bucket < WFE_POOL_CLASSES ? bucket : WFE_POOL_CLASSES-1]++;
+    wfePoolStatsUse(&objects->stats, objects->usage, objects->liveSize);
+#endif
+    return (wfeData *) object + offset;
+}
+
+/**
+ * Finds the header of a live object.
+ *
+ * Params:
+ *  - objects allocator.
+ *  - ptr returned by any pool function.
+ * Returns:
+ *  - Header of object, NULL if ptr is not a live object of the allocator.
+ */
+static wfePoolObject *wfePoolObjectsFind(wfePoolObjects *objects, wfeData *ptr) {
+    wfePoolObject *object;
+
+    if (ptr == NULL)
+        return NULL;
+
+    // Memory before ptr might not be mapped (e.g. tier blocks), only headers on the live list are read.
+    for (object = objects->live; object != NULL; object = object->next) {
+        if ((wfeData *) object + object->offset == ptr)
+            return object;
+    }
+
+    return NULL;
+}
+
+/**
+ * Moves a live object to the cache.
+ *
+ * Params:
+ *  - objects allocator.
+ *  - object live on allocator.
+ */
+static void wfePoolObjectsRelease(wfePoolObjects *objects, wfePoolObject *object) {
+    if (object->prev != NULL)
+        object->prev->next = object->next;
+    else
+        objects->live = object->next;
+
+    if (object->next != NULL)
+        object->next->prev = object->prev;
+
+    objects->liveSize -= object->size;
+#ifdef WFE_POOL_STATS
+    wfePoolStatsUse(&objects->stats, objects->usage, objects->liveSize);
+#endif
+    wfePoolObjectsCache(objects, object);
+}
+
+wfeBool wfePoolObjectsOwns(wfePoolObjects *objects, wfeData *ptr) {
+    assert(objects != NULL /* objects must not be null */);
+    return wfePoolObjectsFind(objects, ptr) != NULL;
+}
+
+void wfePoolObjectsFree(wfePoolObjects *objects, wfeData *ptr) {
+    wfePoolObject *object = wfePoolObjectsFind(objects, ptr);
+    assert(objects != NULL /* objects must not be null */);
+    assert(object != NULL /* ptr is not a live object of allocator */);
+
+    wfePoolObjectsRelease(objects, object);
+}
+
+void wfePoolObjectsRecycle(wfePoolObjects *objects) {
+    assert(objects != NULL /* objects must not be null */);
+
+    while (objects->live != NULL)
+        wfePoolObjectsRelease(objects, objects->live);
+
+#ifdef WFE_POOL_STATS
+    objects->stats.recycles++;
+#endif
+}
+
+// Size of the blocks of each tier, custom requests are large objects and do not use it.
+static const wfeSize wfePoolTierSizes[WFE_POOL_TIERS] = {
+    WFE_POOL_TINY,
+    WFE_POOL_SMALL,
+    WFE_POOL_MEDIUM,
+    WFE_POOL_LARGE,
+    WFE_POOL_HUGE,
+    WFE_POOL_TINY,
+};
+
+/**
+ * Finds the size tier whose blocks have the given size.
+ *
+ * Params:
+ *  - size of block.
+ * Returns:
+ *  - Index of tier, WFE_POOL_TIER_CUSTOM if none matches.
+ */
+static wfeSize wfePoolSharedIndex(wfeSize size) {
+    wfeSize index = 0;
+    while (index < WFE_POOL_TIER_CUSTOM && wfePoolTierSizes[index] != size)
+        index++;
+
+    return index;
+}
+
+void wfePoolSharedInit(wfePoolShared *shared) {
+    wfeSize i;
+    assert(shared != NULL /* shared must not be null */);
+
+    for (i = 0; i < WFE_POOL_TIER_CUSTOM; i++) {
+        atomic_flag_clear(&shared->locks[i]);
+        shared->blocks[i] = NULL;
+        shared->counts[i] = 0;
+    }
+
+    atomic_init(&shared->pools, 0);
+}
+
+void wfePoolSharedFinalize(wfePoolShared *shared) {
+    wfePoolBlock *tmp;
+    wfeSize i;
+    assert(shared != NULL /* shared must not be null */);
+    assert(atomic_load(&shared->pools) == 0 /* bound pools must be finalized before their store */);
+
+    for (i = 0; i < WFE_POOL_TIER_CUSTOM; i++) {
+        while (shared->blocks[i] != NULL) {
+            tmp = shared->blocks[i];
+            shared->blocks[i] = tmp->next;
+            wfePoolBlockFinalize(tmp);
+            free(tmp);
+        }
+
+        shared->counts[i] = 0;
+    }
+}
+
+wfePoolBlock *wfePoolSharedTake(wfePoolShared *shared, wfeSize size) {
+    wfePoolBlock *block;
+    wfeSize index = wfePoolSharedIndex(size);
+    assert(shared != NULL /* shared must not be null */);
+
+    if (index == WFE_POOL_TIER_CUSTOM)
+        return NULL;
+
+    while (atomic_flag_test_and_set_explicit(&shared->locks[index], memory_order_acquire));
+    block = shared->blocks[index];
+    if (block != NULL) {
+        shared->blocks[index] = block->next;
+        shared->counts[index]--;
+    }
+    atomic_flag_clear_explicit(&shared->locks[index], memory_order_release);
+
+    if (block != NULL) {
+        block->next = NULL;
+        block->head = block->start;
+        block->resident = WFE_TRUE;
+    }
+
+    return block;
+}
+
+wfeBool wfePoolSharedGive(wfePoolShared *shared, wfePoolBlock *block) {
+    wfeSize index = wfePoolSharedIndex(wfePoolBlockTotalSize(block));
+    assert(shared != NULL /* shared must not be null */);
+
+    if (index == WFE_POOL_TIER_CUSTOM)
+        return WFE_FALSE;
+
+    while (atomic_flag_test_and_set_explicit(&shared->locks[index], memory_order_acquire));
+    block->next = shared->blocks[index];
+    shared->blocks[index] = block;
+    shared->counts[index]++;
+    atomic_flag_clear_explicit(&shared->locks[index], memory_order_release);
+    return WFE_TRUE;
+}
+
+/**
+ * Allocates and initializes the handler of a pool tier.
+ *
+ * Params:
+ *  - pool owner of tier.
+ *  - index of the tier (WFE_POOL_TIER_*).
+ * Returns:
+ *  - Initialized tier.
+ *  - NULL if could not allocate tier, pool#lastError holds the reason.
+ */
+static wfePoolTier *wfePoolTierMake(wfePool *pool, wfeSize index) {
+    wfePoolTier *tier = malloc(sizeof(wfePoolTier));
+    if (tier == NULL) {
+        pool->lastError = WFE_POOL_OMEM_TIER;
+        return NULL;
+    }
+
+    // Huge pages only pay off for the biggest blocks.
+    wfeUint32 backend = pool->backend;
+    if (index != WFE_POOL_TIER_LARGE && index != WFE_POOL_TIER_HUGE)
+        backend &= ~WFE_POOL_BACKEND_HUGE_PAGES;
+
+    // Arena tiers are a single reserved block, any request of the tier fits on it.
+    wfeBool arena = (backend & WFE_POOL_BACKEND_MASK) == WFE_POOL_BACKEND_ARENA;
+    wfeSize size = arena ? WFE_POOL_ARENA_RESERVE : wfePoolTierSizes[index];
+
+    // Child and shared pools start with a spare block when the parent or the store has one.
+    wfePoolBlock *spare = pool->parent != NULL ? wfePoolLease(pool->parent, index, size) : NULL;
+    if (spare == NULL && pool->shared != NULL && !arena)
+        spare = wfePoolSharedTake(pool->shared, size);
+
+    wfeError inierr = WFE_SUCCESS;
+    if (spare != NULL) {
+        wfePoolTierReset(tier, size, backend);
+        tier->first = spare;
+        tier->current = spare;
+    } else {
+        inierr = wfePoolTierInitBackend(tier, size, backend);
+    }
+
+    if (WFE_HAS_FAILED(inierr)) {
+        free(tier);
+        pool->lastError = inierr;
+        return NULL;
+    }
+
+    tier->shared = pool->shared;
+    tier->parent = pool->parent;
+    tier->index = index;
+#ifdef WFE_POOL_STATS
+    tier->usage = &pool->usage;
+#endif
+    wfePoolTierSetTrim(tier, pool->trim, pool->trimLimit);
+
+    pool->tiers[index] = tier;
+    return tier;
+}
+
+/**
+ * Gives the block chain of a child tier back to its parent, as unreached blocks of the
+ * parent tier. The parent tier is created when missing.
+ *
+ * Params:
+ *  - parent pool.
+ *  - child tier, its chain is emptied.
+ */
+static void wfePoolGiveBack(wfePool *parent, wfePoolTier *child) {
+    wfePoolTier *tier = parent->tiers[child->index];
+    wfePoolBlock *first = child->first, *last = child->first;
+    wfeSize count = 1;
+
+    while (last->next != NULL) {
+        last = last->next;
+        count++;
+    }
+
+    child->first = NULL;
+    child->current = NULL;
+
+    if (tier == NULL) {
+        tier = malloc(sizeof(wfePoolTier));
+        if (tier == NULL) {
+            // Parent can not take the chain, release it.
+            while (first != NULL) {
+                last = first->next;
+                wfePoolBlockFinalize(first);
+                free(first);
+                first = last;
+            }
+
+            return;
+        }
+
+        // Adopted chain starts empty, what the child used on it is gone with the child.
+        wfePoolTierReset(tier, child->size, child->backend);
+        first->head = first->start;
+        tier->first = first;
+        tier->current = first;
+        tier->shared = parent->shared;
+        tier->parent = parent->parent;
+        tier->index = child->index;
+#ifdef WFE_POOL_STATS
+        tier->usage = &parent->usage;
+#endif
+        wfePoolTierSetTrim(tier, parent->trim, parent->trimLimit);
+        wfePoolStatsAdd(tier, blocks, count - 1);
+        parent->tiers[child->index] = tier;
+        return;
+    }
+
+    last->next = tier->current->next;
+    tier->current->next = first;
+    wfePoolStatsAdd(tier, blocks, count);
 }
 
 wfeError wfePoolInit(wfePool *pool) {
+    wfeSize i;
     assert(pool != NULL /* pool must not be null */);
-    pool->tiny = NULL;
-    pool->small = NULL;
-    pool->medium = NULL;
-    pool->large = NULL;
-    pool->huge = NULL;
-    pool->custom = NULL;
+
+    for (i = 0; i < WFE_POOL_TIERS; i++)
+        pool->tiers[i] = NULL;
+
     pool->fixed = NULL;
-    pool->threshold = 0.25;
+    pool->lastError = WFE_SUCCESS;
+    pool->backend = WFE_POOL_BACKEND_HEAP;
+    pool->trim = WFE_POOL_TRIM_NONE;
+    pool->trimLimit = 0;
+    pool->shared = NULL;
+    pool->parent = NULL;
+    pool->images = NULL;
+    atomic_init(&pool->incoming, NULL);
+    atomic_init(&pool->incomingObjects, NULL);
+    wfePoolObjectsInit(&pool->objects, WFE_POOL_OBJECT_CACHE, pool->backend);
+    wfePoolSetThreshold(pool, 0.25);
+#ifdef WFE_POOL_STATS
+    pool->usage.used = 0;
+    pool->usage.peak = 0;
+    pool->objects.usage = &pool->usage;
+#endif
 
     return WFE_SUCCESS; // Only to keep convention
 }
 
-void wfePoolFinalize(wfePool *pool) {
-    assert(pool != NULL /* pool must not be null */);
+wfeError wfePoolInitChild(wfePool *child, wfePool *parent) {
+    wfeError status = wfePoolInit(child);
+    assert(parent != NULL /* parent must not be null */);
+    assert(child != parent /* pool can not be its own parent */);
 
-    if (pool->tiny != NULL) {
-        wfePoolTierFinalize(pool->tiny);
-        free(pool->tiny); // Release handler
-        pool->tiny = NULL;
-    }
+    child->parent = parent;
+    child->shared = parent->shared;
+    if (child->shared != NULL)
+        atomic_fetch_add(&child->shared->pools, 1);
 
-    if (pool->small != NULL) {
-        wfePoolTierFinalize(pool->small);
-        free(pool->small); // Release handler
-        pool->small = NULL;
+    wfePoolSetBackend(child, parent->backend);
+    wfePoolSetThreshold(child, parent->threshold);
+    return status;
+}
+
+wfeError wfePoolInitShared(wfePool *pool, wfePoolShared *shared) {
+    wfeError status = wfePoolInit(pool);
+    assert(shared != NULL /* shared must not be null */);
+
+    pool->shared = shared;
+    atomic_fetch_add(&shared->pools, 1);
+    return status;
+}
+
+/**
+ * Releases memory handed off to a pool, blocks go to the store and large objects to the cache.
+ *
+ * Params:
+ *  - pool owner of handed off memory.
+ */
+static void wfePoolReclaim(wfePool *pool) {
+    wfePoolBlock *block, *tmp;
+    wfePoolObject *object, *next;
+
+    block = atomic_exchange_explicit(&pool->incoming, NULL, memory_order_acquire);
+    while (block != NULL) {
+        tmp = block->next;
+        block->next = NULL;
+        wfePoolBlockRelease(pool->shared, block);
+        block = tmp;
     }
 
-    if (pool->medium != NULL) {
-        wfePoolTierFinalize(pool->medium);
-        free(pool->medium); // Release handler
-        pool->medium = NULL;
+    object = atomic_exchange_explicit(&pool->incomingObjects, NULL, memory_order_acquire);
+    while (object != NULL) {
+        next = object->next;
+        object->owner = &pool->objects;
+        wfePoolObjectsCache(&pool->objects, object);
+        object = next;
     }
+}
+
+wfeError wfePoolHandoff(wfePool *worker, wfePool *owner) {
+    wfePoolBlock *first, *last, *spare;
+    wfePoolObject *object, *tail;
+    wfePoolTier *tier;
+    wfeSize i;
+    assert(worker != NULL /* worker must not be null */);
+    assert(owner != NULL /* owner must not be null */);
+    assert(worker != owner /* pool can not hand off to itself */);
+
+    for (i = 0; i < WFE_POOL_TIER_CUSTOM; i++) {
+        tier = worker->tiers[i];
+        if (tier == NULL || (tier->current == tier->first && tier->first->head == tier->first->start))
+            continue;
+
+        // Worker goes on with unreached blocks, a spare block of the store or a new one.
+        spare = tier->current->next;
+        if (spare == NULL)
+            spare = wfePoolTierSpare(tier);
+
+        if (spare == NULL) {
+            spare = malloc(sizeof(wfePoolBlock));
+            if (spare == NULL)
+                return WFE_POOL_OMEM_BLOCK;
+
+            if (WFE_HAS_FAILED(wfePoolBlockInitBackend(spare, tier->size, tier->backend))) {
+                free(spare);
+                return WFE_POOL_OMEM_BLOCK;
+            }
+        }
 
-    if (pool->large != NULL) {
-        wfePoolTierFinalize(pool->large);
-        free(pool->large); // Release handler
-        pool->large = NULL;
+        first = tier->first;
+        last = tier->current;
+        spare->head = spare->start;
+        tier->first = spare;
+        tier->current = spare;
+        tier->last = NULL;
+#ifdef WFE_POOL_STATS
+        wfePoolStatsUse(&tier->stats, tier->usage, 0);
+        for (spare = first; spare != last; spare = spare->next)
+            tier->stats.blocks--;
+        tier->stats.blocks--;
+#endif
+
+        // Push reached chain to the owner, its next link is the previous head.
+        last->next = atomic_load_explicit(&owner->incoming, memory_order_relaxed);
+        while (!atomic_compare_exchange_weak_explicit(&owner->incoming, &last->next, first,
+                                                      memory_order_release, memory_order_relaxed));
     }
 
-    if (pool->huge != NULL) {
-        wfePoolTierFinalize(pool->huge);
-        free(pool->huge); // Release handler
-        pool->huge = NULL;
+    object = worker->objects.live;
+    if (object != NULL) {
+        for (tail = object; tail->next != NULL; tail = tail->next);
+
+        worker->objects.live = NULL;
+        worker->objects.liveSize = 0;
+#ifdef WFE_POOL_STATS
+        wfePoolStatsUse(&worker->objects.stats, worker->objects.usage, 0);
+#endif
+        tail->next = atomic_load_explicit(&owner->incomingObjects, memory_order_relaxed);
+        while (!atomic_compare_exchange_weak_explicit(&owner->incomingObjects, &tail->next, object,
+                                                      memory_order_release, memory_order_relaxed));
     }
 
-    if (pool->custom != NULL) {
-        wfePoolTierFinalize(pool->custom);
-        free(pool->custom); // Release handler
-        pool->custom = NULL;
+    return WFE_SUCCESS;
+}
+
+wfeBool wfePoolHandoffObject(wfePool *worker, wfePool *owner, wfeData *ptr) {
+    wfePoolObject *object;
+    assert(worker != NULL /* worker must not be null */);
+    assert(owner != NULL /* owner must not be null */);
+    assert(worker != owner /* pool can not hand off to itself */);
+
+    object = wfePoolObjectsFind(&worker->objects, ptr);
+    if (object == NULL)
+        return WFE_FALSE;
+
+    if (object->prev != NULL)
+        object->prev->next = object->next;
+    else
+        worker->objects.live = object->next;
+
+    if (object->next != NULL)
+        object->next->prev = object->prev;
+
+    worker->objects.liveSize -= object->size;
+#ifdef WFE_POOL_STATS
+    wfePoolStatsUse(&worker->objects.stats, worker->objects.usage, worker->objects.liveSize);
+#endif
+
+    object->prev = NULL;
+    object->next = atomic_load_explicit(&owner->incomingObjects, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&owner->incomingObjects, &object->next, object,
+                                                  memory_order_release, memory_order_relaxed));
+    return WFE_TRUE;
+}
+
+void wfePoolFinalize(wfePool *pool) {
+    wfePoolBlock *tmp;
+    wfeSize i;
+    assert(pool != NULL /* pool must not be null */);
+
+    for (i = 0; i < WFE_POOL_TIERS; i++) {
+        if (pool->tiers[i] != NULL) {
+            // Blocks of child pools go back to the parent, blocks of shared pools stay on the store.
+            if (pool->parent != NULL)
+                wfePoolGiveBack(pool->parent, pool->tiers[i]);
+
+            while (pool->shared != NULL && pool->tiers[i]->first != NULL) {
+                tmp = pool->tiers[i]->first;
+                pool->tiers[i]->first = tmp->next;
+                tmp->next = NULL;
+                wfePoolBlockRelease(pool->shared, tmp);
+            }
+
+            wfePoolTierFinalize(pool->tiers[i]);
+            free(pool->tiers[i]); // Release handler
+            pool->tiers[i] = NULL;
+        }
     }
 
     if (pool->fixed != NULL) {
@@ -246,184 +1264,661 @@ void wfePoolFinalize(wfePool *pool) {
         free(pool->fixed); // Release handler
         pool->fixed = NULL;
     }
+
+    wfePoolReclaim(pool);
+    wfePoolObjectsFinalize(&pool->objects);
+
+    while (pool->images != NULL) {
+        wfePoolImage *image = pool->images;
+        pool->images = image->next;
+        wfeVmemUnmapFile(image->base, image->size);
+        free(image);
+    }
+
+    // Store may be finalized once every bound pool is gone.
+    if (pool->shared != NULL) {
+        atomic_fetch_sub(&pool->shared->pools, 1);
+        pool->shared = NULL;
+    }
 }
 
 wfeError wfePoolFixedTier(wfePool *pool, wfeSize size) {
+    return wfePoolSlabTier(pool, size, 1);
+}
+
+wfeError wfePoolSlabTier(wfePool *pool, wfeSize size, wfeSize count) {
+    wfeError status = WFE_SUCCESS;
+    wfeSize slot = size;
     assert(pool != NULL /* pool must not be null */);
+    assert(pool->fixed == NULL /* pool already has a fixed tier */);
+    assert(count > 0 /* blocks should hold at least one object */);
+
+    // Slots must be able to hold the free list link, a lonely slot is aligned by its block.
+    if (count > 1)
+        slot = (size + wfeAlignOf(wfeData *) - 1) & ~(wfeAlignOf(wfeData *) - 1);
+
+    if (slot < sizeof(wfeData *))
+        slot = sizeof(wfeData *);
+
     pool->fixed = malloc(sizeof(wfePoolTier));
     if (pool->fixed == NULL) {
         return WFE_POOL_OMEM_TIER;
     }
 
-    return wfePoolTierInit(pool->fixed, size);
+    status = wfePoolTierInitBackend(pool->fixed, slot * count, pool->backend & ~WFE_POOL_BACKEND_HUGE_PAGES);
+    if (WFE_HAS_FAILED(status)) {
+        free(pool->fixed);
+        pool->fixed = NULL;
+        return status;
+    }
+
+    pool->fixed->slot = slot;
+#ifdef WFE_POOL_STATS
+    pool->fixed->usage = &pool->usage;
+#endif
+    wfePoolTierSetTrim(pool->fixed, pool->trim, pool->trimLimit);
+    return WFE_SUCCESS;
 }
 
-wfeSize wfePoolTotalSize(wfePool *pool) {
-    wfeSize total = 0;
+void wfePoolFree(wfePool *pool, wfeData *ptr) {
+    wfePoolObject *object;
     assert(pool != NULL /* pool must not be null */);
 
-    if (pool->tiny != NULL)
-        total += wfePoolTierTotalSize(pool->tiny);
-
-    if (pool->small != NULL)
-        total += wfePoolTierTotalSize(pool->small);
+    // Only slab tiers and large objects keep track of single objects, anything else waits for a recycle.
+    if (pool->fixed != NULL && pool->fixed->slot != 0)
+        wfePoolTierFree(pool->fixed, ptr);
+    else if ((object = wfePoolObjectsFind(&pool->objects, ptr)) != NULL)
+        wfePoolObjectsRelease(&pool->objects, object);
+}
 
-    if (pool->medium != NULL)
-        total += wfePoolTierTotalSize(pool->medium);
+wfeError wfePoolSlabOccupancy(wfePool *pool, wfePoolOccupancy *occupancy) {
+    assert(pool != NULL /* pool must not be null */);
+    if (pool->fixed == NULL || pool->fixed->slot == 0)
+        return WFE_POOL_NOT_SLAB;
 
-    if (pool->large != NULL)
-        total += wfePoolTierTotalSize(pool->large);
+    wfePoolTierOccupancy(pool->fixed, occupancy);
+    return WFE_SUCCESS;
+}
 
-    if (pool->huge != NULL)
-        total += wfePoolTierTotalSize(pool->huge);
+wfeSize wfePoolTotalSize(wfePool *pool) {
+    wfeSize i, total = 0;
+    assert(pool != NULL /* pool must not be null */);
 
-    if (pool->custom != NULL)
-        total += wfePoolTierTotalSize(pool->custom);
+    for (i = 0; i < WFE_POOL_TIERS; i++) {
+        if (pool->tiers[i] != NULL)
+            total += wfePoolTierTotalSize(pool->tiers[i]);
+    }
 
     if (pool->fixed != NULL)
         total += wfePoolTierTotalSize(pool->fixed);
 
-    return total;
+    return total + pool->objects.liveSize + pool->objects.cacheSize;
+}
+
+void wfePoolSetBackend(wfePool *pool, wfeUint32 backend) {
+    assert(pool != NULL /* pool must not be null */);
+    pool->backend = backend;
+    pool->objects.backend = backend;
+}
+
+void wfePoolSetObjectCache(wfePool *pool, wfeSize limit) {
+    wfePoolObject *tmp;
+    assert(pool != NULL /* pool must not be null */);
+
+    pool->objects.cacheLimit = limit;
+    while (pool->objects.cacheSize > limit) {
+        tmp = pool->objects.oldest;
+        wfePoolObjectsUncache(&pool->objects, tmp);
+        wfeVmemUnmap((wfeData *) tmp, tmp->size);
+    }
+}
+
+void wfePoolSetThreshold(wfePool *pool, wfeNum threshold) {
+    wfeSize k, t, lowest;
+    assert(pool != NULL /* pool must not be null */);
+    assert(threshold > 0 && threshold <= 1 /* threshold is a ratio */);
+
+    // Multiply once here instead of once per tier on every request.
+    pool->threshold = threshold;
+    for (t = 0; t < WFE_POOL_TIER_CUSTOM; t++)
+        pool->limits[t] = (wfeSize) (wfePoolTierSizes[t] * threshold);
+
+    pool->limits[WFE_POOL_TIER_CUSTOM] = (wfeSize) -1; // Takes anything
+
+    // Each class points to the first tier that fits its smallest size, 2^(k-1)+1.
+    for (k = 0; k < WFE_POOL_CLASSES; k++) {
+        lowest = k == 0 ? 1 : ((wfeSize) 1 << (k-1)) + 1;
+        t = 0;
+        while (lowest > pool->limits[t])
+            t++;
+
+        pool->classes[k] = (wfeUint8) t;
+    }
+}
+
+void wfePoolSetTrim(wfePool *pool, wfeUint32 trim, wfeSize limit) {
+    wfeSize i;
+    assert(pool != NULL /* pool must not be null */);
+
+    pool->trim = trim;
+    pool->trimLimit = limit;
+    for (i = 0; i < WFE_POOL_TIERS; i++) {
+        if (pool->tiers[i] != NULL)
+            wfePoolTierSetTrim(pool->tiers[i], trim, limit);
+    }
+
+    if (pool->fixed != NULL)
+        wfePoolTierSetTrim(pool->fixed, trim, limit);
 }
 
-#define checkSize(p, s, tier) ( ((wfeSize) (tier)*(p->threshold)) >= (s) )
 wfeData *wfePoolGet(wfePool *pool, wfeSize size, wfeSize align) {
+    wfeSize cls, index;
+    wfePoolTier *tier;
     assert(pool != NULL /* pool must not be null */);
 
+    if (pool->fixed != NULL) {
+        wfeData *ptr = wfePoolTierGet(pool->fixed, size, align);
+        if (ptr == NULL)
+            pool->lastError = pool->fixed->slot != 0 && size > pool->fixed->slot ? WFE_POOL_SLOT_SIZE : WFE_POOL_OMEM_CHUNK;
+
+        return ptr;
+    }
+
+    cls = wfePoolSizeClass(size);
+    index = cls < WFE_POOL_CLASSES ? pool->classes[cls] : WFE_POOL_TIER_CUSTOM;
+
+    // A class might straddle a tier limit, upper half of the class goes to the next tier.
+    while (size > pool->limits[index])
+        index++;
+
+    if (index == WFE_POOL_TIER_CUSTOM) {
+        wfeData *ptr = wfePoolObjectsGet(&pool->objects, size, align);
+        if (ptr == NULL)
+            pool->lastError = WFE_POOL_OMEM_CHUNK;
+
+        return ptr;
+    }
+
+    tier = pool->tiers[index];
+    if (tier == NULL) {
+        tier = wfePoolTierMake(pool, index);
+        if (tier == NULL)
+            return NULL;
+    }
+
+    return wfePoolTierGet(tier, size, align);
+}
+
+wfeError wfePoolExtend(wfePool *pool, wfeData *ptr, wfeSize size, wfeSize extra) {
+    wfePoolTier *tier = NULL;
+    wfePoolBlock *block;
+    wfeData *head;
+    wfeSize i;
+    assert(pool != NULL /* pool must not be null */);
+    assert(ptr != NULL /* ptr must reference an object */);
+
+    for (i = 0; i <= WFE_POOL_TIERS && tier == NULL; i++) {
+        tier = i < WFE_POOL_TIERS ? pool->tiers[i] : pool->fixed;
+        if (tier != NULL && (tier->last != ptr || tier->slot != 0))
+            tier = NULL;
+    }
+
+    if (tier == NULL)
+        return WFE_POOL_NOT_LAST;
+
+    block = tier->current;
+    head = ptr + size + extra;
+    if (head > block->end || !wfePoolBlockCommit(block, head))
+        return WFE_POOL_OMEM_CHUNK;
+
+    // Size might be smaller than served bytes because of alignment, head never goes back.
+    if (head > block->head) {
+        wfePoolStatsAdd(tier, served, head - block->head);
+        wfePoolStatsAdd(tier, requested, extra);
+        wfePoolStatsUsed(tier, head - block->head);
+        block->head = head;
+    }
+
+    return WFE_SUCCESS;
+}
+
+void wfePoolRecycle(wfePool *pool) {
+    wfeSize i;
+    assert(pool != NULL /* pool must not be null */);
+
+    wfePoolReclaim(pool);
+
+    for (i = 0; i < WFE_POOL_TIERS; i++) {
+        if (pool->tiers[i] != NULL)
+            wfePoolTierRecycle(pool->tiers[i]);
+    }
+
     if (pool->fixed != NULL)
-        return wfePoolTierGet(pool->fixed, size, align);
+        wfePoolTierRecycle(pool->fixed);
 
-    if (checkSize(pool, size, WFE_POOL_TINY)) {
-        if (pool->tiny == NULL) {
-            pool->tiny = malloc(sizeof(wfePoolTier));
-            if (pool->tiny == NULL) {
-                pool->lastError = WFE_POOL_OMEM_TIER;
-                return NULL;
-            }
+    wfePoolObjectsRecycle(&pool->objects);
+}
 
-            wfeError inierr = wfePoolTierInit(pool->tiny, WFE_POOL_TINY);
-            if (WFE_HAS_FAILED(inierr)) {
-                pool->lastError = inierr;
-                return NULL;
-            }
-        }
+void wfePoolMark(wfePool *pool, wfePoolMarker *marker) {
+    wfeSize i;
+    wfePoolTier *tier;
+    assert(pool != NULL /* pool must not be null */);
+    assert(marker != NULL /* marker must reference something */);
+
+    for (i = 0; i <= WFE_POOL_TIERS; i++) {
+        tier = i < WFE_POOL_TIERS ? pool->tiers[i] : pool->fixed;
+        marker->block[i] = tier != NULL ? tier->current : NULL;
+        marker->head[i] = tier != NULL ? tier->current->head : NULL;
+#ifdef WFE_POOL_STATS
+        marker->used[i] = tier != NULL ? tier->stats.used : 0;
+#endif
+    }
 
-        return wfePoolTierGet(pool->tiny, size, align);
+    marker->live = 0;
+    marker->freeList = NULL;
+    marker->freeCount = 0;
+    marker->freeFloor = 0;
+    if (pool->fixed != NULL) {
+        // Free list only grows on top of the marked one, the floor tells if it was reached.
+        marker->live = pool->fixed->live;
+        marker->freeList = pool->fixed->freeList;
+        marker->freeCount = pool->fixed->freeCount;
+        marker->freeFloor = pool->fixed->freeFloor;
+        pool->fixed->freeFloor = pool->fixed->freeCount;
     }
 
-    if (checkSize(pool, size, WFE_POOL_SMALL)) {
-        if (pool->small == NULL) {
-            pool->small = malloc(sizeof(wfePoolTier));
-            if (pool->small == NULL) {
-                pool->lastError = WFE_POOL_OMEM_TIER;
-                return NULL;
-            }
+    marker->serial = pool->objects.serial;
+}
 
-            wfeError inierr = wfePoolTierInit(pool->small, WFE_POOL_SMALL);
-            if (WFE_HAS_FAILED(inierr)) {
-                pool->lastError = inierr;
-                return NULL;
-            }
+void wfePoolRewind(wfePool *pool, const wfePoolMarker *marker) {
+    wfeSize i;
+    wfePoolTier *tier;
+    assert(pool != NULL /* pool must not be null */);
+    assert(marker != NULL /* marker must reference something */);
+
+    for (i = 0; i <= WFE_POOL_TIERS; i++) {
+        tier = i < WFE_POOL_TIERS ? pool->tiers[i] : pool->fixed;
+        if (tier == NULL)
+            continue;
+
+        // Tiers created after the mark were empty at that time.
+        tier->last = NULL;
+        if (marker->block[i] == NULL) {
+            tier->current = tier->first;
+            tier->current->head = tier->current->start;
+        } else {
+            tier->current = marker->block[i];
+            tier->current->head = marker->head[i];
         }
 
-        return wfePoolTierGet(pool->small, size, align);
+#ifdef WFE_POOL_STATS
+        wfePoolStatsUse(&tier->stats, tier->usage, marker->used[i]);
+#endif
     }
 
-    if (checkSize(pool, size, WFE_POOL_MEDIUM)) {
-        if (pool->medium == NULL) {
-            pool->medium = malloc(sizeof(wfePoolTier));
-            if (pool->medium == NULL) {
-                pool->lastError = WFE_POOL_OMEM_TIER;
-                return NULL;
-            }
-
-            wfeError inierr = wfePoolTierInit(pool->medium, WFE_POOL_MEDIUM);
-            if (WFE_HAS_FAILED(inierr)) {
-                pool->lastError = inierr;
-                return NULL;
-            }
+    // Marked free list is intact unless a slot of it was handed out after the mark, which
+    // overwrote its link. Slots released after the mark are dropped until next recycle.
+    if (pool->fixed != NULL) {
+        tier = pool->fixed;
+        if (marker->block[WFE_POOL_TIERS] != NULL && tier->freeFloor >= marker->freeCount) {
+            tier->freeList = marker->freeList;
+            tier->freeCount = marker->freeCount;
+        } else {
+            tier->freeList = NULL;
+            tier->freeCount = 0;
         }
 
-        return wfePoolTierGet(pool->medium, size, align);
+        tier->live = marker->block[WFE_POOL_TIERS] != NULL ? marker->live : 0;
+        tier->freeFloor = marker->freeFloor < tier->freeCount ? marker->freeFloor : tier->freeCount;
     }
 
-    if (checkSize(pool, size, WFE_POOL_LARGE)) {
-        if (pool->large == NULL) {
-            pool->large = malloc(sizeof(wfePoolTier));
-            if (pool->large == NULL) {
-                pool->lastError = WFE_POOL_OMEM_TIER;
-                return NULL;
-            }
+    // Live objects are sorted newest first, release the ones requested after the mark.
+    while (pool->objects.live != NULL && (pool->objects.live->serial ^ WFE_POOL_OBJECT_MAGIC) >= marker->serial)
+        wfePoolObjectsRelease(&pool->objects, pool->objects.live);
+}
 
-            wfeError inierr = wfePoolTierInit(pool->large, WFE_POOL_LARGE);
-            if (WFE_HAS_FAILED(inierr)) {
-                pool->lastError = inierr;
-                return NULL;
+#define WFE_POOL_IMAGE_MAGIC ((wfeUint64) 0x32474d494c4f4f50) // "POOLIMG2"
+
+/**
+ * Head of an image file, followed by the relocation table and then the segments.
+ */
+typedef struct wfePoolImageHeader {
+    wfeUint64 magic;       // WFE_POOL_IMAGE_MAGIC
+    wfeUint64 key;         // Key of sources given on write
+    wfeUint64 hash;        // FNV-1a of relocation table
+    wfeUint64 size;        // Bytes of file
+    wfeUint64 relocations; // Count of relocations, each one is the offset of a slot
+    wfeUint64 root;        // Offset of root object, zero if none
+    wfeUint64 content;     // FNV-1a of segments, only checked with WFE_POOL_IMAGE_VERIFY
+} wfePoolImageHeader;
+
+/**
+ * Range of pool memory copied into an image.
+ */
+typedef struct wfePoolImageSegment {
+    wfeData *start;
+    wfeSize size;
+    wfeSize offset; // Offset on image
+} wfePoolImageSegment;
+
+/**
+ * Hashes bytes with 64 bit FNV-1a.
+ *
+ * Params:
+ *  - data to hash.
+ *  - size of data.
+ * Returns:
+ *  - Hash of data.
+ */
+static wfeUint64 wfePoolImageHash(const wfeData *data, wfeSize size) {
+    wfeUint64 hash = (wfeUint64) 0xcbf29ce484222325;
+    wfeSize i;
+    for (i = 0; i < size; i++) {
+        hash ^= (wfeUint8) data[i];
+        hash *= (wfeUint64) 0x100000001b3;
+    }
+
+    return hash;
+}
+
+// Orders segments by start address.
+static int wfePoolImageCompare(const void *a, const void *b) {
+    const wfePoolImageSegment *sa = a, *sb = b;
+    return sa->start < sb->start ? -1 : (sa->start > sb->start ? 1 : 0);
+}
+
+/**
+ * Translates an address of pool memory into an image offset.
+ *
+ * Params:
+ *  - segments sorted by start.
+ *  - count of segments.
+ *  - ptr address to translate, one past the end of a segment is accepted.
+ *  - size of the object at ptr that must fit on the segment.
+ * Returns:
+ *  - Offset on image, zero if address is not on any segment.
+ */
+static wfeSize wfePoolImageOffset(const wfePoolImageSegment *segments, wfeSize count, wfeData *ptr, wfeSize size) {
+    wfeSize low = 0, high = count, mid;
+
+    // Last segment that starts at or before ptr.
+    while (low < high) {
+        mid = (low + high) / 2;
+        if (segments[mid].start <= ptr)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if (low == 0 || ptr + size > segments[low-1].start + segments[low-1].size)
+        return 0;
+
+    return segments[low-1].offset + (ptr - segments[low-1].start);
+}
+
+wfeError wfePoolImageWrite(wfePool *pool, const wfeChar *path, wfeUint64 key, wfeData *root, wfeAny *slots, wfeSize count) {
+    wfeError status = WFE_SUCCESS;
+    wfePoolImageSegment *segments = NULL;
+    wfePoolImageHeader *header = NULL;
+    wfeUint64 *relocations;
+    wfePoolBlock *block;
+    wfePoolObject *object;
+    wfePoolTier *tier;
+    wfeData *image = NULL, *target;
+    wfeSize i, total = 0, nsegments = 0, page = wfeVmemPageSize(), offset, cursor;
+    FILE *file = NULL;
+    assert(pool != NULL /* pool must not be null */);
+    assert(path != NULL /* path must reference a file */);
+    assert(slots != NULL || count == 0 /* slots must reference something */);
+
+    // Count segments, every block with objects and every large object.
+    for (i = 0; i <= WFE_POOL_TIERS; i++) {
+        tier = i < WFE_POOL_TIERS ? pool->tiers[i] : pool->fixed;
+        for (block = tier != NULL ? tier->first : NULL; block != NULL; block = block == tier->current ? NULL : block->next)
+            nsegments += block->head > block->start ? 1 : 0;
+    }
+
+    for (object = pool->objects.live; object != NULL; object = object->next)
+        nsegments++;
+
+    segments = malloc(sizeof(wfePoolImageSegment) * (nsegments + 1));
+    if (segments == NULL) {
+        status = WFE_POOL_OMEM_CHUNK; goto finalize;
+    }
+
+    nsegments = 0;
+    for (i = 0; i <= WFE_POOL_TIERS; i++) {
+        tier = i < WFE_POOL_TIERS ? pool->tiers[i] : pool->fixed;
+        for (block = tier != NULL ? tier->first : NULL; block != NULL; block = block == tier->current ? NULL : block->next) {
+            if (block->head > block->start) {
+                segments[nsegments].start = block->start;
+                segments[nsegments++].size = block->head - block->start;
             }
         }
+    }
 
-        return wfePoolTierGet(pool->large, size, align);
+    for (object = pool->objects.live; object != NULL; object = object->next) {
+        segments[nsegments].start = (wfeData *) object + object->offset;
+        segments[nsegments++].size = object->size - object->offset;
     }
 
-    if (checkSize(pool, size, WFE_POOL_HUGE)) {
-        if (pool->huge == NULL) {
-            pool->huge = malloc(sizeof(wfePoolTier));
-            if (pool->huge == NULL) {
-                pool->lastError = WFE_POOL_OMEM_TIER;
-                return NULL;
-            }
+    qsort(segments, nsegments, sizeof(wfePoolImageSegment), wfePoolImageCompare);
 
-            wfeError inierr = wfePoolTierInit(pool->huge, WFE_POOL_HUGE);
-            if (WFE_HAS_FAILED(inierr)) {
-                pool->lastError = inierr;
-                return NULL;
-            }
+    // Segments keep their offset within a page, so objects keep their alignment.
+    cursor = sizeof(wfePoolImageHeader) + sizeof(wfeUint64) * count;
+    for (i = 0; i < nsegments; i++) {
+        cursor = wfePoolMemoryAlign(cursor, page);
+        segments[i].offset = cursor + ((wfeSize) segments[i].start & (page - 1));
+        cursor = segments[i].offset + segments[i].size;
+    }
+
+    total = cursor;
+    image = calloc(1, total);
+    if (image == NULL) {
+        status = WFE_POOL_OMEM_CHUNK; goto finalize;
+    }
+
+    for (i = 0; i < nsegments; i++)
+        memcpy(image + segments[i].offset, segments[i].start, segments[i].size);
+
+    // Slots hold image offsets of their targets, load adds the base address.
+    relocations = (wfeUint64 *) (image + sizeof(wfePoolImageHeader));
+    for (i = 0; i < count; i++) {
+        offset = wfePoolImageOffset(segments, nsegments, (wfeData *) slots[i], sizeof(wfeData *));
+        memcpy(&target, slots[i], sizeof(wfeData *));
+        cursor = target != NULL ? wfePoolImageOffset(segments, nsegments, target, 0) : 0;
+        if (offset == 0 || (target != NULL && cursor == 0)) {
+            status = WFE_POOL_IMAGE_OUTSIDE; goto finalize;
         }
 
-        return wfePoolTierGet(pool->huge, size, align);
+        relocations[i] = (wfeUint64) offset;
+        memcpy(image + offset, &cursor, sizeof(wfeSize));
     }
 
-    if (pool->custom == NULL) {
-        pool->custom = malloc(sizeof(wfePoolTier));
-        if (pool->custom == NULL) {
-            pool->lastError = WFE_POOL_OMEM_TIER;
-            return NULL;
+    header = (wfePoolImageHeader *) image;
+    header->magic = WFE_POOL_IMAGE_MAGIC;
+    header->key = key;
+    header->size = (wfeUint64) total;
+    header->relocations = (wfeUint64) count;
+    header->root = root != NULL ? (wfeUint64) wfePoolImageOffset(segments, nsegments, root, 0) : 0;
+    if (root != NULL && header->root == 0) {
+        status = WFE_POOL_IMAGE_OUTSIDE; goto finalize;
+    }
+
+    header->hash = wfePoolImageHash(image + sizeof(wfePoolImageHeader), sizeof(wfeUint64) * count);
+    header->content = wfePoolImageHash(image + sizeof(wfePoolImageHeader) + sizeof(wfeUint64) * count,
+                                       total - sizeof(wfePoolImageHeader) - sizeof(wfeUint64) * count);
+
+    file = fopen(path, "wb");
+    if (file == NULL || fwrite(image, 1, total, file) != total) {
+        status = WFE_POOL_IMAGE_WRITE; goto finalize;
+    }
+
+finalize:
+    if (file != NULL && fclose(file) != 0 && WFE_SHOULD_CONTINUE(status))
+        status = WFE_POOL_IMAGE_WRITE;
+
+    free(image);
+    free(segments);
+    return status;
+}
+
+wfeError wfePoolImageLoad(wfePool *pool, const wfeChar *path, wfeUint64 key, wfeData **root) {
+    wfePoolImageHeader *header;
+    wfePoolImage *image;
+    wfeUint64 *relocations, i;
+    wfeSize size = 0, target, first;
+    wfeData *base;
+    assert(pool != NULL /* pool must not be null */);
+    assert(path != NULL /* path must reference a file */);
+    assert(root != NULL /* root must reference something */);
+
+    *root = NULL;
+    base = wfeVmemMapFile(path, &size);
+    if (base == NULL)
+        return WFE_POOL_IMAGE_STALE;
+
+    // Anything unexpected means the image can not be trusted. Only the relocation table is
+    // hashed, hashing segments would touch every page of the mapping; key covers staleness.
+    header = (wfePoolImageHeader *) base;
+    if (size < sizeof(wfePoolImageHeader) || header->magic != WFE_POOL_IMAGE_MAGIC || header->key != key ||
+        header->size != size || header->relocations > (size - sizeof(wfePoolImageHeader)) / sizeof(wfeUint64) ||
+        header->hash != wfePoolImageHash(base + sizeof(wfePoolImageHeader), header->relocations * sizeof(wfeUint64))) {
+        wfeVmemUnmapFile(base, size);
+        return WFE_POOL_IMAGE_STALE;
+    }
+
+    // Slots, their targets and the root must lay on the segments, after the relocation table.
+    first = sizeof(wfePoolImageHeader) + header->relocations * sizeof(wfeUint64);
+#ifdef WFE_POOL_IMAGE_VERIFY
+    if (header->content != wfePoolImageHash(base + first, size - first)) {
+        wfeVmemUnmapFile(base, size);
+        return WFE_POOL_IMAGE_STALE;
+    }
+#endif
+
+    if (header->root != 0 && (header->root < first || header->root >= size)) {
+        wfeVmemUnmapFile(base, size);
+        return WFE_POOL_IMAGE_STALE;
+    }
+
+    // Pages touched by fix ups become private copies, the rest stays shared with the file.
+    relocations = (wfeUint64 *) (base + sizeof(wfePoolImageHeader));
+    for (i = 0; i < header->relocations; i++) {
+        if (relocations[i] < first || relocations[i] > size - sizeof(wfeSize)) {
+            wfeVmemUnmapFile(base, size);
+            return WFE_POOL_IMAGE_STALE;
         }
 
-        // Firstly get a tiny chunk, next chunks will have custom size (very large).
-        wfeError inierr = wfePoolTierInit(pool->custom, WFE_POOL_TINY);
-        if (WFE_HAS_FAILED(inierr)) {
-            pool->lastError = inierr;
-            return NULL;
+        memcpy(&target, base + relocations[i], sizeof(wfeSize));
+        if (target != 0 && (target < first || target >= size)) {
+            wfeVmemUnmapFile(base, size);
+            return WFE_POOL_IMAGE_STALE;
         }
+
+        target = target != 0 ? (wfeSize) base + target : 0;
+        memcpy(base + relocations[i], &target, sizeof(wfeSize));
     }
 
-    return wfePoolTierGet(pool->custom, size, align);
+    image = malloc(sizeof(wfePoolImage));
+    if (image == NULL) {
+        wfeVmemUnmapFile(base, size);
+        return WFE_POOL_OMEM_BLOCK;
+    }
+
+    image->base = base;
+    image->size = size;
+    image->next = pool->images;
+    pool->images = image;
+    *root = header->root != 0 ? base + header->root : NULL;
+    return WFE_SUCCESS;
 }
 
-#undef checkSize
+// Names of tiers on reports, fixed one at last.
+static const char *wfePoolTierNames[WFE_POOL_TIERS + 1] = {
+    "tiny", "small", "medium", "large", "huge", "custom", "fixed"
+};
 
-void wfePoolRecycle(wfePool *pool) {
+wfeError wfePoolStats(wfePool *pool, wfePoolReport *report) {
+#ifdef WFE_POOL_STATS
+    wfeSize i, k;
+    wfePoolTier *tier;
     assert(pool != NULL /* pool must not be null */);
+    assert(report != NULL /* report must reference something */);
+
+    memset(report, 0, sizeof(wfePoolReport));
+    for (i = 0; i <= WFE_POOL_TIERS; i++) {
+        tier = i < WFE_POOL_TIERS ? pool->tiers[i] : pool->fixed;
+        if (tier == NULL && i != WFE_POOL_TIER_CUSTOM)
+            continue;
+
+        // Custom tier reports large objects, live and cached mappings are its reserved bytes.
+        if (i == WFE_POOL_TIER_CUSTOM) {
+            report->tiers[i] = pool->objects.stats;
+            report->reserved[i] = pool->objects.liveSize + pool->objects.cacheSize;
+        } else {
+            report->tiers[i] = tier->stats;
+            report->reserved[i] = wfePoolTierTotalSize(tier);
+        }
 
-    if (pool->tiny != NULL)
-        wfePoolTierRecycle(pool->tiny);
-
-    if (pool->small != NULL)
-        wfePoolTierRecycle(pool->small);
-
-    if (pool->medium != NULL)
-        wfePoolTierRecycle(pool->medium);
+        report->totalReserved += report->reserved[i];
+        report->total.requests += report->tiers[i].requests;
+        report->total.requested += report->tiers[i].requested;
+        report->total.served += report->tiers[i].served;
+        report->total.tailWaste += report->tiers[i].tailWaste;
+        report->total.used += report->tiers[i].used;
+        report->total.blocks += report->tiers[i].blocks;
+        report->total.recycles += report->tiers[i].recycles;
+        for (k = 0; k < WFE_POOL_CLASSES; k++)
+            report->total.histogram[k] += report->tiers[i].histogram[k];
+    }
 
-    if (pool->large != NULL)
-        wfePoolTierRecycle(pool->large);
+    report->total.peak = pool->usage.peak;
+    return WFE_SUCCESS;
+#else
+    (void) pool; (void) report;
+    return WFE_POOL_STATS_DISABLED;
+#endif
+}
 
-    if (pool->huge != NULL)
-        wfePoolTierRecycle(pool->huge);
+/**
+ * Writes the counters of a tier as JSON members.
+ *
+ * Params:
+ *  - out stream to write.
+ *  - stats of tier.
+ *  - reserved bytes of tier.
+ */
+static void wfePoolStatsWrite(FILE *out, const wfePoolTierStats *stats, wfeSize reserved) {
+    wfeSize k;
+    fprintf(out, "\"reserved\": %zu, \"requests\": %zu, \"requested\": %zu, \"served\": %zu, ",
+            reserved, stats->requests, stats->requested, stats->served);
+    fprintf(out, "\"internalWaste\": %zu, \"tailWaste\": %zu, \"used\": %zu, \"peak\": %zu, ",
+            stats->served - stats->requested, stats->tailWaste, stats->used, stats->peak);
+    fprintf(out, "\"blocks\": %zu, \"recycles\": %zu, \"histogram\": [", stats->blocks, stats->recycles);
+    for (k = 0; k < WFE_POOL_CLASSES; k++)
+        fprintf(out, k == 0 ? "%zu" : ", %zu", stats->histogram[k]);
+    fprintf(out, "]");
+}
 
-    if (pool->custom != NULL)
-        wfePoolTierRecycle(pool->custom);
+wfeError wfePoolStatsDump(wfePool *pool, FILE *out) {
+    wfePoolReport report;
+    wfeSize i;
+    wfeError status = wfePoolStats(pool, &report);
+    assert(out != NULL /* out must reference a stream */);
+
+    if (WFE_HAS_FAILED(status))
+        return status;
+
+    fprintf(out, "{");
+    wfePoolStatsWrite(out, &report.total, report.totalReserved);
+    fprintf(out, ", \"tiers\": {");
+    for (i = 0; i <= WFE_POOL_TIERS; i++) {
+        fprintf(out, i == 0 ? "\"%s\": {" : ", \"%s\": {", wfePoolTierNames[i]);
+        wfePoolStatsWrite(out, &report.tiers[i], report.reserved[i]);
+        fprintf(out, "}");
+    }
 
-    if (pool->fixed != NULL)
-        wfePoolTierRecycle(pool->fixed);
+    fprintf(out, "}}\n");
+    return WFE_SUCCESS;
 }
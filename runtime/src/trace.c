@@ -0,0 +1,238 @@
+#include <wfe/trace.h>
+#include <wfe/types.h>
+#include <stdatomic.h>
+#include <threads.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <assert.h>
+
+/**
+ * Events of a single thread, only that thread writes them.
+ */
+typedef struct wfeTraceRing {
+    struct wfeTraceRing *next;
+    wfeTraceEvent *events;
+    wfeSize capacity;
+    wfeSize count;  // Events recorded, ring keeps the last capacity of them
+    wfeUint32 tid;  // Order of first event of thread, used as Chrome thread id
+} wfeTraceRing;
+
+static once_flag wfeTraceOnce = ONCE_FLAG_INIT;
+static mtx_t wfeTraceLock;            // Guards the list of rings
+static atomic_bool wfeTraceEnabled;   // Checked without lock by every span
+static atomic_uint wfeTraceGeneration; // Bumped on start, rings of older generations are gone
+static wfeTraceRing *wfeTraceRings;
+static wfeSize wfeTraceCapacity;
+static wfeUint64 wfeTraceOrigin;
+static wfeUint32 wfeTraceThreads;
+
+static _Thread_local wfeTraceRing *wfeTraceLocal;
+static _Thread_local unsigned wfeTraceLocalGeneration;
+
+// Current monotonic-enough time in nanoseconds, never zero.
+static wfeUint64 wfeTraceNow(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (wfeUint64) ts.tv_sec * 1000000000 + (wfeUint64) ts.tv_nsec;
+}
+
+static void wfeTraceInitLock(void) {
+    mtx_init(&wfeTraceLock, mtx_plain);
+}
+
+/**
+ * Finds the ring of current thread, creating it on its first span of this trace.
+ *
+ * Returns:
+ *  - Ring of thread, NULL if no memory is available (events are dropped).
+ */
+static wfeTraceRing *wfeTraceThreadRing(void) {
+    unsigned generation = atomic_load_explicit(&wfeTraceGeneration, memory_order_acquire);
+    wfeTraceRing *ring;
+
+    if (wfeTraceLocal != NULL && wfeTraceLocalGeneration == generation)
+        return wfeTraceLocal;
+
+    // Ring and its events share a single allocation.
+    ring = malloc(sizeof(wfeTraceRing) + sizeof(wfeTraceEvent) * wfeTraceCapacity);
+    if (ring == NULL)
+        return NULL;
+
+    ring->events = (wfeTraceEvent *) (ring + 1);
+    ring->capacity = wfeTraceCapacity;
+    ring->count = 0;
+
+    mtx_lock(&wfeTraceLock);
+    ring->tid = ++wfeTraceThreads;
+    ring->next = wfeTraceRings;
+    wfeTraceRings = ring;
+    mtx_unlock(&wfeTraceLock);
+
+    wfeTraceLocal = ring;
+    wfeTraceLocalGeneration = generation;
+    return ring;
+}
+
+/**
+ * Writes a string as JSON, escaping quotes, backslashes and control characters.
+ *
+ * Params:
+ *  - file to write.
+ *  - str to escape.
+ */
+static void wfeTraceWriteString(FILE *file, const wfeChar *str) {
+    fputc('"', file);
+    for (; *str != '\0'; str++) {
+        if (*str == '"' || *str == '\\')
+            fprintf(file, "\\%c", *str);
+        else if ((unsigned char) *str < 0x20)
+            fprintf(file, "\\u%04x", (unsigned) *str);
+        else
+            fputc(*str, file);
+    }
+
+    fputc('"', file);
+}
+
+/**
+ * Writes every kept event in Chrome trace event format, complete events ("X") with
+ * microsecond timestamps plus the name of each thread.
+ *
+ * Params:
+ *  - file to write.
+ * Returns:
+ *  - WFE_TRUE if every write succeeded.
+ */
+static wfeBool wfeTraceWrite(FILE *file) {
+    const wfeTraceEvent *event;
+    const wfeTraceRing *ring;
+    wfeSize i, first, kept, dropped = 0;
+    const wfeChar *separator = "\n";
+
+    fputs("{\"traceEvents\": [", file);
+    for (ring = wfeTraceRings; ring != NULL; ring = ring->next) {
+        fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"thread %u\"}}",
+                separator, (unsigned) ring->tid, (unsigned) ring->tid);
+        separator = ",\n";
+
+        // Oldest kept event first, full rings start right after the newest.
+        kept = ring->count < ring->capacity ? ring->count : ring->capacity;
+        first = ring->count < ring->capacity ? 0 : ring->count % ring->capacity;
+        dropped += ring->count - kept;
+        for (i = 0; i < kept; i++) {
+            event = &ring->events[(first + i) % ring->capacity];
+            fprintf(file, ",\n{\"name\": \"%s\", \"cat\": \"asset\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %u, \"args\": {\"asset\": ",
+                    event->span, (double) (event->start - wfeTraceOrigin) / 1e3, (double) event->duration / 1e3, (unsigned) ring->tid);
+            wfeTraceWriteString(file, event->asset);
+            fprintf(file, ", \"bytes\": %llu", (unsigned long long) event->bytes);
+            if (event->cache != WFE_TRACE_CACHE_NONE)
+                fprintf(file, ", \"cache\": \"%s\"", event->cache == WFE_TRACE_CACHE_HIT ? "hit" : "miss");
+
+            fputs("}}", file);
+        }
+    }
+
+    fprintf(file, "\n], \"displayTimeUnit\": \"ms\", \"otherData\": {\"dropped\": %llu}}\n", (unsigned long long) dropped);
+    return !ferror(file);
+}
+
+wfeError wfeTraceStart(wfeSize events) {
+    wfeError status = WFE_SUCCESS;
+    assert(events > 0 /* rings should hold something */);
+
+    call_once(&wfeTraceOnce, wfeTraceInitLock);
+    mtx_lock(&wfeTraceLock);
+    if (atomic_load(&wfeTraceEnabled)) {
+        status = WFE_TRACE_RUNNING; goto finalize;
+    }
+
+    wfeTraceRings = NULL;
+    wfeTraceThreads = 0;
+    wfeTraceCapacity = events;
+    wfeTraceOrigin = wfeTraceNow();
+    atomic_fetch_add(&wfeTraceGeneration, 1);
+    atomic_store(&wfeTraceEnabled, WFE_TRUE);
+
+finalize:
+    mtx_unlock(&wfeTraceLock);
+    return status;
+}
+
+wfeError wfeTraceStop(const wfeChar *path) {
+    wfeError status = WFE_SUCCESS;
+    wfeTraceRing *ring, *next;
+    FILE *file;
+
+    call_once(&wfeTraceOnce, wfeTraceInitLock);
+    mtx_lock(&wfeTraceLock);
+    if (!atomic_load(&wfeTraceEnabled))
+        goto finalize;
+
+    atomic_store(&wfeTraceEnabled, WFE_FALSE);
+    if (path != NULL) {
+        file = fopen(path, "w");
+        if (file == NULL || !wfeTraceWrite(file))
+            status = WFE_TRACE_WRITE_ERROR;
+
+        if (file != NULL && fclose(file) != 0)
+            status = WFE_TRACE_WRITE_ERROR;
+    }
+
+    for (ring = wfeTraceRings; ring != NULL; ring = next) {
+        next = ring->next;
+        free(ring);
+    }
+
+    wfeTraceRings = NULL;
+
+finalize:
+    mtx_unlock(&wfeTraceLock);
+    return status;
+}
+
+wfeUint64 wfeTraceBegin(void) {
+    if (!atomic_load_explicit(&wfeTraceEnabled, memory_order_relaxed))
+        return 0;
+
+    return wfeTraceNow();
+}
+
+void wfeTraceEnd(wfeUint64 start, const wfeChar *span, const wfeChar *name, const wfeChar *ext, wfeSize bytes, wfeUint32 cache) {
+    wfeTraceEvent *event;
+    wfeTraceRing *ring;
+    wfeSize nalen = 0, exlen = 0;
+    assert(span != NULL /* span should have a name */);
+
+    // Spans opened before a stop are dropped.
+    if (start == 0 || !atomic_load_explicit(&wfeTraceEnabled, memory_order_relaxed))
+        return;
+
+    ring = wfeTraceThreadRing();
+    if (ring == NULL)
+        return;
+
+    event = &ring->events[ring->count % ring->capacity];
+    event->span = span;
+    event->start = start;
+    event->duration = wfeTraceNow() - start;
+    event->bytes = bytes;
+    event->cache = cache;
+
+    // Name and extension are cut to fit, leaving room for the terminator.
+    if (name != NULL) {
+        nalen = strlen(name);
+        nalen = nalen < WFE_TRACE_ASSET_SIZE - 1 ? nalen : WFE_TRACE_ASSET_SIZE - 1;
+        memcpy(event->asset, name, nalen);
+    }
+
+    if (name != NULL && ext != NULL) {
+        exlen = strlen(ext);
+        exlen = exlen < WFE_TRACE_ASSET_SIZE - 1 - nalen ? exlen : WFE_TRACE_ASSET_SIZE - 1 - nalen;
+        memcpy(event->asset + nalen, ext, exlen);
+    }
+
+    event->asset[nalen + exlen] = '\0';
+    ring->count++;
+}
@@ -0,0 +1,238 @@
+// mmap flags and madvise are not part of strict C11/POSIX.
+#define _DEFAULT_SOURCE
+#include <wfe/vmem.h>
+#include <wfe/types.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#elif defined(_WINDOWS)
+#include <windows.h>
+#endif
+
+#define WFE_VMEM_HUGE_PAGE_SIZE ((wfeSize) 2097152) // 2 MB
+
+// Rounds size up to a multiple of a power-of-two boundary.
+#define wfeVmemRound(size, boundary) (((size) + ((boundary)-1)) & ~((boundary)-1))
+
+wfeSize wfeVmemPageSize(void) {
+    static wfeSize pageSize = 0;
+    if (pageSize == 0) {
+#ifdef HAVE_UNISTD_H
+        pageSize = (wfeSize) sysconf(_SC_PAGESIZE);
+#elif defined(_WINDOWS)
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        pageSize = (wfeSize) info.dwPageSize;
+#else
+        pageSize = 4096;
+#endif
+    }
+
+    return pageSize;
+}
+
+wfeData *wfeVmemMap(wfeSize size, wfeUint32 flags) {
+    assert(size > 0 /* size should be at least 1 */);
+    size = wfeVmemRound(size, wfeVmemPageSize());
+
+#ifdef HAVE_UNISTD_H
+    void *mem = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    // Explicit huge pages only work when the system has reserved them.
+    if ((flags & WFE_VMEM_HUGE_PAGES) != 0 && size % WFE_VMEM_HUGE_PAGE_SIZE == 0) {
+        mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_HUGETLB, -1, 0);
+    }
+#endif
+
+    if (mem == MAP_FAILED) {
+        mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (mem == MAP_FAILED)
+            return NULL;
+
+#ifdef MADV_HUGEPAGE
+        if ((flags & WFE_VMEM_HUGE_PAGES) != 0)
+            madvise(mem, size, MADV_HUGEPAGE);
+#endif
+    }
+
+    return (wfeData *) mem;
+#elif defined(_WINDOWS)
+    return (wfeData *) VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+    return (wfeData *) calloc(1, size);
+#endif
+}
+
+wfeData *wfeVmemReserve(wfeSize size) {
+    assert(size > 0 /* size should be at least 1 */);
+    size = wfeVmemRound(size, wfeVmemPageSize());
+
+#ifdef HAVE_UNISTD_H
+    void *mem = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return mem != MAP_FAILED ? (wfeData *) mem : NULL;
+#elif defined(_WINDOWS)
+    return (wfeData *) VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+#else
+    return (wfeData *) calloc(1, size);
+#endif
+}
+
+wfeBool wfeVmemCommit(wfeData *ptr, wfeSize size) {
+    wfeSize page = wfeVmemPageSize();
+    wfeData *start = (wfeData *) ((wfeSize) ptr & ~(page-1));
+    wfeData *end = (wfeData *) wfeVmemRound((wfeSize) ptr + size, page);
+    assert(ptr != NULL /* range should be reserved */);
+
+    if (end <= start)
+        return WFE_TRUE;
+
+#ifdef HAVE_UNISTD_H
+    return mprotect(start, end - start, PROT_READ | PROT_WRITE) == 0 ? WFE_TRUE : WFE_FALSE;
+#elif defined(_WINDOWS)
+    return VirtualAlloc(start, end - start, MEM_COMMIT, PAGE_READWRITE) != NULL ? WFE_TRUE : WFE_FALSE;
+#else
+    return WFE_TRUE;
+#endif
+}
+
+void wfeVmemUnmap(wfeData *ptr, wfeSize size) {
+    assert(ptr != NULL /* range should be mapped */);
+    size = wfeVmemRound(size, wfeVmemPageSize());
+
+#ifdef HAVE_UNISTD_H
+    munmap(ptr, size);
+#elif defined(_WINDOWS)
+    VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+    free(ptr);
+#endif
+}
+
+void wfeVmemDiscard(wfeData *ptr, wfeSize size) {
+    wfeSize page = wfeVmemPageSize();
+    wfeData *start = (wfeData *) wfeVmemRound((wfeSize) ptr, page);
+    wfeData *end = (wfeData *) (((wfeSize) ptr + size) & ~(page-1));
+    assert(ptr != NULL /* range should be mapped */);
+
+    if (end <= start)
+        return;
+
+#ifdef HAVE_UNISTD_H
+    madvise(start, end - start, MADV_DONTNEED);
+#elif defined(_WINDOWS)
+    VirtualFree(start, end - start, MEM_DECOMMIT);
+    VirtualAlloc(start, end - start, MEM_COMMIT, PAGE_READWRITE);
+#endif
+}
+
+void wfeVmemAdvise(wfeData *ptr, wfeSize size, wfeUint32 advice) {
+    wfeSize page = wfeVmemPageSize();
+    wfeData *start = (wfeData *) ((wfeSize) ptr & ~(page-1));
+    assert(ptr != NULL /* range should be mapped */);
+
+    if (size == 0)
+        return;
+
+#ifdef HAVE_UNISTD_H
+    int hint = MADV_NORMAL;
+    switch (advice) {
+    case WFE_VMEM_SEQUENTIAL: hint = MADV_SEQUENTIAL; break;
+    case WFE_VMEM_WILL_NEED: hint = MADV_WILLNEED; break;
+    case WFE_VMEM_RANDOM: hint = MADV_RANDOM; break;
+    }
+
+    madvise(start, (ptr - start) + size, hint);
+#elif defined(_WINDOWS) && _WIN32_WINNT >= 0x0602
+    // Windows only knows about prefetching.
+    WIN32_MEMORY_RANGE_ENTRY range;
+    if (advice == WFE_VMEM_WILL_NEED || advice == WFE_VMEM_SEQUENTIAL) {
+        range.VirtualAddress = start;
+        range.NumberOfBytes = (ptr - start) + size;
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+#else
+    (void) start;
+#endif
+}
+
+wfeData *wfeVmemMapFile(const wfeChar *path, wfeSize *size) {
+    wfeData *mem = NULL;
+    assert(path != NULL /* path should reference a file */);
+    assert(size != NULL /* size should reference something */);
+    *size = 0;
+
+#ifdef HAVE_UNISTD_H
+    struct stat info;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        mem = mmap(NULL, (wfeSize) info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (mem == MAP_FAILED) {
+            mem = NULL;
+        } else {
+            *size = (wfeSize) info.st_size;
+        }
+    }
+
+    close(fd); // Mapping keeps its own reference.
+    return mem;
+#elif defined(_WINDOWS)
+    LARGE_INTEGER length;
+    HANDLE mapping = NULL;
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    if (GetFileSizeEx(file, &length) && length.QuadPart > 0)
+        mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+
+    if (mapping != NULL) {
+        mem = (wfeData *) MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+        if (mem != NULL)
+            *size = (wfeSize) length.QuadPart;
+
+        CloseHandle(mapping);
+    }
+
+    CloseHandle(file);
+    return mem;
+#else
+    long length;
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+
+    if (fseek(file, 0, SEEK_END) == 0 && (length = ftell(file)) > 0 && fseek(file, 0, SEEK_SET) == 0) {
+        mem = malloc((wfeSize) length);
+        if (mem != NULL && fread(mem, 1, (wfeSize) length, file) != (wfeSize) length) {
+            free(mem);
+            mem = NULL;
+        }
+
+        *size = mem != NULL ? (wfeSize) length : 0;
+    }
+
+    fclose(file);
+    return mem;
+#endif
+}
+
+void wfeVmemUnmapFile(wfeData *ptr, wfeSize size) {
+    assert(ptr != NULL /* range should be mapped */);
+
+#ifdef HAVE_UNISTD_H
+    munmap(ptr, size);
+#elif defined(_WINDOWS)
+    UnmapViewOfFile(ptr);
+#else
+    free(ptr);
+#endif
+}
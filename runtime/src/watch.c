@@ -0,0 +1,365 @@
+// poll, pipe and folder listing are not part of strict C11.
+#define _DEFAULT_SOURCE
+#include <wfe/watch.h>
+#include <wfe/cache.h>
+#include <wfe/asset.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <assert.h>
+
+#if defined(HAVE_UNISTD_H) && defined(__linux__)
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#define WFE_WATCH_INOTIFY
+#endif
+
+#ifdef WFE_WATCH_INOTIFY
+
+/**
+ * Joins two pieces of a path, skipping the separator when first piece is empty.
+ *
+ * Params:
+ *  - head of path.
+ *  - tail of path.
+ * Returns:
+ *  - Path allocated with malloc, NULL if no memory is available.
+ */
+static wfeChar *wfeWatchJoin(const wfeChar *head, const wfeChar *tail) {
+    wfeSize helen = strlen(head), talen = strlen(tail);
+    wfeChar *path = malloc(helen + talen + 2);
+    if (path == NULL)
+        return NULL;
+
+    if (helen == 0 || talen == 0)
+        sprintf(path, "%s%s", head, tail);
+    else
+        sprintf(path, "%s%s%s", head, WFE_FILE_SEPARATOR_STR, tail);
+
+    return path;
+}
+
+/**
+ * Watches a folder and, recursively, its subfolders.
+ *
+ * Params:
+ *  - watch owner of folders.
+ *  - relative path of folder from root, empty for root.
+ * Returns:
+ *  - WFE_TRUE if folder is watched, subfolders that could not be watched are skipped.
+ */
+static wfeBool wfeWatchAddFolder(wfeWatch *watch, const wfeChar *relative) {
+    wfeWatchFolder *folders;
+    wfeChar *full, *child;
+    struct dirent *item;
+    struct stat info;
+    DIR *dir;
+    int wd;
+
+    full = wfeWatchJoin(watch->root, relative);
+    if (full == NULL)
+        return WFE_FALSE;
+
+    wd = inotify_add_watch(watch->notify, full, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR);
+    if (wd < 0)
+        goto failed;
+
+    if (watch->folderCount == watch->folderCapacity) {
+        folders = realloc(watch->folders, sizeof(wfeWatchFolder) * (watch->folderCapacity * 2 + 16));
+        if (folders == NULL)
+            goto failed;
+
+        watch->folders = folders;
+        watch->folderCapacity = watch->folderCapacity * 2 + 16;
+    }
+
+    watch->folders[watch->folderCount].wd = wd;
+    watch->folders[watch->folderCount].path = wfeWatchJoin(relative, "");
+    if (watch->folders[watch->folderCount].path == NULL)
+        goto failed;
+
+    watch->folderCount++;
+    dir = opendir(full);
+    while (dir != NULL && (item = readdir(dir)) != NULL) {
+        if (strcmp(item->d_name, ".") == 0 || strcmp(item->d_name, "..") == 0)
+            continue;
+
+        child = wfeWatchJoin(full, item->d_name);
+        if (child != NULL && stat(child, &info) == 0 && S_ISDIR(info.st_mode)) {
+            free(child);
+            child = wfeWatchJoin(relative, item->d_name);
+            if (child != NULL)
+                wfeWatchAddFolder(watch, child);
+        }
+
+        free(child);
+    }
+
+    if (dir != NULL)
+        closedir(dir);
+
+    free(full);
+    return WFE_TRUE;
+
+failed:
+    free(full);
+    return WFE_FALSE;
+}
+
+/**
+ * Reads the new content of a changed file.
+ *
+ * Params:
+ *  - watch owner of root.
+ *  - change to fill, data is left NULL if file is gone or unable to read.
+ */
+static void wfeWatchRead(wfeWatch *watch, wfeWatchChange *change) {
+    wfeChar *full = wfeWatchJoin(watch->root, change->key);
+    FILE *file = full != NULL ? fopen(full, "rb") : NULL;
+    long length;
+
+    change->data = NULL;
+    change->size = 0L;
+    if (file != NULL && fseek(file, 0L, SEEK_END) == 0 && (length = ftell(file)) >= 0 && fseek(file, 0L, SEEK_SET) == 0) {
+        change->data = malloc(length > 0 ? (wfeSize) length : 1);
+        if (change->data != NULL && fread(change->data, 1, (wfeSize) length, file) != (wfeSize) length) {
+            free(change->data);
+            change->data = NULL;
+        }
+
+        change->size = change->data != NULL ? (wfeSize) length : 0L;
+    }
+
+    if (file != NULL)
+        fclose(file);
+
+    free(full);
+}
+
+// Releases a list of changes and their data.
+static void wfeWatchDrop(wfeWatchChange *change) {
+    wfeWatchChange *next;
+    for (; change != NULL; change = next) {
+        next = change->next;
+        free(change->data);
+        free(change);
+    }
+}
+
+/**
+ * Reads a burst of changes and hands them to pump, newer content of a file replaces the one
+ * waiting.
+ *
+ * Params:
+ *  - watch to publish on.
+ *  - pending changes of burst, keys only.
+ */
+static void wfeWatchPublish(wfeWatch *watch, wfeWatchChange *pending) {
+    wfeWatchChange *change, *next, *ready;
+
+    for (change = pending; change != NULL; change = change->next)
+        wfeWatchRead(watch, change);
+
+    mtx_lock(&watch->lock);
+    for (change = pending; change != NULL; change = next) {
+        next = change->next;
+        for (ready = watch->ready; ready != NULL && strcmp(ready->key, change->key) != 0; ready = ready->next);
+        if (ready != NULL) {
+            free(ready->data);
+            ready->data = change->data;
+            ready->size = change->size;
+            free(change);
+            continue;
+        }
+
+        change->next = watch->ready;
+        watch->ready = change;
+    }
+
+    mtx_unlock(&watch->lock);
+}
+
+/**
+ * Body of watcher thread, collects changed files until stopped.
+ *
+ * Params:
+ *  - arg watch running the loop.
+ * Returns:
+ *  - Zero always.
+ */
+static int wfeWatchRun(void *arg) {
+    wfeWatch *watch = (wfeWatch *) arg;
+    _Alignas(struct inotify_event) wfeChar buf[4096];
+    const struct inotify_event *event;
+    wfeWatchChange *pending = NULL, *change;
+    struct pollfd fds[2];
+    wfeChar *relative;
+    wfeSize i;
+    ssize_t length, offset;
+    int ready;
+
+    fds[0].fd = watch->notify;
+    fds[0].events = POLLIN;
+    fds[1].fd = watch->stop[0];
+    fds[1].events = POLLIN;
+    for (;;) {
+        // Without pending changes sleep until an event, otherwise until the burst settles.
+        ready = poll(fds, 2, pending != NULL ? WFE_WATCH_SETTLE_MS : -1);
+        if (ready < 0 && errno == EINTR)
+            continue;
+
+        if (ready < 0 || fds[1].revents != 0)
+            break;
+
+        if (ready == 0) {
+            wfeWatchPublish(watch, pending);
+            pending = NULL;
+            continue;
+        }
+
+        length = read(watch->notify, buf, sizeof(buf));
+        for (offset = 0; offset < length; offset += sizeof(struct inotify_event) + event->len) {
+            event = (const struct inotify_event *) (buf + offset);
+            for (i = 0; i < watch->folderCount && watch->folders[i].wd != event->wd; i++);
+            if (i == watch->folderCount || event->len == 0)
+                continue;
+
+            relative = wfeWatchJoin(watch->folders[i].path, event->name);
+            if (relative == NULL)
+                continue;
+
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                    wfeWatchAddFolder(watch, relative);
+            } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                for (change = pending; change != NULL && strcmp(change->key, relative) != 0; change = change->next);
+                if (change == NULL && (change = malloc(sizeof(wfeWatchChange) + strlen(relative) + 1)) != NULL) {
+                    change->key = (wfeChar *) (change + 1);
+                    strcpy(change->key, relative);
+                    change->data = NULL;
+                    change->size = 0L;
+                    change->next = pending;
+                    pending = change;
+                }
+            }
+
+            free(relative);
+        }
+    }
+
+    wfeWatchDrop(pending);
+    return 0;
+}
+
+// Releases folders and descriptors of a watch.
+static void wfeWatchClose(wfeWatch *watch) {
+    wfeSize i;
+    for (i = 0; i < watch->folderCount; i++)
+        free(watch->folders[i].path);
+
+    free(watch->folders);
+    free(watch->root);
+    close(watch->notify);
+    close(watch->stop[0]);
+    close(watch->stop[1]);
+}
+
+#endif
+
+wfeError wfeWatchInit(wfeWatch *watch, wfeCache *cache, const wfeChar *root) {
+    assert(watch != NULL /* watch must not be null */);
+    assert(cache != NULL /* cache must not be null */);
+
+#ifdef WFE_WATCH_INOTIFY
+    if (root == NULL)
+        root = wfeAssetGetSearchPath();
+
+    assert(root != NULL /* root or search path should be set */);
+    watch->cache = cache;
+    watch->folders = NULL;
+    watch->folderCount = 0;
+    watch->folderCapacity = 0;
+    watch->ready = NULL;
+    watch->root = wfeWatchJoin(root, "");
+    watch->notify = inotify_init1(IN_CLOEXEC);
+    if (watch->notify < 0) {
+        free(watch->root);
+        return WFE_WATCH_UNSUPPORTED;
+    }
+
+    if (pipe(watch->stop) != 0) {
+        free(watch->root);
+        close(watch->notify);
+        return WFE_WATCH_THREAD_ERROR;
+    }
+
+    if (watch->root == NULL || !wfeWatchAddFolder(watch, "")) {
+        wfeWatchClose(watch);
+        return WFE_WATCH_ACCESS_ERROR;
+    }
+
+    if (mtx_init(&watch->lock, mtx_plain) != thrd_success) {
+        wfeWatchClose(watch);
+        return WFE_WATCH_THREAD_ERROR;
+    }
+
+    if (thrd_create(&watch->thread, wfeWatchRun, watch) != thrd_success) {
+        mtx_destroy(&watch->lock);
+        wfeWatchClose(watch);
+        return WFE_WATCH_THREAD_ERROR;
+    }
+
+    return WFE_SUCCESS;
+#else
+    watch->cache = cache;
+    watch->ready = NULL;
+    return WFE_WATCH_UNSUPPORTED;
+#endif
+}
+
+void wfeWatchFinalize(wfeWatch *watch) {
+    assert(watch != NULL /* watch must not be null */);
+
+#ifdef WFE_WATCH_INOTIFY
+    if (write(watch->stop[1], "", 1) == 1)
+        thrd_join(watch->thread, NULL);
+
+    wfeWatchDrop(watch->ready);
+    watch->ready = NULL;
+    mtx_destroy(&watch->lock);
+    wfeWatchClose(watch);
+#endif
+}
+
+wfeSize wfeWatchPump(wfeWatch *watch) {
+    wfeSize replaced = 0;
+    assert(watch != NULL /* watch must not be null */);
+
+#ifdef WFE_WATCH_INOTIFY
+    wfeWatchChange *change, *next;
+    wfeError status;
+
+    mtx_lock(&watch->lock);
+    change = watch->ready;
+    watch->ready = NULL;
+    mtx_unlock(&watch->lock);
+
+    for (; change != NULL; change = next) {
+        next = change->next;
+        status = change->data != NULL ? wfeCacheReplace(watch->cache, change->key, change->data, change->size) : WFE_HASHMAP_MISSING;
+        if (status != WFE_HASHMAP_MISSING && status != WFE_CACHE_OMEM) {
+            replaced++;
+            change->data = NULL; // Owned by cache now
+        }
+
+        free(change->data);
+        free(change);
+    }
+#endif
+
+    return replaced;
+}
@@ -63,7 +63,7 @@ finalize:
     return status;
 }
 
-void wfeHashmapDestroy(wfeHashmap* hashmap) {
+void wfeHashmapFinalize(wfeHashmap* hashmap) {
     if (hashmap->data != NULL) {
         free(hashmap->data);
         hashmap->data = NULL;
@@ -110,11 +110,13 @@ wfeError wfeHashmapPut(wfeHashmap* hashmap, const wfeData *key, wfeAny item) {
         status = wfeHashmapHash(hashmap, key, &index);
     }
 
-    /* Set the data */
+    /* Set the data, replacing an existing key does not grow the map */
+    if (hashmap->data[index].inuse == 0)
+        hashmap->size++;
+
     hashmap->data[index].data = item;
     hashmap->data[index].key = key;
     hashmap->data[index].inuse = 1;
-    hashmap->size++;
 
     return WFE_SUCCESS;
 }
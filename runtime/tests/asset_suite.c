@@ -2,8 +2,13 @@
 #include <wfe/asset.h>
 #include <wfe/pool.h>
 #include <wfe/desc.h>
+#include <wfe/vmem.h>
 #include <string.h>
 
+#ifdef HAVE_UNISTD_H
+#include <sys/stat.h>
+#endif
+
 static char * test_asset_load_raw() {
     wfePool pool;
     wfeError code = WFE_SUCCESS;
@@ -23,6 +28,284 @@ static char * test_asset_load_raw() {
     return 0;
 }
 
+static char * test_asset_map_raw() {
+    wfePool pool;
+    wfeAssetMapping mapping;
+    wfeError code = WFE_SUCCESS;
+
+    code = wfePoolInit(&pool);
+    mu_assert("could not init pool", !WFE_HAVE_FAILED(code));
+
+    code = wfeAssetMapRaw("test_asset_load_raw", ".txt", &pool, WFE_VMEM_SEQUENTIAL, &mapping);
+    mu_assert("could not map test_asset_load_raw.txt", !WFE_HAVE_FAILED(code));
+    mu_assert("did not map any data from asset", mapping.size == strlen("this is plain text\n"));
+    mu_assert("wrong data from asset", strncmp(mapping.data, "this is plain text", 18) == 0);
+
+    wfeAssetUnmapRaw(&mapping);
+    mu_assert("unmap should clear mapping", mapping.data == NULL && mapping.size == 0L);
+
+    code = wfeAssetMapRaw("test_asset_missing", ".txt", &pool, WFE_VMEM_NORMAL, &mapping);
+    mu_assert("missing asset should not be mapped", code == WFE_ASSET_FILE_ACCESS_ERROR && mapping.data == NULL);
+
+    wfePoolFinalize(&pool);
+    return 0;
+}
+
+static char * test_asset_load_batch() {
+    wfeAssetBatchItem items[4] = {
+        {"test_asset_load_raw", ".txt"},
+        {"test_asset_missing", ".txt"},
+        {"test_asset_load_desc", ".desc"},
+        {"test_asset_load_raw", ".txt"},
+    };
+    wfeUint32 flags[2] = {0, WFE_ASSET_BATCH_NO_URING};
+    wfePool pool;
+    wfeSize i;
+
+    for (i = 0; i < 2; i++) {
+        mu_assert("could not init pool", !WFE_HAVE_FAILED(wfePoolInit(&pool)));
+        mu_assert("missing asset should be reported", wfeAssetLoadBatch(items, 4, &pool, flags[i]) == WFE_ASSET_FILE_ACCESS_ERROR);
+        mu_assert("missing asset should fail alone", items[1].status == WFE_ASSET_FILE_ACCESS_ERROR && items[1].data == NULL);
+        mu_assert("could not load first asset", items[0].status == WFE_SUCCESS && items[0].size == strlen("this is plain text\n"));
+        mu_assert("wrong data from first asset", strncmp(items[0].data, "this is plain text", 18) == 0);
+        mu_assert("could not load last asset", items[3].status == WFE_SUCCESS && strncmp(items[3].data, "this is plain text", 18) == 0);
+        mu_assert("could not load desc asset", items[2].status == WFE_SUCCESS && items[2].size > 0);
+        wfePoolFinalize(&pool);
+    }
+
+    return 0;
+}
+
+static char * test_asset_pack() {
+    const wfeChar *names[2] = {"test_asset_load_raw.txt", "test_asset_load_desc.desc"};
+    wfeAssetBatchItem items[2] = {{"test_asset_load_desc", ".desc"}, {"test_asset_load_raw", ".txt"}};
+    wfeChar *searchPath = getenv("WFE_SEARCH_PATH") != NULL ? getenv("WFE_SEARCH_PATH") : "tests/assets";
+    const wfeData *data;
+    wfeChar path[256];
+    wfeSize size;
+    wfePool pool;
+
+    mu_assert("could not init pool", !WFE_HAVE_FAILED(wfePoolInit(&pool)));
+    mu_assert("could not write pack", wfeAssetPackWrite("test_asset.pack", searchPath, names, 2, 0, &pool) == WFE_SUCCESS);
+    mu_assert("pack writer should report missing files",
+              wfeAssetPackWrite("test_asset_missing.pack", searchPath, (const wfeChar **) &items[0].name, 1, 0, &pool) == WFE_ASSET_FILE_ACCESS_ERROR);
+    remove("test_asset_missing.pack");
+
+    snprintf(path, sizeof(path), "%s/test_asset_load_raw.txt", searchPath);
+    mu_assert("files should not be mounted as packs", wfeAssetMountPack(path) == WFE_ASSET_PACK_INVALID);
+    mu_assert("could not mount pack", wfeAssetMountPack("test_asset.pack") == WFE_SUCCESS);
+
+    // Only the pack can serve assets from now on.
+    wfeAssetSetSearchPath("tests/missing");
+    mu_assert("could not load asset from pack", wfeAssetLoadRaw("test_asset_load_raw", ".txt", &pool, &data, &size) == WFE_SUCCESS);
+    mu_assert("wrong data from pack", size == strlen("this is plain text\n") && strncmp(data, "this is plain text", 18) == 0);
+    mu_assert("assets out of pack should fail", wfeAssetLoadRaw("test_asset_missing", ".txt", &pool, &data, &size) == WFE_ASSET_FILE_ACCESS_ERROR);
+    mu_assert("could not load batch from pack", wfeAssetLoadBatch(items, 2, &pool, 0) == WFE_SUCCESS);
+    mu_assert("wrong data from pack batch", items[1].size == strlen("this is plain text\n") && strncmp(items[1].data, "this is plain text", 18) == 0);
+
+    wfeAssetUnmountPacks();
+    mu_assert("unmounted packs should not serve assets", wfeAssetLoadRaw("test_asset_load_raw", ".txt", &pool, &data, &size) == WFE_ASSET_FILE_ACCESS_ERROR);
+    wfeAssetSetSearchPath(searchPath);
+    remove("test_asset.pack");
+    wfePoolFinalize(&pool);
+    return 0;
+}
+
+static char * test_asset_pack_compressed() {
+    const wfeChar *names[2] = {"test_asset_big.txt", "test_asset_small.txt"};
+    wfeAssetPackReport before, after;
+    const wfeData *data;
+    wfeChar *content;
+    wfeSize size, length, i, workers;
+    wfePool pool;
+    FILE *file;
+
+    // Several chunks of text-like data, and a tiny file that does not shrink.
+    content = malloc(1 << 20);
+    mu_assert("could not allocate content", content != NULL);
+    for (length = 0, i = 0; length + 32 < (1 << 20); i++)
+        length += (wfeSize) sprintf(content + length, "entity %zu at %zu\n", i % 977, i);
+
+    file = fopen("test_asset_big.txt", "wb");
+    mu_assert("could not write big file", file != NULL && fwrite(content, 1, length, file) == length);
+    fclose(file);
+    file = fopen("test_asset_small.txt", "wb");
+    mu_assert("could not write small file", file != NULL && fwrite("xyz", 1, 3, file) == 3);
+    fclose(file);
+
+    mu_assert("could not init pool", !WFE_HAVE_FAILED(wfePoolInit(&pool)));
+    mu_assert("could not write compressed pack", wfeAssetPackWrite("test_asset_z.pack", ".", names, 2, 6, &pool) == WFE_SUCCESS);
+    remove("test_asset_big.txt");
+    remove("test_asset_small.txt");
+    mu_assert("could not mount compressed pack", wfeAssetMountPack("test_asset_z.pack") == WFE_SUCCESS);
+    mu_assert("too many inflate workers should fail", wfeAssetSetInflateWorkers(WFE_ASSET_MAX_INFLATE_WORKERS + 1) == WFE_ASSET_INFLATE_COUNT);
+
+    for (workers = 0; workers <= 2; workers += 2) {
+        mu_assert("could not start inflate workers", wfeAssetSetInflateWorkers(workers) == WFE_SUCCESS);
+        wfeAssetPackStats(&before);
+        mu_assert("could not load compressed asset", wfeAssetLoadRaw("test_asset_big", ".txt", &pool, &data, &size) == WFE_SUCCESS);
+        mu_assert("wrong data from compressed asset", size == length && memcmp(data, content, length) == 0);
+        mu_assert("could not load stored asset", wfeAssetLoadRaw("test_asset_small", ".txt", &pool, &data, &size) == WFE_SUCCESS);
+        mu_assert("wrong data from stored asset", size == 3 && memcmp(data, "xyz", 3) == 0);
+        wfeAssetPackStats(&after);
+        mu_assert("only compressed entries should be counted", after.entries == before.entries + 1 && after.size == before.size + length);
+        mu_assert("entry should be compressed", after.stored - before.stored < length / 2);
+    }
+
+    mu_assert("could not stop inflate workers", wfeAssetSetInflateWorkers(0) == WFE_SUCCESS);
+    wfeAssetUnmountPacks();
+    remove("test_asset_z.pack");
+    wfePoolFinalize(&pool);
+    free(content);
+    return 0;
+}
+
+static wfeBool asset_write(const wfeChar *path, const wfeChar *content) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+        return WFE_FALSE;
+
+    fputs(content, file);
+    return fclose(file) == 0;
+}
+
+static char * test_asset_search_roots() {
+    wfeAssetBatchItem items[3] = {{"level/door", ".txt"}, {"level/wall", ".txt"}, {"level/missing", ".txt"}};
+    const wfeData *data;
+    wfeSize size;
+    wfePool pool;
+
+#ifdef HAVE_UNISTD_H
+    mkdir("test_roots_base", 0755);
+    mkdir("test_roots_base/level", 0755);
+    mkdir("test_roots_mods", 0755);
+    mkdir("test_roots_mods/level", 0755);
+#endif
+    mu_assert("could not write base door", asset_write("test_roots_base/level/door.txt", "base door"));
+    mu_assert("could not write base wall", asset_write("test_roots_base/level/wall.txt", "base wall"));
+    mu_assert("could not write mod door", asset_write("test_roots_mods/level/door.txt", "mod door"));
+
+    mu_assert("missing roots should fail", wfeAssetAddSearchRoot("test_roots_missing") == WFE_ASSET_FILE_ACCESS_ERROR);
+    mu_assert("could not add base root", wfeAssetAddSearchRoot("test_roots_base") == WFE_SUCCESS);
+    mu_assert("could not add mods root", wfeAssetAddSearchRoot("test_roots_mods/") == WFE_SUCCESS);
+    mu_assert("could not init pool", !WFE_HAVE_FAILED(wfePoolInit(&pool)));
+
+    // Later roots win, the rest comes from older ones.
+    mu_assert("could not load overridden asset", wfeAssetLoadRaw("level/door", ".txt", &pool, &data, &size) == WFE_SUCCESS);
+    mu_assert("newer root should override", size == 8 && strncmp(data, "mod door", 8) == 0);
+    mu_assert("could not load base asset", wfeAssetLoadRaw("level/wall", ".txt", &pool, &data, &size) == WFE_SUCCESS);
+    mu_assert("wrong data from base root", size == 9 && strncmp(data, "base wall", 9) == 0);
+
+    // Index is a snapshot, files out of it are missing without probing.
+    mu_assert("could not write late file", asset_write("test_roots_base/level/late.txt", "late"));
+    mu_assert("files after scan should be missing", wfeAssetLoadRaw("level/late", ".txt", &pool, &data, &size) == WFE_ASSET_FILE_ACCESS_ERROR);
+    mu_assert("search path should not be used", wfeAssetLoadRaw("test_asset_load_raw", ".txt", &pool, &data, &size) == WFE_ASSET_FILE_ACCESS_ERROR);
+
+    mu_assert("missing batch item should be reported", wfeAssetLoadBatch(items, 3, &pool, 0) == WFE_ASSET_FILE_ACCESS_ERROR);
+    mu_assert("wrong batch from roots", items[0].status == WFE_SUCCESS && strncmp(items[0].data, "mod door", 8) == 0 &&
+              items[1].status == WFE_SUCCESS && items[2].status == WFE_ASSET_FILE_ACCESS_ERROR);
+
+    wfeAssetClearSearchRoots();
+    mu_assert("search path should be back", wfeAssetLoadRaw("test_asset_load_raw", ".txt", &pool, &data, &size) == WFE_SUCCESS);
+    wfePoolFinalize(&pool);
+    remove("test_roots_base/level/door.txt");
+    remove("test_roots_base/level/wall.txt");
+    remove("test_roots_base/level/late.txt");
+    remove("test_roots_mods/level/door.txt");
+    remove("test_roots_base/level");
+    remove("test_roots_mods/level");
+    remove("test_roots_base");
+    remove("test_roots_mods");
+    return 0;
+}
+
+typedef struct asset_stream_sink {
+    wfeChar data[256];
+    wfeSize size;
+    wfeSize calls;
+    wfeSize stopAfter; // Calls before returning WFE_DONE, zero never stops
+    wfeBool ordered;
+} asset_stream_sink;
+
+static wfeError asset_stream_collect(const wfeData *chunk, wfeSize size, wfeSize offset, wfeAny userdata) {
+    asset_stream_sink *sink = (asset_stream_sink *) userdata;
+    sink->ordered = sink->ordered && offset == sink->size && sink->size + size <= sizeof(sink->data);
+    if (sink->ordered) {
+        memcpy(sink->data + sink->size, chunk, size);
+        sink->size += size;
+    }
+
+    sink->calls++;
+    return sink->calls == sink->stopAfter ? WFE_DONE : WFE_CONTINUE;
+}
+
+static wfeError asset_stream_fail(const wfeData *chunk, wfeSize size, wfeSize offset, wfeAny userdata) {
+    return WFE_DID_NOT_READ_ALL_FILE;
+}
+
+static char * test_asset_stream_raw() {
+    asset_stream_sink sink = {.ordered = WFE_TRUE};
+    const wfeData *data;
+    wfeSize size;
+    wfePool pool;
+
+    mu_assert("could not init pool", !WFE_HAVE_FAILED(wfePoolInit(&pool)));
+    mu_assert("could not load asset", wfeAssetLoadRaw("test_asset_load_raw", ".txt", &pool, &data, &size) == WFE_SUCCESS);
+    mu_assert("asset should span several chunks", size > 7 * 2);
+
+    // Small chunks and ring force the reader to wait for the consumer.
+    mu_assert("could not stream asset", wfeAssetStreamRaw("test_asset_load_raw", ".txt", &pool, 7, 2, asset_stream_collect, &sink) == WFE_SUCCESS);
+    mu_assert("chunks out of order", sink.ordered);
+    mu_assert("wrong streamed data", sink.size == size && memcmp(sink.data, data, size) == 0);
+    mu_assert("wrong count of chunks", sink.calls == (size + 6) / 7);
+
+    memset(&sink, 0, sizeof(sink));
+    sink.ordered = WFE_TRUE;
+    sink.stopAfter = 2;
+    mu_assert("done should stop stream", wfeAssetStreamRaw("test_asset_load_raw", ".txt", &pool, 3, 4, asset_stream_collect, &sink) == WFE_SUCCESS);
+    mu_assert("stream should stop after done", sink.calls == 2 && sink.size == 6);
+
+    mu_assert("callback failure should bubble", wfeAssetStreamRaw("test_asset_load_raw", ".txt", &pool, 7, 2, asset_stream_fail, NULL) == WFE_DID_NOT_READ_ALL_FILE);
+    mu_assert("missing asset should fail", wfeAssetStreamRaw("test_asset_missing", ".txt", &pool, 7, 2, asset_stream_collect, &sink) == WFE_ASSET_FILE_ACCESS_ERROR);
+
+    wfePoolFinalize(&pool);
+    return 0;
+}
+
+static char * test_asset_manifest() {
+    const wfeData *data;
+    wfeSize size;
+    wfePool pool;
+    wfeChar line[256];
+    FILE *file;
+
+    remove("test_asset_manifest.txt");
+    mu_assert("could not init pool", !WFE_HAVE_FAILED(wfePoolInit(&pool)));
+    mu_assert("missing manifest should fail", wfeAssetManifestPrefetch("test_asset_manifest.txt") == WFE_ASSET_FILE_ACCESS_ERROR);
+    mu_assert("could not record manifest", wfeAssetManifestRecord("test_asset_manifest.txt") == WFE_SUCCESS);
+    mu_assert("could not load first asset", wfeAssetLoadRaw("test_asset_load_raw", ".txt", &pool, &data, &size) == WFE_SUCCESS);
+    mu_assert("could not load second asset", wfeAssetLoadRaw("test_asset_load_desc", ".desc", &pool, &data, &size) == WFE_SUCCESS);
+    mu_assert("could not load first asset again", wfeAssetLoadRaw("test_asset_load_raw", ".txt", &pool, &data, &size) == WFE_SUCCESS);
+    mu_assert("could not write manifest", wfeAssetManifestFinish() == WFE_SUCCESS);
+    mu_assert("loads after finish should not be recorded", wfeAssetLoadRaw("test_game_glfw", ".desc", &pool, &data, &size) == WFE_SUCCESS);
+
+    // Only first accesses, in order.
+    file = fopen("test_asset_manifest.txt", "r");
+    mu_assert("manifest should exists", file != NULL);
+    mu_assert("wrong first entry", fgets(line, sizeof(line), file) != NULL && strstr(line, " test_asset_load_raw.txt\n") != NULL);
+    mu_assert("wrong second entry", fgets(line, sizeof(line), file) != NULL && strstr(line, " test_asset_load_desc.desc\n") != NULL);
+    mu_assert("manifest should have two entries", fgets(line, sizeof(line), file) == NULL);
+    fclose(file);
+
+    mu_assert("could not prefetch manifest", wfeAssetManifestPrefetch("test_asset_manifest.txt") == WFE_SUCCESS);
+    mu_assert("every asset should be prefetched", wfeAssetManifestEndPrefetch(WFE_FALSE) == 2);
+    mu_assert("ended prefetch should do nothing", wfeAssetManifestEndPrefetch(WFE_TRUE) == 0);
+
+    wfePoolFinalize(&pool);
+    remove("test_asset_manifest.txt");
+    return 0;
+}
+
 static char * test_asset_load_desc() {
     wfePool pool;
     wfeError code = WFE_SUCCESS;
@@ -59,6 +342,13 @@ static char * asset_suite() {
 
     mu_suite_start(asset);
     mu_run_test(test_asset_load_raw);
+    mu_run_test(test_asset_map_raw);
+    mu_run_test(test_asset_load_batch);
+    mu_run_test(test_asset_pack);
+    mu_run_test(test_asset_pack_compressed);
+    mu_run_test(test_asset_search_roots);
+    mu_run_test(test_asset_stream_raw);
+    mu_run_test(test_asset_manifest);
     mu_run_test(test_asset_load_desc);
     mu_suite_end(asset);
     return 0;
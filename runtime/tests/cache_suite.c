@@ -0,0 +1,133 @@
+#include "minunit.h"
+#include <wfe/cache.h>
+#include <wfe/asset.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char * test_cache_acquire_release() {
+    wfeCacheEntry *first, *second;
+    wfeCacheStats stats;
+    wfeCache cache;
+
+    mu_assert("could not init cache", wfeCacheInit(&cache, 1024) == WFE_SUCCESS);
+    mu_assert("could not acquire asset", wfeCacheAcquire(&cache, "test_asset_load_raw", ".txt", &first) == WFE_SUCCESS);
+    mu_assert("wrong data from cache", first->size == strlen("this is plain text\n") && strncmp(first->data, "this is plain text", 18) == 0);
+    mu_assert("could not acquire asset again", wfeCacheAcquire(&cache, "test_asset_load_raw", ".txt", &second) == WFE_SUCCESS);
+    mu_assert("entries should be shared", first == second && first->refs == 2);
+    mu_assert("missing asset should fail", wfeCacheAcquire(&cache, "test_asset_missing", ".txt", &second) == WFE_ASSET_FILE_ACCESS_ERROR && second == NULL);
+
+    wfeCacheReadStats(&cache, &stats);
+    mu_assert("wrong hits and misses", stats.hits == 1 && stats.misses == 2 && stats.evictions == 0);
+    mu_assert("wrong size of cache", stats.entries == 1 && stats.bytes == first->size);
+
+    // Entries within budget stay after their last release.
+    wfeCacheRelease(&cache, first);
+    wfeCacheRelease(&cache, first);
+    mu_assert("could not acquire released asset", wfeCacheAcquire(&cache, "test_asset_load_raw", ".txt", &second) == WFE_SUCCESS);
+    wfeCacheReadStats(&cache, &stats);
+    mu_assert("released entry should hit", second == first && stats.hits == 2 && stats.misses == 2);
+
+    wfeCacheRelease(&cache, second);
+    wfeCacheFinalize(&cache);
+    return 0;
+}
+
+static char * test_cache_budget() {
+    wfeCacheEntry *raw, *desc;
+    wfeCacheStats stats;
+    wfeCache cache;
+
+    mu_assert("could not init cache", wfeCacheInit(&cache, 0) == WFE_SUCCESS);
+    mu_assert("could not acquire raw asset", wfeCacheAcquire(&cache, "test_asset_load_raw", ".txt", &raw) == WFE_SUCCESS);
+    mu_assert("could not acquire desc asset", wfeCacheAcquire(&cache, "test_asset_load_desc", ".desc", &desc) == WFE_SUCCESS);
+
+    // Referenced entries are kept over budget.
+    wfeCacheReadStats(&cache, &stats);
+    mu_assert("referenced entries should not be evicted", stats.entries == 2 && stats.evictions == 0);
+
+    wfeCacheRelease(&cache, raw);
+    wfeCacheReadStats(&cache, &stats);
+    mu_assert("released entry should be evicted", stats.entries == 1 && stats.evictions == 1 && stats.bytes == desc->size);
+
+    // Least recently released goes first.
+    wfeCacheSetBudget(&cache, desc->size * 2);
+    wfeCacheRelease(&cache, desc);
+    mu_assert("could not acquire raw asset again", wfeCacheAcquire(&cache, "test_asset_load_raw", ".txt", &raw) == WFE_SUCCESS);
+    wfeCacheRelease(&cache, raw);
+    wfeCacheSetBudget(&cache, raw->size);
+    wfeCacheReadStats(&cache, &stats);
+    mu_assert("oldest entry should be evicted", stats.entries == 1 && stats.evictions == 2 && stats.bytes == raw->size);
+    mu_assert("could not acquire kept asset", wfeCacheAcquire(&cache, "test_asset_load_raw", ".txt", &raw) == WFE_SUCCESS);
+    wfeCacheReadStats(&cache, &stats);
+    mu_assert("kept entry should hit", stats.hits == 1 && stats.misses == 3);
+
+    wfeCacheRelease(&cache, raw);
+    wfeCacheFinalize(&cache);
+    return 0;
+}
+
+static char * test_cache_acquire_desc() {
+    wfeCacheEntry *first, *second;
+    wfeDesc desc, other;
+    const wfeChar *key;
+    wfeSize keysize;
+    wfeCache cache;
+
+    mu_assert("could not init cache", wfeCacheInit(&cache, 4096) == WFE_SUCCESS);
+    mu_assert("could not acquire desc", wfeCacheAcquireDesc(&cache, "test_asset_load_desc", &first, &desc) == WFE_SUCCESS);
+    mu_assert("could not read key", wfeDescNextKey(&desc, &key, &keysize) == WFE_SUCCESS);
+    mu_assert("could not acquire desc again", wfeCacheAcquireDesc(&cache, "test_asset_load_desc", &second, &other) == WFE_SUCCESS);
+    mu_assert("desc entries should be shared", first == second && first->decoded);
+    mu_assert("holders should have their own cursor", other.currentKey == 0 && desc.currentKey == 1);
+
+    wfeCacheRelease(&cache, first);
+    wfeCacheRelease(&cache, second);
+    wfeCacheFinalize(&cache);
+    return 0;
+}
+
+static char * test_cache_replace_held() {
+    wfeCacheEntry *entry;
+    const wfeData *held;
+    const wfeChar *key;
+    wfeSize keysize, size;
+    wfeData *data;
+    wfeDesc desc;
+    wfeCache cache;
+
+    mu_assert("could not init cache", wfeCacheInit(&cache, 4096) == WFE_SUCCESS);
+    mu_assert("could not acquire desc", wfeCacheAcquireDesc(&cache, "test_asset_load_desc", &entry, &desc) == WFE_SUCCESS);
+    held = entry->data;
+    size = entry->size;
+    data = malloc(size);
+    mu_assert("unexpected null pointer", data != NULL);
+    memcpy(data, held, size);
+
+    // Holder keeps reading the previous data and tree until it releases the entry.
+    mu_assert("could not replace", wfeCacheReplace(&cache, "test_asset_load_desc.desc", data, size) == WFE_SUCCESS);
+    mu_assert("entry should hold new data", entry->data == data && entry->version == 1 && entry->decoded);
+    mu_assert("held data should stay valid", memcmp(held, data, size) == 0);
+    mu_assert("held desc should stay valid", wfeDescNextKey(&desc, &key, &keysize) == WFE_SUCCESS && keysize > 0);
+    mu_assert("old generation should wait for release", entry->retired != NULL);
+
+    wfeCacheRelease(&cache, entry);
+    mu_assert("release should drop old generation", entry->retired == NULL);
+    wfeCacheFinalize(&cache);
+    return 0;
+}
+
+static char * cache_suite() {
+    char *envsp = getenv("WFE_SEARCH_PATH");
+    if (envsp != NULL)
+        wfeAssetSetSearchPath(envsp);
+    else
+        wfeAssetSetSearchPath("tests/assets");
+
+    mu_suite_start(cache);
+    mu_run_test(test_cache_acquire_release);
+    mu_run_test(test_cache_budget);
+    mu_run_test(test_cache_acquire_desc);
+    mu_run_test(test_cache_replace_held);
+    mu_suite_end(cache);
+    return 0;
+}
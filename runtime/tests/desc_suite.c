@@ -1,6 +1,7 @@
 #include "minunit.h"
 #include <lmath/mathutil.h>
 #include <wfe/desc.h>
+#include <wfe/pool.h>
 #include <msgpack.h>
 #include <string.h>
 
@@ -53,6 +54,39 @@ static char * test_desc_decode_buffer_nomap() {
     return 0;
 }
 
+static char * test_desc_decode_buffer_pool() {
+    wfeDesc desc;
+    wfePool pool;
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+
+    mu_assert("could not initialize pool", !WFE_HAVE_FAILED(wfePoolInit(&pool)));
+    mu_assert("could not initialize desc", !WFE_HAVE_FAILED(wfeDescInit(&desc)));
+    populate_sbuffer_valid(&sbuf);
+
+    mu_assert("failed buffer decode", !WFE_HAVE_FAILED(wfeDescDecodeBufferPool(&desc, &pool, sbuf.data, sbuf.size)));
+    mu_assert("haveMap is makerd as false when its expected to be true", desc.haveMap == WFE_TRUE);
+    mu_assert("no zone should be allocated for pool decode", desc.result.zone == NULL);
+    mu_assert("object tree should be on pool", wfePoolTotalSize(&pool) > 0);
+
+    const wfeData *key = NULL;
+    wfeSize ksize = 0L;
+    wfeInt value = 0;
+    mu_assert("cannot access first key", WFE_SHOULD_CONTINUE(wfeDescNextKey(&desc, &key, &ksize)));
+    mu_assert("first key is not myint", strncmp("myint", key, ksize) == 0);
+    mu_assert("cannot read int value", !WFE_HAVE_FAILED(wfeDescGetInt(&desc, &value)));
+    mu_assert("read value does not match with populated value", 3241 == value);
+
+    // Truncated buffers are rejected before touching the pool.
+    mu_assert("no failure reported after decoding a truncated buffer",
+            wfeDescDecodeBufferPool(&desc, &pool, sbuf.data, sbuf.size - 1) == WFE_DESC_MSGPACK_ERROR);
+
+    wfeDescFinalize(&desc);
+    wfePoolFinalize(&pool);
+    msgpack_sbuffer_destroy(&sbuf);
+    return 0;
+}
+
 static char * test_desc_next_key() {
     wfeDesc desc;
     msgpack_sbuffer okbuf;
@@ -185,6 +219,7 @@ static char * desc_suite() {
     mu_run_test(test_desc_init_finalize);
     mu_run_test(test_desc_decode_buffer);
     mu_run_test(test_desc_decode_buffer_nomap);
+    mu_run_test(test_desc_decode_buffer_pool);
     mu_run_test(test_desc_next_key);
     mu_run_test(test_desc_get_int);
     mu_run_test(test_desc_get_num);
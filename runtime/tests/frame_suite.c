@@ -0,0 +1,121 @@
+#include "minunit.h"
+#include <wfe/frame.h>
+#include <wfe/pool.h>
+
+// Counts waited fences, checking they are waited in submission order.
+static void frame_count_fence(wfeAny fence, wfeAny userdata) {
+    wfeSize *waited = (wfeSize *) userdata;
+    if ((wfeSize) fence == *waited + 1)
+        *waited += 1;
+}
+
+// Fake GPU fence, marks the frame as consumed once waited.
+typedef struct frame_fake_fence {
+    wfeBool waited;
+} frame_fake_fence;
+
+static void frame_wait_fake_fence(wfeAny fence, wfeAny userdata) {
+    (void) userdata;
+    ((frame_fake_fence *) fence)->waited = WFE_TRUE;
+}
+
+static char * test_frame_init_finalize() {
+    wfeFrameAllocator frames;
+    mu_assert("should reject zero frames", wfeFrameInit(&frames, 0) == WFE_FRAME_INVALID_COUNT);
+    mu_assert("should reject too many frames", wfeFrameInit(&frames, WFE_FRAME_MAX_POOLS + 1) == WFE_FRAME_INVALID_COUNT);
+    mu_assert("could not init frames", wfeFrameInit(&frames, 2) == WFE_SUCCESS);
+
+    wfeFrameFinalize(&frames);
+    mu_assert("should not reference pools after finalize", frames.count == 0);
+    return 0;
+}
+
+static char * test_frame_rotation() {
+    wfeFrameAllocator frames;
+    wfeData *d1 = NULL, *d2 = NULL, *d3 = NULL;
+    mu_assert("could not init frames", wfeFrameInit(&frames, 2) == WFE_SUCCESS);
+
+    wfeFrameBegin(&frames);
+    d1 = wfeFrameGet(&frames, sizeof(wfeInt64), wfeAlignOf(wfeInt64));
+    mu_assert("unexpected null pointer (d1 request)", d1 != NULL);
+    wfeFrameEnd(&frames, NULL);
+
+    wfeFrameBegin(&frames);
+    d2 = wfeFrameGet(&frames, sizeof(wfeInt64), wfeAlignOf(wfeInt64));
+    mu_assert("unexpected null pointer (d2 request)", d2 != NULL);
+    mu_assert("frames in flight should not share memory", d1 != d2);
+    mu_assert("frame pool should serve current frame", wfeFramePool(&frames) == &frames.pools[1]);
+    wfeFrameEnd(&frames, NULL);
+
+    wfeFrameBegin(&frames);
+    d3 = wfeFrameGet(&frames, sizeof(wfeInt64), wfeAlignOf(wfeInt64));
+    mu_assert("oldest frame should have been recycled", d3 == d1);
+    mu_assert("unexpected frame count", frames.frame == 3);
+    wfeFrameEnd(&frames, NULL);
+
+    wfeFrameFinalize(&frames);
+    return 0;
+}
+
+static char * test_frame_fences() {
+    wfeFrameAllocator frames;
+    wfeSize waited = 0, i;
+    mu_assert("could not init frames", wfeFrameInit(&frames, 3) == WFE_SUCCESS);
+    wfeFrameSetFence(&frames, frame_count_fence, &waited);
+
+    for (i = 1; i <= 5; i++) {
+        wfeFrameBegin(&frames);
+        wfeFrameEnd(&frames, (wfeAny) i);
+    }
+
+    // Three frames in flight, only the two oldest fences have been waited.
+    mu_assert("unexpected waited fences", waited == 2);
+
+    wfeFrameFinalize(&frames);
+    mu_assert("finalize should wait pending fences", waited == 5);
+    return 0;
+}
+
+static char * test_frame_game_loop() {
+    frame_fake_fence fences[4] = {{WFE_FALSE}, {WFE_FALSE}, {WFE_FALSE}, {WFE_FALSE}};
+    wfeFrameAllocator frames;
+    wfeInt64 *data[4];
+    wfeSize i;
+    mu_assert("could not init frames", wfeFrameInit(&frames, 2) == WFE_SUCCESS);
+    wfeFrameSetFence(&frames, frame_wait_fake_fence, NULL);
+
+    // Same order as a game loop: begin, transient data, fence at end of frame.
+    for (i = 0; i < 4; i++) {
+        wfeFrameBegin(&frames);
+        if (i >= 2) {
+            mu_assert("frame should wait fence of its pool", fences[i - 2].waited);
+            mu_assert("newer fence should not be waited", !fences[i - 1].waited);
+        }
+
+        data[i] = (wfeInt64 *) wfeFrameGet(&frames, sizeof(wfeInt64), wfeAlignOf(wfeInt64));
+        mu_assert("unexpected null pointer", data[i] != NULL);
+        *data[i] = (wfeInt64) i;
+        if (i >= 1)
+            mu_assert("frame in flight should keep its data", *data[i - 1] == (wfeInt64) i - 1);
+
+        if (i >= 2)
+            mu_assert("pool should be reused once its fence passed", data[i] == data[i - 2]);
+
+        wfeFrameEnd(&frames, &fences[i]);
+    }
+
+    wfeFrameFinalize(&frames);
+    mu_assert("finalize should wait frames in flight", fences[2].waited && fences[3].waited);
+    return 0;
+}
+
+static char * frame_suite() {
+    mu_suite_start(frame);
+    mu_run_test(test_frame_init_finalize);
+    mu_run_test(test_frame_rotation);
+    mu_run_test(test_frame_fences);
+    mu_run_test(test_frame_game_loop);
+    mu_suite_end(frame);
+    return 0;
+}
+
@@ -0,0 +1,87 @@
+#include "minunit.h"
+#include <wfe/loader.h>
+#include <wfe/asset.h>
+#include <wfe/pool.h>
+#include <string.h>
+
+typedef struct loader_results {
+    wfeSize loaded;
+    wfeSize failed;
+    wfeBool content;
+} loader_results;
+
+static void loader_collect(wfeLoaderTicket ticket, wfeError status, const wfeData *data, wfeSize size, wfeAny userdata) {
+    loader_results *results = (loader_results *) userdata;
+    if (WFE_HAVE_FAILED(status)) {
+        results->failed++;
+        return;
+    }
+
+    results->loaded++;
+    results->content = results->content && size >= 18 && strncmp(data, "this is plain text", 18) == 0;
+}
+
+static char * test_loader_init_finalize() {
+    wfeLoader loader;
+    mu_assert("zero workers should be rejected", wfeLoaderInit(&loader, 0) == WFE_LOADER_INVALID_COUNT);
+    mu_assert("too many workers should be rejected", wfeLoaderInit(&loader, WFE_LOADER_MAX_WORKERS + 1) == WFE_LOADER_INVALID_COUNT);
+    mu_assert("could not init loader", wfeLoaderInit(&loader, 2) == WFE_SUCCESS);
+    mu_assert("nothing to pump", wfeLoaderPump(&loader, 0) == 0);
+    wfeLoaderFinalize(&loader);
+    return 0;
+}
+
+static char * test_loader_submit_pump() {
+    wfeLoader loader;
+    wfePool pool;
+    wfeLoaderTicket tickets[17];
+    loader_results results = {0, 0, WFE_TRUE};
+    wfeSize i, delivered = 0;
+
+    mu_assert("could not init loader", wfeLoaderInit(&loader, 3) == WFE_SUCCESS);
+    mu_assert("could not init pool", wfePoolInitShared(&pool, &loader.shared) == WFE_SUCCESS);
+
+    for (i = 0; i < 16; i++) {
+        mu_assert("could not submit request", wfeLoaderSubmit(&loader, "test_asset_load_raw", ".txt", &pool,
+                                                              loader_collect, &results, &tickets[i]) == WFE_SUCCESS);
+        mu_assert("ticket should be valid", tickets[i] != 0);
+    }
+
+    mu_assert("could not submit request", wfeLoaderSubmit(&loader, "test_asset_missing", ".txt", &pool,
+                                                          loader_collect, &results, &tickets[16]) == WFE_SUCCESS);
+
+    // Callbacks wait for the pump even when requests are finished.
+    mu_assert("missing asset should fail", wfeLoaderWait(&loader, tickets[16]) == WFE_ASSET_FILE_ACCESS_ERROR);
+    for (i = 0; i < 16; i++) {
+        mu_assert("request should succeed", wfeLoaderWait(&loader, tickets[i]) == WFE_SUCCESS);
+    }
+    mu_assert("callbacks should wait for pump", results.loaded == 0 && results.failed == 0);
+
+    delivered = wfeLoaderPump(&loader, 5);
+    mu_assert("pump should honor max", delivered == 5);
+    delivered += wfeLoaderPump(&loader, 0);
+    mu_assert("pump should deliver every request", delivered == 17);
+    mu_assert("every asset should be loaded", results.loaded == 16 && results.failed == 1);
+    mu_assert("data should be handed to pool", results.content == WFE_TRUE);
+    mu_assert("small assets should be copied into pool", wfePoolTotalSize(&pool) > 0 && wfePoolTotalSize(&pool) < WFE_POOL_MEDIUM);
+    mu_assert("delivered tickets should be done", wfeLoaderPoll(&loader, tickets[0]) == WFE_DONE);
+
+    // Pool is bound to the store of the loader, so it goes first.
+    wfePoolFinalize(&pool);
+    wfeLoaderFinalize(&loader);
+    return 0;
+}
+
+static char * loader_suite() {
+    char *envsp = getenv("WFE_SEARCH_PATH");
+    if (envsp != NULL)
+        wfeAssetSetSearchPath(envsp);
+    else
+        wfeAssetSetSearchPath("tests/assets");
+
+    mu_suite_start(loader);
+    mu_run_test(test_loader_init_finalize);
+    mu_run_test(test_loader_submit_pump);
+    mu_suite_end(loader);
+    return 0;
+}
@@ -4,8 +4,14 @@
 // include all suites
 #include "types_suite.c"
 #include "pool_suite.c"
+#include "vmem_suite.c"
+#include "frame_suite.c"
 #include "desc_suite.c"
 #include "asset_suite.c"
+#include "loader_suite.c"
+#include "cache_suite.c"
+#include "watch_suite.c"
+#include "trace_suite.c"
 #include "game_suite.c"
 #include "mesh_suite.c"
 
@@ -14,8 +20,14 @@ static char * all_suites() {
     mu_msg("Running tests for WhiteFire Game Engine");
     mu_run_suite(types_suite);
     mu_run_suite(pool_suite);
+    mu_run_suite(vmem_suite);
+    mu_run_suite(frame_suite);
     mu_run_suite(desc_suite);
     mu_run_suite(asset_suite);
+    mu_run_suite(loader_suite);
+    mu_run_suite(cache_suite);
+    mu_run_suite(watch_suite);
+    mu_run_suite(trace_suite);
     mu_run_suite(game_suite);
     mu_run_suite(mesh_suite);
     return 0;
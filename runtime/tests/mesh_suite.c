@@ -46,8 +46,7 @@ static char * test_mesh_setup_mesh() {
     mu_assert("invalid value for ebo", mesh.ebo != 0);
 
     GLuint shaderProgram = get_testing_shader();
-    GLFWwindow *window = (GLFWwindow *) wfeGameGetContext(game);
-    while(GL_FALSE == glfwWindowShouldClose(window)) {
+    do {
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
 
@@ -60,10 +59,7 @@ static char * test_mesh_setup_mesh() {
             glDrawElements(GL_TRIANGLES, mesh.icount, GL_UNSIGNED_INT, 0);
         }
         glBindVertexArray(0);
-
-        glfwSwapBuffers(window);
-        glfwPollEvents();
-    }
+    } while (wfeGameStep(game));
 
     wfePoolFinalize(&pool);
     wfeGameFinalize(game);
@@ -1,6 +1,8 @@
 #include "minunit.h"
 #include <wfe/pool.h>
 #include <stdlib.h>
+#include <string.h>
+#include <threads.h>
 
 typedef struct _wfePoolDummy {
     char c;
@@ -105,6 +107,30 @@ static char * test_pool_tier_allocate_bigger() {
     return 0;
 }
 
+static char * test_pool_tier_get_misaligned_block() {
+    wfePoolTier tier;
+    wfePoolBlock *block = malloc(sizeof(wfePoolBlock));
+    wfeData *data = NULL;
+
+    // Next block on chain starts one byte past its alignment, as a block of another backend might.
+    mu_assert("initialize tier", wfePoolTierInit(&tier, WFE_POOL_TINY) == WFE_SUCCESS);
+    mu_assert("initialize memory block", block != NULL && wfePoolBlockInit(block, WFE_POOL_TINY + 1) == WFE_SUCCESS);
+    block->start++;
+    tier.first->next = block;
+
+    data = wfePoolTierGet(&tier, WFE_POOL_TINY / 2 + 1, 1);
+    mu_assert("unexpected null pointer (first request)", data != NULL);
+    data = wfePoolTierGet(&tier, WFE_POOL_TINY, 16);
+    mu_assert("unexpected null pointer (second request)", data != NULL);
+    mu_assert("pointer is not aligned", ((wfeSize) data & 15) == 0);
+    mu_assert("padded request should not overrun its block", data + WFE_POOL_TINY <= tier.current->end);
+    mu_assert("misaligned block should be skipped", tier.current != block && block->next == tier.current);
+
+    block->start--;
+    wfePoolTierFinalize(&tier);
+    return 0;
+}
+
 static char * test_pool_tier_recycle() {
     wfePoolTier tier;
     wfeData *d1 = NULL, *d2 = NULL, *d3 = NULL, *d4 = NULL;
@@ -205,6 +231,645 @@ static char * test_pool_recycle() {
     return 0;
 }
 
+static char * test_pool_size_class() {
+    mu_assert("unexpected class for 1 byte", wfePoolSizeClass(1) == 0);
+    mu_assert("unexpected class for 2 bytes", wfePoolSizeClass(2) == 1);
+    mu_assert("unexpected class for 3 bytes", wfePoolSizeClass(3) == 2);
+    mu_assert("unexpected class for 32 bytes", wfePoolSizeClass(32) == 5);
+    mu_assert("unexpected class for 33 bytes", wfePoolSizeClass(33) == 6);
+    mu_assert("unexpected class for 1 KB", wfePoolSizeClass(WFE_POOL_SMALL) == 10);
+    return 0;
+}
+
+static char * test_pool_get_threshold() {
+    wfePool pool;
+    wfeSize boundary = (wfeSize) (WFE_POOL_LARGE * 0.25); // 2.5 MB, not a power of two
+
+    mu_assert("initialize pool", wfePoolInit(&pool) == WFE_SUCCESS);
+    wfeData *d1 = wfePoolGet(&pool, boundary, wfeAlignOf(char));
+    mu_assert("unexpected null pointer (d1 request)", d1 != NULL);
+    mu_assert("boundary request should be served by large tier", pool.large != NULL && pool.huge == NULL);
+
+    wfePoolSetThreshold(&pool, 0.5);
+    wfeData *d2 = wfePoolGet(&pool, WFE_POOL_TINY / 2, wfeAlignOf(char));
+    mu_assert("unexpected null pointer (d2 request)", d2 != NULL);
+    mu_assert("request should be served by tiny tier after threshold change",
+            pool.tiny != NULL && pool.small == NULL && d2 >= pool.tiny->current->start && d2 < pool.tiny->current->end);
+
+    wfePoolFinalize(&pool);
+    return 0;
+}
+
+static char * test_pool_slab_free() {
+    wfePool pool;
+    wfePoolOccupancy occupancy;
+    wfeData *d1 = NULL, *d2 = NULL, *d3 = NULL;
+
+    mu_assert("initialize pool", wfePoolInit(&pool) == WFE_SUCCESS);
+    mu_assert("pool without slab should not report occupancy", wfePoolSlabOccupancy(&pool, &occupancy) == WFE_POOL_NOT_SLAB);
+    mu_assert("set pool slab tier", wfePoolSlabTier(&pool, sizeof(wfePoolDummy), 4) == WFE_SUCCESS);
+
+    d1 = wfePoolGet(&pool, sizeof(wfePoolDummy), wfeAlignOf(wfePoolDummy));
+    d2 = wfePoolGet(&pool, sizeof(wfePoolDummy), wfeAlignOf(wfePoolDummy));
+    mu_assert("unexpected null pointers", d1 != NULL && d2 != NULL && d1 != d2);
+
+    wfePoolFree(&pool, d1);
+    d3 = wfePoolGet(&pool, sizeof(wfePoolDummy), wfeAlignOf(wfePoolDummy));
+    mu_assert("did not re-use released slot", d3 == d1);
+
+    wfePoolFree(&pool, d2);
+    mu_assert("query occupancy", wfePoolSlabOccupancy(&pool, &occupancy) == WFE_SUCCESS);
+    mu_assert("unexpected capacity", occupancy.capacity == 4);
+    mu_assert("unexpected live objects", occupancy.live == 1);
+    mu_assert("unexpected free slots", occupancy.free == 1);
+    mu_assert("unexpected reused slots", occupancy.reused == 1);
+    mu_assert("chain should not grow", wfePoolTotalSize(&pool) == sizeof(wfePoolDummy) * 4);
+
+    // Requests bigger than a slot fail without counting a live object.
+    mu_assert("oversized request should fail", wfePoolGet(&pool, sizeof(wfePoolDummy) * 2, wfeAlignOf(char)) == NULL);
+    mu_assert("oversized request should report slot size", pool.lastError == WFE_POOL_SLOT_SIZE);
+    wfePoolSlabOccupancy(&pool, &occupancy);
+    mu_assert("failed request should not count as live", occupancy.live == 1);
+
+    wfePoolFinalize(&pool);
+    return 0;
+}
+
+static char * test_pool_slab_churn() {
+    wfePool pool;
+    wfeData *objects[8];
+    wfeSize i, round, size = 0;
+
+    mu_assert("initialize pool", wfePoolInit(&pool) == WFE_SUCCESS);
+    mu_assert("set pool slab tier", wfePoolSlabTier(&pool, sizeof(wfePoolDummy), 8) == WFE_SUCCESS);
+
+    // Creating and destroying the same amount of objects must not extend the chain.
+    for (round = 0; round < 100; round++) {
+        for (i = 0; i < 8; i++) {
+            objects[i] = wfePoolGet(&pool, sizeof(wfePoolDummy), wfeAlignOf(wfePoolDummy));
+            mu_assert("unexpected null pointer", objects[i] != NULL);
+        }
+
+        for (i = 0; i < 8; i++)
+            wfePoolFree(&pool, objects[i]);
+
+        if (round == 0)
+            size = wfePoolTotalSize(&pool);
+    }
+
+    mu_assert("chain grew while churning objects", wfePoolTotalSize(&pool) == size);
+    wfePoolFinalize(&pool);
+    return 0;
+}
+
+static char * test_pool_mmap_backend() {
+    wfePool pool;
+    wfeData *d1 = NULL, *d2 = NULL;
+    wfeSize i;
+
+    mu_assert("initialize pool", wfePoolInit(&pool) == WFE_SUCCESS);
+    wfePoolSetBackend(&pool, WFE_POOL_BACKEND_MMAP | WFE_POOL_BACKEND_HUGE_PAGES);
+
+    d1 = wfePoolGet(&pool, WFE_POOL_SMALL, wfeAlignOf(char));
+    mu_assert("unexpected null pointer (d1 request)", d1 != NULL);
+    mu_assert("medium tier should be mapped", (pool.medium->first->backend & WFE_POOL_BACKEND_MASK) == WFE_POOL_BACKEND_MMAP);
+    mu_assert("huge pages should be kept for large and huge tiers", (pool.medium->backend & WFE_POOL_BACKEND_HUGE_PAGES) == 0);
+    for (i = 0; i < WFE_POOL_SMALL; i++) {
+        mu_assert("mapped memory should read as zero", d1[i] == 0);
+    }
+
+    // Spill into a second block, then leave it unused for a whole cycle.
+    d2 = wfePoolGet(&pool, WFE_POOL_MEDIUM / 4, wfeAlignOf(char));
+    d2 = wfePoolGet(&pool, WFE_POOL_MEDIUM / 4, wfeAlignOf(char));
+    d2 = wfePoolGet(&pool, WFE_POOL_MEDIUM / 4, wfeAlignOf(char));
+    d2 = wfePoolGet(&pool, WFE_POOL_MEDIUM / 4, wfeAlignOf(char));
+    mu_assert("unexpected null pointer (d2 request)", d2 != NULL);
+    mu_assert("should have spilled into a second block", pool.medium->first->next == pool.medium->current);
+    d2[0] = 1;
+
+    wfePoolRecycle(&pool);
+    mu_assert("second block was used, should still be resident", pool.medium->first->next->resident);
+    wfePoolRecycle(&pool);
+    mu_assert("unused block should have been discarded", !pool.medium->first->next->resident);
+    mu_assert("discarded memory should read as zero", d2[0] == 0);
+
+    wfePoolFinalize(&pool);
+    return 0;
+}
+
+static char * test_pool_mark_rewind() {
+    wfePool pool;
+    wfePoolMarker outer, inner;
+    wfeData *d1 = NULL, *d2 = NULL, *d3 = NULL, *d4 = NULL;
+    wfeSize i;
+
+    mu_assert("initialize pool", wfePoolInit(&pool) == WFE_SUCCESS);
+    d1 = wfePoolGet(&pool, sizeof(wfePoolDummy), wfeAlignOf(wfePoolDummy));
+    mu_assert("unexpected null pointer (d1 request)", d1 != NULL);
+
+    wfePoolMark(&pool, &outer);
+    d2 = wfePoolGet(&pool, sizeof(wfePoolDummy), wfeAlignOf(wfePoolDummy));
+
+    // Nested scope that spills over several blocks and into a new tier.
+    wfePoolMark(&pool, &inner);
+    for (i = 0; i < 32; i++) {
+        d3 = wfePoolGet(&pool, sizeof(wfePoolDummy), wfeAlignOf(wfePoolDummy));
+        mu_assert("unexpected null pointer (d3 request)", d3 != NULL);
+    }
+
+    mu_assert("unexpected null pointer (small request)", wfePoolGet(&pool, WFE_POOL_TINY, wfeAlignOf(char)) != NULL);
+    wfePoolRewind(&pool, &inner);
+
+    d4 = wfePoolGet(&pool, sizeof(wfePoolDummy), wfeAlignOf(wfePoolDummy));
+    mu_assert("inner scope was not rewound", d4 != NULL && d4 == d2 + (d2 - d1));
+    mu_assert("tier created within scope should be empty", wfePoolTierAvailable(pool.small) == WFE_POOL_SMALL);
+
+    wfePoolRewind(&pool, &outer);
+    d4 = wfePoolGet(&pool, sizeof(wfePoolDummy), wfeAlignOf(wfePoolDummy));
+    mu_assert("outer scope was not rewound", d4 == d2);
+
+    wfePoolFinalize(&pool);
+    return 0;
+}
+
+static char * test_pool_mark_rewind_slab() {
+    wfePool pool;
+    wfePoolMarker marker;
+    wfePoolOccupancy occupancy;
+    wfeData *d1 = NULL, *d2 = NULL, *d3 = NULL;
+
+    mu_assert("initialize pool", wfePoolInit(&pool) == WFE_SUCCESS);
+    mu_assert("set pool slab tier", wfePoolSlabTier(&pool, sizeof(wfePoolDummy), 8) == WFE_SUCCESS);
+    d1 = wfePoolGet(&pool, sizeof(wfePoolDummy), wfeAlignOf(wfePoolDummy));
+    d2 = wfePoolGet(&pool, sizeof(wfePoolDummy), wfeAlignOf(wfePoolDummy));
+    d3 = wfePoolGet(&pool, sizeof(wfePoolDummy), wfeAlignOf(wfePoolDummy));
+    mu_assert("unexpected null pointers", d1 != NULL && d2 != NULL && d3 != NULL);
+    wfePoolFree(&pool, d1);
+
+    // Scope that never touches the slab keeps its free list.
+    wfePoolMark(&pool, &marker);
+    wfePoolRewind(&pool, &marker);
+    wfePoolSlabOccupancy(&pool, &occupancy);
+    mu_assert("untouched free list should be kept", occupancy.free == 1 && occupancy.live == 2);
+
+    // Slots released and taken again within the scope leave the marked list intact.
+    wfePoolMark(&pool, &marker);
+    wfePoolFree(&pool, d2);
+    mu_assert("did not re-use slot released within scope", wfePoolGet(&pool, sizeof(wfePoolDummy), wfeAlignOf(wfePoolDummy)) == d2);
+    wfePoolRewind(&pool, &marker);
+    mu_assert("marked free list should be kept", wfePoolGet(&pool, sizeof(wfePoolDummy), wfeAlignOf(wfePoolDummy)) == d1);
+
+    // Taking a marked free slot overwrites its link, the list is dropped.
+    wfePoolFree(&pool, d1);
+    wfePoolMark(&pool, &marker);
+    mu_assert("did not re-use marked free slot", wfePoolGet(&pool, sizeof(wfePoolDummy), wfeAlignOf(wfePoolDummy)) == d1);
+    wfePoolRewind(&pool, &marker);
+    wfePoolSlabOccupancy(&pool, &occupancy);
+    mu_assert("reached free list should be dropped", occupancy.free == 0 && occupancy.live == 2);
+
+    wfePoolFinalize(&pool);
+    return 0;
+}
+
+static char * test_pool_stats() {
+    wfePool pool;
+    wfePoolReport report;
+    wfeSize i;
+
+    mu_assert("initialize pool", wfePoolInit(&pool) == WFE_SUCCESS);
+
+    // Six requests fill 120 bytes of the tiny block, the seventh spills into a new block.
+    for (i = 0; i < 7; i++) {
+        mu_assert("unexpected null pointer", wfePoolGet(&pool, 20, wfeAlignOf(wfeInt32)) != NULL);
+    }
+
+    // Peak of the pool is not the sum of peaks, tiny tier was already recycled.
+    wfePoolRecycle(&pool);
+    mu_assert("unexpected null pointer", wfePoolGet(&pool, 256, wfeAlignOf(char)) != NULL);
+#ifdef WFE_POOL_STATS
+    mu_assert("could not query stats", wfePoolStats(&pool, &report) == WFE_SUCCESS);
+    mu_assert("unexpected pool peak", report.total.peak == 256);
+    mu_assert("unexpected request count", report.tiers[WFE_POOL_TIER_TINY].requests == 7);
+    mu_assert("unexpected requested bytes", report.tiers[WFE_POOL_TIER_TINY].requested == 140);
+    mu_assert("unexpected tail waste", report.tiers[WFE_POOL_TIER_TINY].tailWaste == WFE_POOL_TINY - 120);
+    mu_assert("unexpected peak", report.tiers[WFE_POOL_TIER_TINY].peak == WFE_POOL_TINY + 20);
+    mu_assert("used bytes should reset on recycle", report.tiers[WFE_POOL_TIER_TINY].used == 0);
+    mu_assert("unexpected chain length", report.tiers[WFE_POOL_TIER_TINY].blocks == 2);
+    mu_assert("unexpected recycle count", report.tiers[WFE_POOL_TIER_TINY].recycles == 1);
+    mu_assert("unexpected histogram", report.tiers[WFE_POOL_TIER_TINY].histogram[wfePoolSizeClass(20)] == 7);
+    mu_assert("unexpected total reserved", report.totalReserved == WFE_POOL_TINY * 2 + WFE_POOL_SMALL);
+
+    FILE *out = tmpfile();
+    mu_assert("could not dump stats", wfePoolStatsDump(&pool, out) == WFE_SUCCESS);
+    rewind(out);
+    mu_assert("dump should be a JSON object", fgetc(out) == '{');
+    fclose(out);
+#else
+    mu_assert("stats should be disabled", wfePoolStats(&pool, &report) == WFE_POOL_STATS_DISABLED);
+#endif
+
+    wfePoolFinalize(&pool);
+    return 0;
+}
+
+static char * test_pool_trim() {
+    wfePool pool;
+    wfeSize i;
+
+    mu_assert("initialize pool", wfePoolInit(&pool) == WFE_SUCCESS);
+    wfePoolSetTrim(&pool, WFE_POOL_TRIM_DECAY, 2);
+
+    // Spike of ten tiny blocks, six requests fit on each one.
+    for (i = 0; i < 60; i++) {
+        mu_assert("unexpected null pointer", wfePoolGet(&pool, 20, wfeAlignOf(wfeInt32)) != NULL);
+    }
+
+    wfePoolRecycle(&pool);
+    mu_assert("spike should be kept while on window", wfePoolTotalSize(&pool) == WFE_POOL_TINY * 10);
+
+    wfePoolGet(&pool, 20, wfeAlignOf(wfeInt32));
+    wfePoolRecycle(&pool);
+    mu_assert("spike should be kept while on window", wfePoolTotalSize(&pool) == WFE_POOL_TINY * 10);
+
+    wfePoolGet(&pool, 20, wfeAlignOf(wfeInt32));
+    wfePoolRecycle(&pool);
+    mu_assert("spike should be released after leaving window", wfePoolTotalSize(&pool) == WFE_POOL_TINY);
+
+    for (i = 0; i < 60; i++) {
+        mu_assert("unexpected null pointer", wfePoolGet(&pool, 20, wfeAlignOf(wfeInt32)) != NULL);
+    }
+
+    wfePoolSetTrim(&pool, WFE_POOL_TRIM_BYTES, WFE_POOL_TINY * 5 + 1);
+    wfePoolRecycle(&pool);
+    mu_assert("unexpected size after trimming bytes", wfePoolTotalSize(&pool) == WFE_POOL_TINY * 5);
+
+    wfePoolSetTrim(&pool, WFE_POOL_TRIM_BLOCKS, 3);
+    wfePoolRecycle(&pool);
+    mu_assert("unexpected size after trimming blocks", wfePoolTotalSize(&pool) == WFE_POOL_TINY * 3);
+
+    // Kept blocks are still re-used in order.
+    for (i = 0; i < 24; i++) {
+        mu_assert("unexpected null pointer", wfePoolGet(&pool, 20, wfeAlignOf(wfeInt32)) != NULL);
+    }
+    mu_assert("chain should grow again", wfePoolTotalSize(&pool) == WFE_POOL_TINY * 4);
+
+    wfePoolFinalize(&pool);
+    return 0;
+}
+
+static char * test_pool_large_objects() {
+    wfePool pool;
+    wfePoolMarker marker;
+    wfeData *d1 = NULL, *d2 = NULL, *d3 = NULL;
+    wfeSize size = WFE_POOL_HUGE;
+
+    mu_assert("initialize pool", wfePoolInit(&pool) == WFE_SUCCESS);
+    d1 = wfePoolGet(&pool, size, wfeAlignOf(wfeInt32));
+    mu_assert("unexpected null pointer (d1 request)", d1 != NULL);
+    mu_assert("large objects should not create custom tier", pool.custom == NULL);
+    mu_assert("large object should be owned", wfePoolObjectsOwns(&pool.objects, d1));
+    d1[0] = 1; d1[size-1] = 1;
+
+    // Released mapping is cached and handed to the next request of the same size class.
+    wfePoolFree(&pool, d1);
+    mu_assert("released object should not be owned", !wfePoolObjectsOwns(&pool.objects, d1));
+    mu_assert("released mapping should be cached", pool.objects.liveSize == 0 && pool.objects.cacheSize > size);
+    d2 = wfePoolGet(&pool, size - 4096, wfeAlignOf(wfeInt32));
+    mu_assert("cached mapping should be re-used", d2 == d1 && pool.objects.cacheSize == 0);
+    mu_assert("re-used mapping should read zero", d2[0] == 0 && d2[size-1] == 0);
+
+    // Objects requested within a scope are released by rewind.
+    wfePoolMark(&pool, &marker);
+    d3 = wfePoolGet(&pool, size, wfeAlignOf(wfeInt32));
+    mu_assert("unexpected null pointer (d3 request)", d3 != NULL && d3 != d2);
+    wfePoolRewind(&pool, &marker);
+    mu_assert("scoped object should be released", !wfePoolObjectsOwns(&pool.objects, d3));
+    mu_assert("object before mark should be kept", wfePoolObjectsOwns(&pool.objects, d2));
+
+    // Cache beyond limit is unmapped.
+    wfePoolSetObjectCache(&pool, 0);
+    mu_assert("cache should be empty", pool.objects.cacheSize == 0);
+    wfePoolFree(&pool, d2);
+    mu_assert("pool should not hold memory", wfePoolTotalSize(&pool) == 0);
+    wfePoolFinalize(&pool);
+
+    // Mappings of huge pages can not be emptied by discard, they are never cached.
+    mu_assert("initialize pool", wfePoolInit(&pool) == WFE_SUCCESS);
+    wfePoolSetBackend(&pool, WFE_POOL_BACKEND_MMAP | WFE_POOL_BACKEND_HUGE_PAGES);
+    d1 = wfePoolGet(&pool, size, wfeAlignOf(wfeInt32));
+    mu_assert("unexpected null pointer (huge pages request)", d1 != NULL);
+    wfePoolFree(&pool, d1);
+    mu_assert("huge pages mapping should not be cached", pool.objects.cacheSize == 0);
+
+    wfePoolFinalize(&pool);
+    return 0;
+}
+
+#define WFE_POOL_TEST_WORKERS 4
+#define WFE_POOL_TEST_OBJECTS 1000
+
+typedef struct wfePoolHandoffJob {
+    wfePoolShared *shared;
+    wfePool *owner;
+    wfeInt32 *objects[WFE_POOL_TEST_OBJECTS];
+    wfeInt32 value;
+    wfeError status;
+} wfePoolHandoffJob;
+
+static int wfePoolHandoffWorker(void *data) {
+    wfePoolHandoffJob *job = data;
+    wfePool pool;
+    wfeSize i;
+
+    wfePoolInitShared(&pool, job->shared);
+    for (i = 0; i < WFE_POOL_TEST_OBJECTS; i++) {
+        job->objects[i] = (wfeInt32 *) wfePoolGet(&pool, sizeof(wfeInt32) * 64, wfeAlignOf(wfeInt32));
+        if (job->objects[i] == NULL) {
+            job->status = WFE_POOL_OMEM_CHUNK;
+            break;
+        }
+
+        job->objects[i][0] = job->value;
+        job->objects[i][63] = job->value;
+    }
+
+    job->status = wfePoolHandoff(&pool, job->owner);
+    wfePoolFinalize(&pool);
+    return 0;
+}
+
+static char * test_pool_handoff() {
+    wfePoolShared shared;
+    wfePool owner;
+    wfePoolHandoffJob jobs[WFE_POOL_TEST_WORKERS];
+    thrd_t threads[WFE_POOL_TEST_WORKERS];
+    wfeSize i, k;
+
+    wfePoolSharedInit(&shared);
+    mu_assert("initialize pool", wfePoolInitShared(&owner, &shared) == WFE_SUCCESS);
+
+    for (i = 0; i < WFE_POOL_TEST_WORKERS; i++) {
+        jobs[i].shared = &shared;
+        jobs[i].owner = &owner;
+        jobs[i].value = (wfeInt32) i + 1;
+        mu_assert("could not start worker", thrd_create(&threads[i], wfePoolHandoffWorker, &jobs[i]) == thrd_success);
+    }
+
+    for (i = 0; i < WFE_POOL_TEST_WORKERS; i++)
+        thrd_join(threads[i], NULL);
+
+    // Workers are gone, their memory is still valid until owner recycles.
+    for (i = 0; i < WFE_POOL_TEST_WORKERS; i++) {
+        mu_assert("handoff failed", jobs[i].status == WFE_SUCCESS);
+        for (k = 0; k < WFE_POOL_TEST_OBJECTS; k++) {
+            mu_assert("handed off memory was modified", jobs[i].objects[k][0] == jobs[i].value && jobs[i].objects[k][63] == jobs[i].value);
+        }
+    }
+
+    // Four objects fill a small block.
+    k = shared.counts[WFE_POOL_TIER_SMALL];
+    wfePoolRecycle(&owner);
+    mu_assert("handed off blocks should return to store", shared.counts[WFE_POOL_TIER_SMALL] == k + WFE_POOL_TEST_WORKERS * WFE_POOL_TEST_OBJECTS / 4);
+
+    // Owner refills from store instead of requesting memory.
+    k = shared.counts[WFE_POOL_TIER_SMALL];
+    mu_assert("unexpected null pointer", wfePoolGet(&owner, sizeof(wfeInt32) * 64, wfeAlignOf(wfeInt32)) != NULL);
+    mu_assert("tier should start with a spare block", shared.counts[WFE_POOL_TIER_SMALL] == k - 1);
+
+    wfePoolFinalize(&owner);
+    mu_assert("finalized pools should unbind from store", atomic_load(&shared.pools) == 0);
+    wfePoolSharedFinalize(&shared);
+    return 0;
+}
+
+static char * test_pool_handoff_object() {
+    wfePool worker, owner;
+    wfeData *small, *large;
+
+    mu_assert("initialize worker pool", wfePoolInit(&worker) == WFE_SUCCESS);
+    mu_assert("initialize owner pool", wfePoolInit(&owner) == WFE_SUCCESS);
+    small = wfePoolGet(&worker, 64, wfeAlignOf(char));
+    large = wfePoolGet(&worker, WFE_POOL_HUGE, wfeAlignOf(char));
+    mu_assert("unexpected null pointers", small != NULL && large != NULL);
+
+    // Only the large object moves, tier blocks stay on the worker.
+    mu_assert("tier memory is not a large object", !wfePoolHandoffObject(&worker, &owner, small));
+    mu_assert("could not hand off large object", wfePoolHandoffObject(&worker, &owner, large));
+    mu_assert("worker should not own handed off object", !wfePoolObjectsOwns(&worker.objects, large) && worker.objects.liveSize == 0);
+    mu_assert("worker should keep its tiers", worker.small != NULL && worker.small->current->head != worker.small->current->start);
+    large[WFE_POOL_HUGE - 1] = 1;
+
+    wfePoolRecycle(&owner);
+    mu_assert("owner should cache handed off object", owner.objects.cacheSize > WFE_POOL_HUGE);
+    wfePoolFinalize(&worker);
+    wfePoolFinalize(&owner);
+    return 0;
+}
+
+static char * test_pool_align() {
+    wfePool pool;
+    wfeData *d1 = NULL, *d2 = NULL;
+    wfeSize align, page = 4096;
+
+    mu_assert("unexpected rounding", wfePoolMemoryAlign((wfeSize) 16, 8) == 16);
+    mu_assert("unexpected rounding", wfePoolMemoryAlign((wfeSize) 17, 8) == 24);
+    mu_assert("rounding should keep high bits", wfePoolMemoryAlign(((wfeSize) 1 << 40) + 1, 16) == ((wfeSize) 1 << 40) + 16);
+
+    mu_assert("initialize pool", wfePoolInit(&pool) == WFE_SUCCESS);
+
+    // An odd request first, so following requests need padding.
+    for (align = 1; align <= page; align <<= 1) {
+        mu_assert("unexpected null pointer (odd request)", wfePoolGet(&pool, 3, wfeAlignOf(char)) != NULL);
+        d1 = wfePoolGet(&pool, 24, align);
+        mu_assert("unexpected null pointer (aligned request)", d1 != NULL);
+        mu_assert("pointer is not aligned", ((wfeSize) d1 & (align - 1)) == 0);
+    }
+
+    // Large objects honor alignment up to a page as well.
+    d2 = wfePoolGet(&pool, WFE_POOL_HUGE, page);
+    mu_assert("unexpected null pointer (large request)", d2 != NULL);
+    mu_assert("large object is not aligned", ((wfeSize) d2 & (page - 1)) == 0);
+    mu_assert("aligned large object should be owned", wfePoolObjectsOwns(&pool.objects, d2));
+    wfePoolFree(&pool, d2);
+    mu_assert("aligned large object should be released", !wfePoolObjectsOwns(&pool.objects, d2));
+
+    wfePoolFinalize(&pool);
+    return 0;
+}
+
+static char * test_pool_arena() {
+    wfePool pool;
+    wfeData *d1 = NULL, *d2 = NULL;
+    wfeSize size = 1000, step = WFE_POOL_MEDIUM;
+    wfeSize i;
+
+    mu_assert("initialize pool", wfePoolInit(&pool) == WFE_SUCCESS);
+    wfePoolSetBackend(&pool, WFE_POOL_BACKEND_ARENA);
+
+    // A growing stream keeps its address, pages are committed as it grows.
+    d1 = wfePoolGet(&pool, size, wfeAlignOf(wfeFloat32));
+    mu_assert("unexpected null pointer (d1 request)", d1 != NULL);
+    for (i = 0; i < 64; i++) {
+        mu_assert("could not extend last object", wfePoolExtend(&pool, d1, size, step) == WFE_SUCCESS);
+        size += step;
+        d1[size - 1] = 1;
+    }
+
+    mu_assert("tier should hold a single block", pool.medium->first == pool.medium->current && pool.medium->first->next == NULL);
+    mu_assert("extended object should be contiguous", pool.medium->current->head == d1 + size);
+
+    // Only the last object of a tier can grow.
+    d2 = wfePoolGet(&pool, 1000, wfeAlignOf(wfeFloat32));
+    mu_assert("unexpected null pointer (d2 request)", d2 != NULL && d2 >= d1 + size);
+    mu_assert("object before last should not be extended", wfePoolExtend(&pool, d1, size, step) == WFE_POOL_NOT_LAST);
+    mu_assert("could not extend last object", wfePoolExtend(&pool, d2, 1000, 16) == WFE_SUCCESS);
+
+    wfePoolRecycle(&pool);
+    mu_assert("recycled arena should start over", wfePoolGet(&pool, 1000, wfeAlignOf(wfeFloat32)) == d1);
+
+    wfePoolFinalize(&pool);
+    return 0;
+}
+
+static char * test_pool_child() {
+    wfePool parent, child;
+    wfeSize i;
+
+    mu_assert("initialize pool", wfePoolInit(&parent) == WFE_SUCCESS);
+
+    // Parent ends up with ten tiny blocks, nine of them unreached after recycle.
+    for (i = 0; i < 60; i++) {
+        mu_assert("unexpected null pointer (parent request)", wfePoolGet(&parent, 20, wfeAlignOf(wfeInt32)) != NULL);
+    }
+    wfePoolRecycle(&parent);
+
+    mu_assert("initialize child pool", wfePoolInitChild(&child, &parent) == WFE_SUCCESS);
+    for (i = 0; i < 18; i++) {
+        mu_assert("unexpected null pointer (child request)", wfePoolGet(&child, 20, wfeAlignOf(wfeInt32)) != NULL);
+    }
+
+    mu_assert("child should lease parent blocks", wfePoolTotalSize(&child) == WFE_POOL_TINY * 3);
+    mu_assert("parent should lend its blocks", wfePoolTotalSize(&parent) == WFE_POOL_TINY * 7);
+
+    // Blocks requested by the child for a new tier stay with the parent too.
+    mu_assert("unexpected null pointer (child small request)", wfePoolGet(&child, WFE_POOL_TINY, wfeAlignOf(char)) != NULL);
+    wfePoolFinalize(&child);
+    mu_assert("child should give blocks back", wfePoolTierTotalSize(parent.tiny) == WFE_POOL_TINY * 10);
+    mu_assert("parent should adopt new tiers of child", parent.small != NULL && wfePoolTierTotalSize(parent.small) == WFE_POOL_SMALL);
+    mu_assert("adopted tier should start empty", parent.small->first->head == parent.small->first->start);
+#ifdef WFE_POOL_STATS
+    mu_assert("adopted tier should count on parent usage", parent.small->usage == &parent.usage && parent.small->stats.used == 0);
+#endif
+
+    // Given back blocks are re-used by the parent.
+    for (i = 0; i < 60; i++) {
+        mu_assert("unexpected null pointer (parent request)", wfePoolGet(&parent, 20, wfeAlignOf(wfeInt32)) != NULL);
+    }
+    mu_assert("parent should not grow", wfePoolTierTotalSize(parent.tiny) == WFE_POOL_TINY * 10);
+
+    wfePoolFinalize(&parent);
+    return 0;
+}
+
+// Flips a byte of a file in place, twice restores it.
+static wfeBool pool_image_flip(const char *path, long offset) {
+    FILE *file = fopen(path, "r+b");
+    int byte;
+    if (file == NULL)
+        return WFE_FALSE;
+
+    if (fseek(file, offset, offset < 0 ? SEEK_END : SEEK_SET) != 0 || (byte = fgetc(file)) == EOF ||
+        fseek(file, offset, offset < 0 ? SEEK_END : SEEK_SET) != 0 || fputc(byte ^ 0x5a, file) == EOF) {
+        fclose(file);
+        return WFE_FALSE;
+    }
+
+    return fclose(file) == 0;
+}
+
+static char * test_pool_image() {
+    typedef struct { const char *name; wfeInt32 *values; wfeInt32 count; } entry;
+    const char *path = "pool_image_test.bin";
+    wfePool writer, reader;
+    wfeData *root;
+    wfeAny slots[2];
+    entry *e, *loaded;
+    char *name;
+    wfeInt32 *values, i;
+    wfeUint64 *header;
+    wfeData *image;
+    wfeSize size, k;
+    FILE *file;
+
+    mu_assert("initialize writer pool", wfePoolInit(&writer) == WFE_SUCCESS);
+    e = (entry *) wfePoolGet(&writer, sizeof(entry), wfeAlignOf(entry));
+    name = wfePoolGet(&writer, 6, wfeAlignOf(char));
+    values = (wfeInt32 *) wfePoolGet(&writer, WFE_POOL_HUGE * 2, 64); // Large object
+    mu_assert("unexpected null pointer", e != NULL && name != NULL && values != NULL);
+    memcpy(name, "image", 6);
+    for (i = 0; i < 100; i++) {
+        values[i] = i * 3;
+    }
+    e->name = name; e->values = values; e->count = 100;
+    slots[0] = &e->name; slots[1] = &e->values;
+
+    mu_assert("write image", wfePoolImageWrite(&writer, path, 42, (wfeData *) e, slots, 2) == WFE_SUCCESS);
+    mu_assert("slots should be on pool memory", wfePoolImageWrite(&writer, path, 42, NULL, (wfeAny *) &path, 1) == WFE_POOL_IMAGE_OUTSIDE);
+    mu_assert("write image", wfePoolImageWrite(&writer, path, 42, (wfeData *) e, slots, 2) == WFE_SUCCESS);
+    wfePoolFinalize(&writer);
+
+    mu_assert("initialize reader pool", wfePoolInit(&reader) == WFE_SUCCESS);
+    mu_assert("image with other key should be stale", wfePoolImageLoad(&reader, path, 7, &root) == WFE_POOL_IMAGE_STALE);
+    mu_assert("load image", wfePoolImageLoad(&reader, path, 42, &root) == WFE_SUCCESS);
+    loaded = (entry *) root;
+    mu_assert("root should be aligned", (wfeSize) loaded % wfeAlignOf(entry) == 0);
+    mu_assert("pointers should be fixed up", strcmp(loaded->name, "image") == 0 && loaded->count == 100);
+    mu_assert("large objects should keep alignment", (wfeSize) loaded->values % 64 == 0);
+    mu_assert("large objects should be loaded", loaded->values[0] == 0 && loaded->values[99] == 297);
+    wfePoolFinalize(&reader);
+
+    // A flipped byte on the relocation table is caught by the hash, one on the segments only
+    // when content is verified.
+    mu_assert("initialize reader pool", wfePoolInit(&reader) == WFE_SUCCESS);
+    mu_assert("flip relocation byte", pool_image_flip(path, sizeof(wfeUint64) * 7));
+    mu_assert("corrupt relocations should be stale", wfePoolImageLoad(&reader, path, 42, &root) == WFE_POOL_IMAGE_STALE);
+    mu_assert("restore relocation byte", pool_image_flip(path, sizeof(wfeUint64) * 7));
+    mu_assert("flip content byte", pool_image_flip(path, -1));
+#ifdef WFE_POOL_IMAGE_VERIFY
+    mu_assert("corrupt content should be stale", wfePoolImageLoad(&reader, path, 42, &root) == WFE_POOL_IMAGE_STALE);
+#else
+    mu_assert("content should not be hashed on load", wfePoolImageLoad(&reader, path, 42, &root) == WFE_SUCCESS);
+#endif
+    mu_assert("restore content byte", pool_image_flip(path, -1));
+    wfePoolFinalize(&reader);
+
+    // Relocations out of the image are caught even when the hash matches.
+    file = fopen(path, "r+b");
+    mu_assert("open image", file != NULL);
+    fseek(file, 0, SEEK_END);
+    size = (wfeSize) ftell(file);
+    image = malloc(size);
+    mu_assert("read image", image != NULL && fseek(file, 0, SEEK_SET) == 0 && fread(image, 1, size, file) == size);
+    header = (wfeUint64 *) image;
+    header[7] = size - 4; // First relocation, right after the seven members of the header
+    header[2] = (wfeUint64) 0xcbf29ce484222325;
+    for (k = sizeof(wfeUint64) * 7; k < sizeof(wfeUint64) * (7 + header[4]); k++) {
+        header[2] ^= (wfeUint8) image[k];
+        header[2] *= (wfeUint64) 0x100000001b3;
+    }
+
+    mu_assert("write image", fseek(file, 0, SEEK_SET) == 0 && fwrite(image, 1, size, file) == size);
+    fclose(file);
+    mu_assert("initialize reader pool", wfePoolInit(&reader) == WFE_SUCCESS);
+    mu_assert("relocation out of image should be stale", wfePoolImageLoad(&reader, path, 42, &root) == WFE_POOL_IMAGE_STALE);
+    free(image);
+    mu_assert("missing image should be stale", wfePoolImageLoad(&reader, "pool_image_missing.bin", 42, &root) == WFE_POOL_IMAGE_STALE);
+    wfePoolFinalize(&reader);
+
+    remove(path);
+    return 0;
+}
+
 static char * pool_suite() {
     mu_suite_start(pool);
     mu_run_test(test_pool_block_init_finalize);
@@ -213,11 +878,28 @@ static char * pool_suite() {
     mu_run_test(test_pool_tier_size);
     mu_run_test(test_pool_tier_get);
     mu_run_test(test_pool_tier_allocate_bigger);
+    mu_run_test(test_pool_tier_get_misaligned_block);
     mu_run_test(test_pool_tier_recycle);
     mu_run_test(test_pool_init_finalize);
     mu_run_test(test_pool_misc_and_size);
     mu_run_test(test_pool_get);
     mu_run_test(test_pool_recycle);
+    mu_run_test(test_pool_size_class);
+    mu_run_test(test_pool_get_threshold);
+    mu_run_test(test_pool_slab_free);
+    mu_run_test(test_pool_slab_churn);
+    mu_run_test(test_pool_mmap_backend);
+    mu_run_test(test_pool_mark_rewind);
+    mu_run_test(test_pool_mark_rewind_slab);
+    mu_run_test(test_pool_stats);
+    mu_run_test(test_pool_trim);
+    mu_run_test(test_pool_large_objects);
+    mu_run_test(test_pool_handoff);
+    mu_run_test(test_pool_handoff_object);
+    mu_run_test(test_pool_align);
+    mu_run_test(test_pool_arena);
+    mu_run_test(test_pool_child);
+    mu_run_test(test_pool_image);
     mu_suite_end(pool);
     return 0;
 }
@@ -0,0 +1,111 @@
+#include "minunit.h"
+#include <wfe/trace.h>
+#include <wfe/cache.h>
+#include <wfe/asset.h>
+#include <threads.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+static wfeChar *trace_read(const wfeChar *path) {
+    wfeChar *content;
+    long length;
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+
+    fseek(file, 0L, SEEK_END);
+    length = ftell(file);
+    fseek(file, 0L, SEEK_SET);
+    content = calloc(1, (wfeSize) length + 1);
+    if (content != NULL)
+        fread(content, 1, (wfeSize) length, file);
+
+    fclose(file);
+    return content;
+}
+
+static int trace_thread(void *arg) {
+    (void) arg;
+    wfeTraceEnd(wfeTraceBegin(), "read", "other", ".txt", 1, WFE_TRACE_CACHE_NONE);
+    return 0;
+}
+
+static char * test_trace_stopped() {
+    mu_assert("stopped trace should not begin spans", wfeTraceBegin() == 0);
+    wfeTraceEnd(0, "read", "test", ".txt", 1, WFE_TRACE_CACHE_NONE);
+    mu_assert("stopping a stopped trace should do nothing", wfeTraceStop("test_trace_stopped.json") == WFE_SUCCESS);
+
+    FILE *file = fopen("test_trace_stopped.json", "r");
+    mu_assert("stopped trace should not write", file == NULL);
+    return 0;
+}
+
+static char * test_trace_asset_spans() {
+    wfeCacheEntry *first, *second;
+    wfeCache cache;
+    wfeChar *json;
+
+    mu_assert("could not start trace", wfeTraceStart(64) == WFE_SUCCESS);
+    mu_assert("trace should not start twice", wfeTraceStart(64) == WFE_TRACE_RUNNING);
+    mu_assert("could not init cache", wfeCacheInit(&cache, 1024) == WFE_SUCCESS);
+    mu_assert("could not acquire asset", wfeCacheAcquire(&cache, "test_asset_load_raw", ".txt", &first) == WFE_SUCCESS);
+    mu_assert("could not acquire asset again", wfeCacheAcquire(&cache, "test_asset_load_raw", ".txt", &second) == WFE_SUCCESS);
+    wfeCacheRelease(&cache, first);
+    wfeCacheRelease(&cache, second);
+    wfeCacheFinalize(&cache);
+    mu_assert("could not write trace", wfeTraceStop("test_trace_asset_spans.json") == WFE_SUCCESS);
+
+    json = trace_read("test_trace_asset_spans.json");
+    mu_assert("trace should be written", json != NULL);
+    mu_assert("trace should hold events", strncmp(json, "{\"traceEvents\": [", 17) == 0);
+    mu_assert("trace should hold open span", strstr(json, "\"name\": \"open\"") != NULL);
+    mu_assert("trace should hold resolve span", strstr(json, "\"name\": \"resolve\"") != NULL);
+    mu_assert("trace should hold read span", strstr(json, "\"name\": \"read\"") != NULL && strstr(json, "\"asset\": \"test_asset_load_raw.txt\"") != NULL);
+    mu_assert("trace should hold cache miss", strstr(json, "\"cache\": \"miss\"") != NULL);
+    mu_assert("trace should hold cache hit", strstr(json, "\"cache\": \"hit\"") != NULL);
+    mu_assert("trace should not drop events", strstr(json, "\"dropped\": 0") != NULL);
+    free(json);
+    remove("test_trace_asset_spans.json");
+    return 0;
+}
+
+static char * test_trace_rings() {
+    wfeChar *json;
+    thrd_t other;
+    wfeSize i;
+
+    mu_assert("could not start trace", wfeTraceStart(2) == WFE_SUCCESS);
+    for (i = 0; i < 5; i++)
+        wfeTraceEnd(wfeTraceBegin(), "read", i < 4 ? "old" : "new\"quoted", ".txt", i, WFE_TRACE_CACHE_NONE);
+
+    // Second thread gets its own ring and thread id.
+    mu_assert("could not start thread", thrd_create(&other, trace_thread, NULL) == thrd_success);
+    thrd_join(other, NULL);
+    mu_assert("could not write trace", wfeTraceStop("test_trace_rings.json") == WFE_SUCCESS);
+
+    json = trace_read("test_trace_rings.json");
+    mu_assert("trace should be written", json != NULL);
+    mu_assert("full ring should drop oldest events", strstr(json, "\"dropped\": 3") != NULL && strstr(json, "\"bytes\": 2") == NULL);
+    mu_assert("full ring should keep newest events", strstr(json, "\"bytes\": 3") != NULL && strstr(json, "\"bytes\": 4") != NULL);
+    mu_assert("asset names should be escaped", strstr(json, "\"asset\": \"new\\\"quoted.txt\"") != NULL);
+    mu_assert("threads should have their own ids", strstr(json, "\"asset\": \"other.txt\"") != NULL && strstr(json, "\"tid\": 2") != NULL);
+    free(json);
+    remove("test_trace_rings.json");
+    return 0;
+}
+
+static char * trace_suite() {
+    char *envsp = getenv("WFE_SEARCH_PATH");
+    if (envsp != NULL)
+        wfeAssetSetSearchPath(envsp);
+    else
+        wfeAssetSetSearchPath("tests/assets");
+
+    mu_suite_start(trace);
+    mu_run_test(test_trace_stopped);
+    mu_run_test(test_trace_asset_spans);
+    mu_run_test(test_trace_rings);
+    mu_suite_end(trace);
+    return 0;
+}
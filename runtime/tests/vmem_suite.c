@@ -0,0 +1,64 @@
+#include "minunit.h"
+#include <wfe/vmem.h>
+
+static char * test_vmem_map_unmap() {
+    wfeSize size = wfeVmemPageSize() * 4;
+    wfeData *mem = wfeVmemMap(size, 0);
+    wfeSize i;
+
+    mu_assert("could not map memory", mem != NULL);
+    for (i = 0; i < size; i++) {
+        mu_assert("mapped memory should read as zero", mem[i] == 0);
+    }
+
+    mem[0] = 1;
+    mem[size-1] = 1;
+    wfeVmemUnmap(mem, size);
+    return 0;
+}
+
+static char * test_vmem_discard() {
+    wfeSize page = wfeVmemPageSize();
+    wfeData *mem = wfeVmemMap(page * 2, WFE_VMEM_HUGE_PAGES);
+
+    mu_assert("could not map memory", mem != NULL);
+    mem[0] = 1;
+    mem[page] = 1;
+
+    // Only whole pages are discarded, first page is partially covered.
+    wfeVmemDiscard(mem + 1, page * 2 - 1);
+    mu_assert("partially covered page should be kept", mem[0] == 1);
+    mu_assert("discarded page should read as zero", mem[page] == 0);
+
+    wfeVmemUnmap(mem, page * 2);
+    return 0;
+}
+
+static char * test_vmem_reserve_commit() {
+    wfeSize page = wfeVmemPageSize();
+    wfeData *mem = wfeVmemReserve(page * 1024);
+
+    mu_assert("could not reserve memory", mem != NULL);
+
+    // Range covers the end of first page and start of second one.
+    mu_assert("could not commit memory", wfeVmemCommit(mem + page - 1, 2));
+    mu_assert("committed memory should read as zero", mem[0] == 0 && mem[page * 2 - 1] == 0);
+    mem[0] = 1;
+    mem[page * 2 - 1] = 1;
+
+    mu_assert("could not commit memory", wfeVmemCommit(mem + page * 1023, page));
+    mem[page * 1024 - 1] = 1;
+
+    wfeVmemUnmap(mem, page * 1024);
+    return 0;
+}
+
+static char * vmem_suite() {
+    mu_suite_start(vmem);
+    mu_run_test(test_vmem_map_unmap);
+    mu_run_test(test_vmem_discard);
+    mu_run_test(test_vmem_reserve_commit);
+    mu_suite_end(vmem);
+    return 0;
+}
+
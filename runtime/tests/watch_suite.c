@@ -0,0 +1,78 @@
+#include "minunit.h"
+#include <wfe/watch.h>
+#include <wfe/cache.h>
+#include <wfe/asset.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#ifdef HAVE_UNISTD_H
+#include <sys/stat.h>
+#endif
+
+static wfeBool watch_write(const wfeChar *path, const wfeChar *content) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+        return WFE_FALSE;
+
+    fputs(content, file);
+    return fclose(file) == 0;
+}
+
+// Body of test_watch_reload, search path is restored by caller whatever the result.
+static char * watch_reload() {
+    struct timespec nap = {0, 10000000};
+    wfeCacheEntry *entry;
+    wfeCache cache;
+    wfeWatch watch;
+    wfeError status;
+    wfeSize i, replaced = 0;
+
+#ifdef HAVE_UNISTD_H
+    mkdir("test_watch", 0755);
+#endif
+    mu_assert("could not write asset", watch_write("test_watch/test_watch_asset.txt", "first"));
+    wfeAssetSetSearchPath("test_watch");
+    mu_assert("could not init cache", wfeCacheInit(&cache, 1024) == WFE_SUCCESS);
+    mu_assert("could not acquire asset", wfeCacheAcquire(&cache, "test_watch_asset", ".txt", &entry) == WFE_SUCCESS);
+
+    status = wfeWatchInit(&watch, &cache, NULL);
+    if (status != WFE_WATCH_UNSUPPORTED) {
+        mu_assert("could not init watch", status == WFE_SUCCESS);
+        mu_assert("nothing changed yet", wfeWatchPump(&watch) == 0);
+
+        // A burst of writes is a single reload.
+        mu_assert("could not rewrite asset", watch_write("test_watch/test_watch_asset.txt", "second"));
+        mu_assert("could not rewrite asset again", watch_write("test_watch/test_watch_asset.txt", "third!"));
+        mu_assert("could not write uncached asset", watch_write("test_watch/test_watch_other.txt", "other"));
+        for (i = 0; i < 200 && replaced == 0; i++) {
+            thrd_sleep(&nap, NULL);
+            replaced = wfeWatchPump(&watch);
+        }
+
+        mu_assert("changed asset should be replaced once", replaced == 1 && entry->version == 1);
+        mu_assert("wrong data after reload", entry->size == 6 && strncmp(entry->data, "third!", 6) == 0);
+        wfeWatchFinalize(&watch);
+    }
+
+    wfeCacheRelease(&cache, entry);
+    wfeCacheFinalize(&cache);
+    remove("test_watch/test_watch_asset.txt");
+    remove("test_watch/test_watch_other.txt");
+    remove("test_watch");
+    return 0;
+}
+
+static char * test_watch_reload() {
+    wfeChar *searchPath = (wfeChar *) wfeAssetGetSearchPath();
+    char *message = watch_reload();
+    wfeAssetSetSearchPath(searchPath);
+    return message;
+}
+
+static char * watch_suite() {
+    mu_suite_start(watch);
+    mu_run_test(test_watch_reload);
+    mu_suite_end(watch);
+    return 0;
+}
@@ -0,0 +1,73 @@
+// Builds a pack file from assets under a folder.
+// Usage:
+//  cd assets && find . -type f | asset-packer ../game.pack
+//  find assets -type f -printf '%P\n' | asset-packer game.pack assets 6
+//
+// Level (0 to 9) compresses entries with zlib, zero or none stores them as is.
+#include <wfe/asset.h>
+#include <wfe/pool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PACKER_MAX_NAME 1024
+
+int main(int argc, char **argv) {
+    wfeChar line[PACKER_MAX_NAME], *name;
+    const wfeChar **names;
+    wfeSize count = 0, capacity = 0, len;
+    wfeError status;
+    wfeInt32 level;
+    wfePool pool, list;
+
+    level = argc == 4 ? (wfeInt32) atoi(argv[3]) : 0;
+    if (argc < 2 || argc > 4 || level < 0 || level > 9) {
+        fprintf(stderr, "usage: %s out.pack [root] [level] < names\n", argv[0]);
+        return 1;
+    }
+
+    wfePoolInit(&pool);
+    wfePoolInit(&list);
+    names = NULL;
+    while (fgets(line, sizeof(line), stdin) != NULL) {
+        len = strcspn(line, "\r\n");
+        line[len] = '\0';
+        name = strncmp(line, "./", 2) == 0 ? line + 2 : line;
+        if (*name == '\0')
+            continue;
+
+        // Names live on a pool, the array grows by copying it to a bigger request.
+        if (count == capacity) {
+            const wfeChar **grown = (const wfeChar **) wfePoolGet(&list, sizeof(wfeChar *) * (capacity * 2 + 64), wfeAlignOf(wfeChar *));
+            if (grown == NULL) {
+                fprintf(stderr, "out of memory\n");
+                return 1;
+            }
+
+            if (count > 0)
+                memcpy(grown, names, sizeof(wfeChar *) * count);
+
+            names = grown;
+            capacity = capacity * 2 + 64;
+        }
+
+        names[count] = wfePoolGet(&list, strlen(name) + 1, wfeAlignOf(char));
+        if (names[count] == NULL) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+
+        strcpy((wfeChar *) names[count++], name);
+    }
+
+    status = wfeAssetPackWrite(argv[1], argc >= 3 ? argv[2] : ".", names, count, level, &pool);
+    if (WFE_HAVE_FAILED(status)) {
+        fprintf(stderr, "could not write %s (error 0x%llx)\n", argv[1], (unsigned long long) status);
+        return 1;
+    }
+
+    fprintf(stderr, "packed %zu assets into %s\n", count, argv[1]);
+    wfePoolFinalize(&list);
+    wfePoolFinalize(&pool);
+    return 0;
+}
@@ -0,0 +1,20 @@
+project "asset-packer"
+    dependson {"wferuntime"}
+
+    kind "ConsoleApp"
+    language "C"
+    cdialect "C11"
+    targetdir "bin/%{cfg.buildcfg}"
+
+    includedirs {"../runtime/include", "../vendor", "../vendor/msgpack-c/include"}
+    files {"asset-packer.c"}
+    links {"wferuntime", "msgpack", "zlib"}
+
+    filter "platforms:Linux"
+        defines {"WFE_USE_STDDEF", "WFE_USE_STDINT"}
+        links {"pthread"}
+
+    filter "platforms:Windows"
+        defines {"WFE_USE_MSVSCDEF", "WFE_USE_MSVSCDEF"}
+
+    filter {}